@@ -0,0 +1,4525 @@
+/**
+ * \file    allocator.c
+ * \brief   Contiguous memory allocator core behind the allocator.h API.
+ *
+ * Four engines share one handle:
+ *   - List engine: a doubly linked list of blocks in address order, with a
+ *     treap and power-of-two size classes indexing the FREE blocks, and an
+ *     open-addressing table from process ID to owning block.
+ *   - Buddy engine: power-of-two blocks with O(log n) split and coalesce.
+ *   - Array engine: the same blocks as the list engine, kept in parallel
+ *     address-ordered arrays and found by sequential scans.
+ *   - Bitmap engine: the heap as fixed-size granules, one bit each, with
+ *     summary words that let searches skip full and empty regions.
+ *
+ * Nothing here prints; every outcome is returned as an AllocatorStatus.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // mremap
+#endif
+
+#include "allocator.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(ALLOCATOR_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 // AVX2 and AVX-512 array scans, chosen at run time
+#include <immintrin.h>
+#elif !defined(ALLOCATOR_NO_SIMD) && defined(__GNUC__) && defined(__aarch64__)
+#define SIMD_NEON // NEON array scans
+#include <arm_neon.h>
+#endif
+
+#if ALLOCATOR_SCAN_STATS
+#define COUNT_VISITS(scan, count) ((scan)->nodesVisited += (count))
+#else
+#define COUNT_VISITS(scan, count) ((void)(scan))
+#endif
+
+/* Scan templates are forced inline so each call site with a constant alignment compiles to
+ * its own loop with the padding checks folded away. */
+#if defined(__GNUC__)
+#define SCAN_TEMPLATE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define SCAN_TEMPLATE static __forceinline
+#else
+#define SCAN_TEMPLATE static inline
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define PROCESS_ID_SIZE ALLOCATOR_PROCESS_ID_SIZE
+#define PROCESS_TABLE_MIN_CAPACITY 64 // Initial slot count (power of two)
+#define PROCESS_LIVE -2 // ProcessEntry.nextFree of an interned handle
+#define HANDLE_SLOT_BITS 32 // Public handles keep the table index below this bit and the generation above
+#define NODE_SLAB_SIZE 1024 // Nodes carved out of each slab
+#define SIZE_CLASS_COUNT ALLOCATOR_SIZE_CLASS_COUNT
+#define SEGREGATED_FIT_PROBES 8 // Blocks examined in the request's own class before moving up
+#define BUDDY_MIN_ORDER 4   // Smallest buddy block is 2^4 = 16 bytes
+#define BUDDY_MAX_ORDER 35  // Orders [BUDDY_MIN_ORDER, BUDDY_MAX_ORDER): a block spans at most 2^30 leaves
+#define BUDDY_MAX_SIZE ALLOCATOR_BUDDY_MAX_SIZE
+#define BUDDY_FREE_BIT 0x80 // Set in blockInfo for free blocks; low bits hold the order
+#define DEFERRED_QUEUE_MIN_CAPACITY 64 // Smallest deferred release ring (power of two)
+#define WAIT_QUEUE_MIN_CAPACITY 16 // Initial entries of the wait queue pool and of each size class heap
+#define BACKING_REMAP_THRESHOLD (256 * 1024) // Relocation runs at least this large move by page remapping
+#define BACKING_DISCARD_THRESHOLD (64 * 1024) // Free page runs at least this large go back to the OS
+#define ARRAY_MIN_CAPACITY 64 // Initial block slots of the array engine
+#define ARRAY_RELEASED -2 // Array owner of a block a bulk release freed but has not merged yet
+#define BITMAP_DEFAULT_GRANULE_SHIFT 4 // allocator_create's bitmap granule: 2^4 = ALLOCATOR_BITMAP_GRANULE bytes
+#define BITMAP_MAX_GRANULE_SHIFT 30 // Largest bitmap granule: 1 GiB
+#define BITMAP_OWNER_MIN_CAPACITY 64 // Initial slot count of the bitmap owner table (power of two)
+#define SNAPSHOT_MAGIC "CMASNAP" // Snapshot header tag, NUL included
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304u // Reads back differently on a host of the other byte order
+
+/** Allocation state of a block. */
+typedef enum BlockState {
+    BLOCK_FREE,
+    BLOCK_ALLOCATED
+} BlockState;
+
+/** A contiguous block. Fields read by every list walk come first so a walk
+ *  touches only the front of each node; the size-index links follow. */
+typedef struct Node {
+    struct Node *next;    // Next block in the list
+    struct Node *prev;    // Previous block in the list (dummyHead for the first block)
+    AllocatorSize startAddress;   // Start address of the block
+    AllocatorSize availableSpace; // Size of the block
+    AllocatorSize endAddress;     // End address of the block
+    int owner;            // Interned process handle, -1 if FREE
+    unsigned char state;  // BlockState
+    struct Node *sizeLeft;   // Free-block index: smaller (size, address) keys
+    struct Node *sizeRight;  // Free-block index: larger (size, address) keys
+    unsigned sizePriority;   // Free-block index: treap heap priority
+    struct Node *classPrev;  // Size-class bucket: previous FREE block in the same class
+    struct Node *classNext;  // Size-class bucket: next FREE block in the same class
+} Node;
+
+/** A contiguous run of Nodes; slabs are chained so cleanup can release them together. */
+typedef struct NodeSlab {
+    struct NodeSlab *next;
+    Node nodes[NODE_SLAB_SIZE];
+} NodeSlab;
+
+/** Interned process ID and the block it currently owns (NULL once released).
+ *  Merging and compaction only free FREE nodes, so block pointers stay valid. */
+typedef struct ProcessEntry {
+    char processId[PROCESS_ID_SIZE];
+    Node *block;
+    int buddyLeaf;  // Buddy engine: leaf index of the owned block, -1 if none
+    AllocatorSize arrayStart; // Array engine: start address of the owned block, -1 if none
+    AllocatorSize bitmapStart; // Bitmap engine: first granule of the owned block, -1 if none
+    AllocatorSize bitmapRequested; // Bitmap engine: bytes actually requested for the owned block
+    unsigned char alignShift; // log2 of the alignment the owned block keeps through compaction and resize
+    int waitEntry;  // Wait queue entry while the process is parked, -1 if none
+    int nextFree;   // Next retired handle while this one sits on the free list, PROCESS_LIVE while interned
+    unsigned generation; // Times the handle was retired; tags public handles so stale ones miss
+} ProcessEntry;
+
+/** Buddy engine state. Leaves are 2^BUDDY_MIN_ORDER bytes and indexed by int, which
+ *  caps the engine at BUDDY_MAX_SIZE bytes. */
+typedef struct BuddyHeap {
+    int leafCount;              // Heap size in leaves
+    unsigned char *blockInfo;   // Per leaf: order | BUDDY_FREE_BIT at a block start, 0 inside a block
+    int *nextFree;              // Per leaf: next free block of the same order, -1 at the end
+    int *prevFree;              // Per leaf: previous free block of the same order, -1 at the head
+    int *owner;                 // Per leaf: owning process handle of an allocated block
+    AllocatorSize *requested;   // Per leaf: bytes actually requested for an allocated block
+    int freeHeads[BUDDY_MAX_ORDER]; // Head leaf of each order's free list, -1 if empty
+    int freeCounts[BUDDY_MAX_ORDER]; // Length of each order's free list
+    int freeBlockCount;         // Free buddy blocks of every order
+    AllocatorSize freeBytes;    // Bytes in free buddy blocks
+    AllocatorSize unusableBytes; // Tail bytes smaller than one leaf
+    AllocatorSize internalFragmentation; // Rounding waste summed over allocated blocks
+    int blockCount;             // Buddy blocks, free and allocated
+    int peakBlockCount;         // High-water mark of blockCount
+    long long splits;           // Blocks halved to serve a smaller order
+    long long merges;           // Buddy pairs joined into the next order
+} BuddyHeap;
+
+/** Placement scans over a run of freeSizes slots. Each set returns the slot the scalar loops
+ *  would; they differ only in how many sizes one instruction compares. */
+typedef struct FreeSizeKernels {
+    const char *name;
+    int (*firstAtLeast)(const AllocatorSize *, int, int, AllocatorSize);    // First and Next Fit
+    int (*smallestAtLeast)(const AllocatorSize *, int, int, AllocatorSize); // Best Fit without alignment
+} FreeSizeKernels;
+
+/** Array engine state: one entry per block in address order, split across parallel arrays
+ *  so a scan streams through only the fields it reads. Unused slots form a gap at gapStart,
+ *  [gapStart, gapStart + capacity - count), that moves to wherever the next edit happens. */
+typedef struct BlockArray {
+    AllocatorSize *starts;      // Per block: start address
+    AllocatorSize *sizes;       // Per block: size
+    AllocatorSize *freeSizes;   // Per block: size if FREE, 0 if allocated (what placement scans)
+    int *owners;                // Per block: owning process handle, -1 if FREE
+    int capacity;               // Slots in each array, gap included
+    int count;                  // Blocks
+    int gapStart;               // Index of the first gap slot
+    int peakCount;              // High-water mark of count
+    AllocatorSize freeBytes;    // Bytes in FREE blocks
+    AllocatorSize nextFitAddress; // Next Fit: the block holding this address starts the scan (-1 = first block)
+    AllocatorSize compactedBelow; // Blocks starting below this address are packed by compaction
+    const FreeSizeKernels *kernels; // First and Best Fit scans for this CPU
+} BlockArray;
+
+/** Bitmap engine state. Granules are 2^granuleShift bytes; an allocated block is a run of set
+ *  bits starting at a set bit of starts, and a FREE block is a maximal run of clear bits.
+ *  Each summary level holds one bit per word of the level below, so a search for a set or a
+ *  clear bit skips 64 words per summary bit and 4096 words per top-level bit. */
+typedef struct GranuleBitmap {
+    unsigned long long *used;   // Bit g set if granule g is allocated; bits past the last granule read as set
+    unsigned long long *starts; // Bit g set if an allocated block starts at granule g
+    unsigned long long *usedSummary[2]; // [0]: bit w set if used word w has a set bit; [1]: the same over [0]
+    unsigned long long *freeSummary[2]; // [0]: bit w set if used word w has a clear bit; [1]: the same over [0]
+    AllocatorSize granuleCount;  // Whole granules in the heap
+    AllocatorSize wordCount;     // Words in used and starts
+    AllocatorSize summaryWords[2]; // Words in each summary level
+    int granuleShift;            // log2 of the granule size
+    int *owners;                 // Open-addressing (linear probing) table of handle + 1 by start granule, 0 if empty
+    size_t ownerCapacity;        // Slot count, always a power of two
+    int ownerCount;              // Allocated blocks
+    int peakBlockCount;          // High-water mark of allocated blocks plus FREE runs
+    AllocatorSize freeGranules;  // Granules in FREE runs
+    AllocatorSize internalFragmentation; // Rounding waste summed over allocated blocks
+    AllocatorSize nextFitGranule; // Next Fit: the run holding this granule starts the scan
+    AllocatorSize compactedBelow; // Blocks starting below this granule are packed by compaction
+} GranuleBitmap;
+
+/** One ring slot. sequence == position means free for the producer claiming position;
+ *  sequence == position + 1 means it holds a handle the consumer can take. */
+typedef struct DeferredSlot {
+    atomic_size_t sequence;
+    AllocatorHandle handle;
+} DeferredSlot;
+
+/** Bounded lock-free multi-producer / single-consumer ring of process handles
+ *  (Vyukov's bounded queue with a single consumer). Producers claim slots with one CAS on
+ *  enqueuePosition; the owning thread pops without atomics read-modify-writes. */
+typedef struct DeferredQueue {
+    DeferredSlot *slots;
+    size_t mask;                  // Capacity - 1
+    size_t dequeuePosition;       // Touched only by the owning thread
+    long long applied;            // Releases applied by drains
+    long long misses;             // Handles that owned no block when drained
+    char separator[64];           // Keeps the producers' hot counter off the owner's cache line
+    atomic_size_t enqueuePosition;
+} DeferredQueue;
+
+/** One request parked by allocator_allocate_or_wait. */
+typedef struct WaitEntry {
+    AllocatorSize size;
+    AllocatorSize alignment;
+    AllocatorStrategy strategy;
+    int priority;
+    long long sequence;     // Arrival order: breaks priority ties, and is the whole key under FIFO
+    int handle;             // Parked process; -1 once cancelled while passed over by a wake
+    int sizeClass;          // Heap the entry waits in
+    int heapIndex;          // Position in that heap, -1 while passed over by a wake
+    int next;               // Next recycled entry, or next entry passed over by the current wake
+    AllocatorWaitCallback callback;
+    void *context;
+    AllocatorFuture *future; // Caller's future, may be NULL
+} WaitEntry;
+
+/** Binary heap of wait entries, best (per the wait policy) at index 0. */
+typedef struct WaitHeap {
+    int *entries;
+    int count;              // Entries in the heap
+    int members;            // Entries of this class, counting those a running wake passed over
+    int capacity;
+} WaitHeap;
+
+/** Parked requests, one heap per size class of the block they need. A wake only consults
+ *  the classes the largest FREE block could hold. */
+typedef struct WaitQueue {
+    WaitEntry *entries;           // Pool of entries, indexed by allocator->processes[].waitEntry
+    int capacity;                 // Allocated length of entries
+    int used;                     // Entries handed out at least once
+    int freeEntry;                // Head of the recycled entries, -1 if none
+    WaitHeap heaps[SIZE_CLASS_COUNT];
+    unsigned long long mask;      // Bit k set when heaps[k] is non-empty
+    int count;                    // Parked requests
+    long long nextSequence;
+    AllocatorWaitPolicy policy;
+    int waking;                   // Set while wakeWaiters runs, so callbacks do not nest wakes
+    int wakeAgain;                // A callback freed space while wakeWaiters ran
+    long long parked;             // Requests ever parked
+    long long woken;              // Parked requests placed by a wake
+    long long cancelled;          // Parked requests cancelled
+} WaitQueue;
+
+/** Fixed header at the start of a snapshot. */
+typedef struct SnapshotHeader {
+    char magic[8];          // SNAPSHOT_MAGIC
+    uint32_t version;       // SNAPSHOT_VERSION
+    uint32_t byteOrder;     // SNAPSHOT_BYTE_ORDER as written by the saving host
+    uint32_t engine;        // AllocatorEngine
+    uint32_t granuleShift;  // Bitmap engine: log2 of the granule size, else 0
+    int64_t totalSize;      // Heap size in bytes
+    int64_t blockCount;     // SnapshotBlock records that follow
+    uint64_t checksum;      // FNV-1a over the header (with this field zeroed) and the records
+} SnapshotHeader;
+
+/** One block of a snapshot, in address order. */
+typedef struct SnapshotBlock {
+    int64_t startAddress;
+    int64_t size;
+    int64_t requested;      // Bytes the owner asked for, 0 if FREE
+    uint8_t isFree;
+    uint8_t alignShift;     // log2 of the alignment the owner keeps
+    uint8_t reserved[6];
+    char processId[PROCESS_ID_SIZE]; // Owner, empty if FREE
+} SnapshotBlock;
+
+/** One pending item of allocator_allocate_many, sorted by (size, index). */
+typedef struct BulkItem {
+    AllocatorSize size;
+    int handle;
+    int index; // Position in the caller's request array
+} BulkItem;
+
+struct Allocator {
+    AllocatorEngine engine;
+    AllocatorSize lastAddressSpace; // Maximum address (size - 1)
+    Node *dummyHead;              // Sentinel; its availableSpace tracks total free space
+    Node *freeTreeRoot;           // Root of the (availableSpace, startAddress) index over FREE blocks
+    unsigned treapSeed;           // State for treap priorities (xorshift)
+    Node *sizeClassHeads[SIZE_CLASS_COUNT]; // Segregated free lists, one per size class
+    unsigned long long sizeClassMask; // Bit k set when sizeClassHeads[k] is non-empty
+    int sizeClassCounts[SIZE_CLASS_COUNT]; // Length of each segregated free list
+    int freeBlockCount;           // Indexed FREE blocks (every FREE block between API calls)
+    AllocatorSize largestFree;    // Array and bitmap engines: largest FREE size (bytes) added since the last rescan
+    int largestFreeCount;         // FREE blocks of exactly largestFree bytes
+    int largestFreeStale;         // Set when the last of them went; a larger FREE block may remain
+    Node *nextFitCursor;          // Next Fit: block where the next scan starts (NULL = list head)
+    Node *compactionFrontier;     // Last block of the packed allocated prefix (dummyHead if none)
+    long long blocksMoved;        // Blocks relocated by compaction
+    long long bytesMoved;         // Bytes relocated by compaction
+    long long resizesInPlace;     // Resizes served without moving the block
+    long long resizesMoved;       // Resizes that had to move the block
+    AllocatorRelocationVisitor relocationVisitor; // Told about each run compaction moves
+    void *relocationContext;
+    AllocatorRelocation pendingRun; // Run being extended; blockCount 0 when empty
+    unsigned char *backing;       // Real buffer behind [0, lastAddressSpace], NULL if simulated
+    size_t pageSize;              // Host page size, for remapping and discarding
+    long long bytesCopied;        // Backed mode: bytes compaction moved with memmove
+    long long bytesRemapped;      // Backed mode: bytes compaction moved by remapping pages
+    long long bytesDiscarded;     // Backed mode: bytes of free pages handed back to the OS
+    ProcessEntry *processes;      // Interned processes, indexed by handle
+    int processCount;             // Handles issued so far, live or retired
+    int liveProcessCount;         // Handles currently interned
+    int freeProcess;              // Most recently retired handle, -1 if none
+    int processCapacity;          // Allocated length of processes
+    int *processSlots;            // Open-addressing (linear probing) table of handle + 1, 0 if empty
+    size_t processSlotCapacity;   // Slot count, always a power of two
+    NodeSlab *nodeSlabs;          // Every slab allocated so far
+    Node *freeNodes;              // Recycled nodes, chained through next
+    int nodeCount;                // Nodes handed out by the pool, including dummyHead
+    int peakNodeCount;            // High-water mark of nodeCount
+    long long nodeAllocations;    // Nodes taken from the pool
+    long long nodeReleases;       // Nodes returned to the pool
+    long long slabAllocations;    // Slabs malloc'd to refill the pool
+    long long splits;             // FREE blocks carved off by createFreeBlock
+    long long merges;             // FREE blocks absorbed into a FREE predecessor
+    AllocatorScanStats scans[ALLOCATOR_STRATEGY_COUNT]; // Nodes visited per strategy
+    BuddyHeap buddy;              // Buddy engine state
+    BlockArray array;             // Array engine state
+    GranuleBitmap bitmap;         // Bitmap engine state
+    DeferredQueue deferred;       // Releases queued by other threads (slots NULL until enabled)
+    WaitQueue waits;              // Requests parked until space frees up
+    AllocatorCompactionPolicy compaction; // Automatic compaction (threshold 0 and no compactOnFailure: off)
+    int policyCalls;              // Allocate, resize and release calls since the policy last looked
+    int policyCompacting;         // The policy started a compaction that has not finished
+    int policySettled;            // Fully compacted by the policy, and nothing has been freed since
+    long long policySteps;        // Steps the policy ran
+    long long failureCompactions; // Full compactions the policy ran for a failed allocation
+};
+
+/** Makes sure the pool holds at least two recycled Nodes, enough to split free space off
+ *  both ends of a block. Returns 0 if host memory ran out. */
+static int reserveNode(Allocator *allocator) {
+    if (allocator->freeNodes && allocator->freeNodes->next)
+        return 1;
+    NodeSlab *slab = (NodeSlab *)malloc(sizeof(NodeSlab));
+    if (!slab)
+        return 0;
+    slab->next = allocator->nodeSlabs;
+    allocator->nodeSlabs = slab;
+    allocator->slabAllocations++;
+    for (int i = NODE_SLAB_SIZE - 1; i >= 0; i--) {
+        slab->nodes[i].next = allocator->freeNodes;
+        allocator->freeNodes = &slab->nodes[i];
+    }
+    return 1;
+}
+
+/** Takes a Node from the pool. Callers reserve one beforehand, so this cannot fail. */
+static Node *allocateNode(Allocator *allocator) {
+    Node *node = allocator->freeNodes;
+    allocator->freeNodes = node->next;
+    allocator->nodeAllocations++;
+    if (++allocator->nodeCount > allocator->peakNodeCount)
+        allocator->peakNodeCount = allocator->nodeCount;
+    return node;
+}
+
+/** Returns a Node to the pool. */
+static void releaseNode(Allocator *allocator, Node *node) {
+    node->next = allocator->freeNodes;
+    allocator->freeNodes = node;
+    allocator->nodeCount--;
+    allocator->nodeReleases++;
+}
+
+/** FNV-1a hash of a process ID. */
+static size_t hashProcessId(const char *processId) {
+    size_t hash = 2166136261u;
+    while (*processId) {
+        hash ^= (unsigned char)*processId++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/** Returns the slot holding processId, or the empty slot where it would be inserted. */
+static int *probeProcessSlots(const Allocator *allocator, int *slots, size_t capacity, const char *processId) {
+    size_t slot = hashProcessId(processId) & (capacity - 1);
+    while (slots[slot] && strcmp(allocator->processes[slots[slot] - 1].processId, processId) != 0)
+        slot = (slot + 1) & (capacity - 1);
+    return &slots[slot];
+}
+
+/** Doubles the slot table and rehashes every interned ID. Returns 0 if host memory ran out. */
+static int growProcessSlots(Allocator *allocator) {
+    size_t newCapacity = allocator->processSlotCapacity ? allocator->processSlotCapacity * 2 : PROCESS_TABLE_MIN_CAPACITY;
+    int *newSlots = (int *)calloc(newCapacity, sizeof(int));
+    if (!newSlots)
+        return 0;
+    for (int handle = 0; handle < allocator->processCount; handle++)
+        if (allocator->processes[handle].nextFree == PROCESS_LIVE)
+            *probeProcessSlots(allocator, newSlots, newCapacity, allocator->processes[handle].processId) = handle + 1;
+    free(allocator->processSlots);
+    allocator->processSlots = newSlots;
+    allocator->processSlotCapacity = newCapacity;
+    return 1;
+}
+
+/** Returns 1 if processId is non-NULL and fits in PROCESS_ID_SIZE bytes with its terminator. */
+static int validProcessId(const char *processId) {
+    if (!processId)
+        return 0;
+    size_t length = 0;
+    while (length < PROCESS_ID_SIZE && processId[length])
+        length++;
+    return length < PROCESS_ID_SIZE;
+}
+
+/** Returns the handle for processId, or -1 if it is not interned. */
+static int lookupProcess(const Allocator *allocator, const char *processId) {
+    if (!allocator->processSlotCapacity)
+        return -1;
+    return *probeProcessSlots(allocator, allocator->processSlots, allocator->processSlotCapacity, processId) - 1;
+}
+
+/** Returns the handle for processId, interning it first if needed. Returns -1 if host memory ran out. */
+static int internProcess(Allocator *allocator, const char *processId) {
+    if ((size_t)(allocator->liveProcessCount + 1) * 2 > allocator->processSlotCapacity && !growProcessSlots(allocator))
+        return -1;
+    int *slot = probeProcessSlots(allocator, allocator->processSlots, allocator->processSlotCapacity, processId);
+    if (*slot)
+        return *slot - 1;
+    int handle = allocator->freeProcess;
+    if (handle >= 0) {
+        allocator->freeProcess = allocator->processes[handle].nextFree;
+    } else if (allocator->processCount == allocator->processCapacity) {
+        int newCapacity = allocator->processCapacity ? allocator->processCapacity * 2 : PROCESS_TABLE_MIN_CAPACITY;
+        ProcessEntry *grown = (ProcessEntry *)realloc(allocator->processes, newCapacity * sizeof(ProcessEntry));
+        if (!grown)
+            return -1;
+        allocator->processes = grown;
+        allocator->processCapacity = newCapacity;
+    }
+    if (handle < 0) {
+        handle = allocator->processCount++;
+        allocator->processes[handle].generation = 0;
+    }
+    ProcessEntry *entry = &allocator->processes[handle];
+    strncpy(entry->processId, processId, PROCESS_ID_SIZE - 1);
+    entry->processId[PROCESS_ID_SIZE - 1] = '\0';
+    entry->block = NULL;
+    entry->buddyLeaf = -1;
+    entry->arrayStart = -1;
+    entry->bitmapStart = -1;
+    entry->waitEntry = -1;
+    entry->bitmapRequested = 0;
+    entry->alignShift = 0;
+    entry->nextFree = PROCESS_LIVE;
+    allocator->liveProcessCount++;
+    *slot = handle + 1;
+    return handle;
+}
+
+/** Returns 1 if the process with this handle currently owns a block. */
+static int processOwnsBlock(const Allocator *allocator, int handle) {
+    return handle >= 0 && (allocator->processes[handle].block || allocator->processes[handle].buddyLeaf >= 0 ||
+                           allocator->processes[handle].arrayStart >= 0 || allocator->processes[handle].bitmapStart >= 0);
+}
+
+/** Returns 1 if handle's process has a request parked in the wait queue. */
+static int processWaiting(const Allocator *allocator, int handle) {
+    return handle >= 0 && allocator->processes[handle].waitEntry >= 0;
+}
+
+/** Forgets the process with this handle once it owns no block and is not parked, so churn
+ *  through distinct IDs does not grow the table. Its slot is emptied by shifting later
+ *  entries of the probe run back, and the handle goes on the free list under a new
+ *  generation. */
+static void retireProcess(Allocator *allocator, int handle) {
+    if (handle < 0 || allocator->processes[handle].nextFree != PROCESS_LIVE || processOwnsBlock(allocator, handle) ||
+        processWaiting(allocator, handle))
+        return;
+    ProcessEntry *entry = &allocator->processes[handle];
+    int *slots = allocator->processSlots;
+    size_t capacity = allocator->processSlotCapacity, mask = capacity - 1;
+    size_t hole = (size_t)(probeProcessSlots(allocator, slots, capacity, entry->processId) - slots);
+    for (size_t slot = (hole + 1) & mask; slots[slot]; slot = (slot + 1) & mask) {
+        size_t home = hashProcessId(allocator->processes[slots[slot] - 1].processId) & mask;
+        if (hole <= slot ? home > hole && home <= slot : home > hole || home <= slot)
+            continue; // Still reachable from its home slot
+        slots[hole] = slots[slot];
+        hole = slot;
+    }
+    slots[hole] = 0;
+    entry->generation = (entry->generation + 1) & 0x7fffffffu;
+    entry->nextFree = allocator->freeProcess;
+    allocator->freeProcess = handle;
+    allocator->liveProcessCount--;
+}
+
+/** Returns the public handle of the process with this handle, or -1 for none. */
+static AllocatorHandle publicHandle(const Allocator *allocator, int handle) {
+    if (handle < 0)
+        return -1;
+    return (AllocatorHandle)allocator->processes[handle].generation << HANDLE_SLOT_BITS | (AllocatorHandle)handle;
+}
+
+/** Returns the handle a public handle names, or -1 if it is malformed or its process has
+ *  been retired since. */
+static int handleFromPublic(const Allocator *allocator, AllocatorHandle handle) {
+    AllocatorHandle index = handle & (((AllocatorHandle)1 << HANDLE_SLOT_BITS) - 1);
+    if (handle < 0 || index >= allocator->processCount)
+        return -1;
+    const ProcessEntry *entry = &allocator->processes[index];
+    if (entry->nextFree != PROCESS_LIVE || entry->generation != (unsigned)(handle >> HANDLE_SLOT_BITS))
+        return -1;
+    return (int)index;
+}
+
+/** Returns the alignment the block owned by handle must keep. */
+static AllocatorSize processAlignment(const Allocator *allocator, int handle) {
+    return (AllocatorSize)1 << allocator->processes[handle].alignShift;
+}
+
+/** Orders free blocks by size, then start address (node address breaks stale-address ties). */
+static int compareFreeKey(const Node *a, const Node *b) {
+    if (a->availableSpace != b->availableSpace)
+        return a->availableSpace < b->availableSpace ? -1 : 1;
+    if (a->startAddress != b->startAddress)
+        return a->startAddress < b->startAddress ? -1 : 1;
+    if (a != b)
+        return a < b ? -1 : 1;
+    return 0;
+}
+
+/** Inserts a block into the treap rooted at root and returns the new root. */
+static Node *treapInsert(Node *root, Node *block) {
+    if (!root)
+        return block;
+    if (compareFreeKey(block, root) < 0) {
+        root->sizeLeft = treapInsert(root->sizeLeft, block);
+        if (root->sizeLeft->sizePriority > root->sizePriority) {
+            Node *pivot = root->sizeLeft;
+            root->sizeLeft = pivot->sizeRight;
+            pivot->sizeRight = root;
+            return pivot;
+        }
+    } else {
+        root->sizeRight = treapInsert(root->sizeRight, block);
+        if (root->sizeRight->sizePriority > root->sizePriority) {
+            Node *pivot = root->sizeRight;
+            root->sizeRight = pivot->sizeLeft;
+            pivot->sizeLeft = root;
+            return pivot;
+        }
+    }
+    return root;
+}
+
+/** Joins two treaps where every key in left precedes every key in right. */
+static Node *treapJoin(Node *left, Node *right) {
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+    if (left->sizePriority > right->sizePriority) {
+        left->sizeRight = treapJoin(left->sizeRight, right);
+        return left;
+    }
+    right->sizeLeft = treapJoin(left, right->sizeLeft);
+    return right;
+}
+
+/** Removes a block from the treap rooted at root and returns the new root. */
+static Node *treapRemove(Node *root, Node *block) {
+    if (!root)
+        return NULL;
+    int cmp = compareFreeKey(block, root);
+    if (cmp < 0)
+        root->sizeLeft = treapRemove(root->sizeLeft, block);
+    else if (cmp > 0)
+        root->sizeRight = treapRemove(root->sizeRight, block);
+    else
+        return treapJoin(root->sizeLeft, root->sizeRight);
+    return root;
+}
+
+/** Returns the size class of a block size: floor(log2(size)), 0 for sizes below 2. */
+static int sizeClass(AllocatorSize size) {
+    if (size < 2)
+        return 0;
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll((unsigned long long)size);
+#else
+    int sizeClassIndex = 0;
+    while (size >>= 1)
+        sizeClassIndex++;
+    return sizeClassIndex;
+#endif
+}
+
+/** Returns the lowest non-empty size class in mask. mask must be non-zero. */
+static int lowestSizeClass(unsigned long long mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int sizeClassIndex = 0;
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        sizeClassIndex++;
+    }
+    return sizeClassIndex;
+#endif
+}
+
+/** Adds a FREE block to the size index. Call after its size and address are final. */
+static void insertFreeIndex(Allocator *allocator, Node *block) {
+    allocator->treapSeed ^= allocator->treapSeed << 13;
+    allocator->treapSeed ^= allocator->treapSeed >> 17;
+    allocator->treapSeed ^= allocator->treapSeed << 5;
+    block->sizePriority = allocator->treapSeed;
+    block->sizeLeft = block->sizeRight = NULL;
+    allocator->freeTreeRoot = treapInsert(allocator->freeTreeRoot, block);
+
+    int sizeClassIndex = sizeClass(block->availableSpace);
+    block->classPrev = NULL;
+    block->classNext = allocator->sizeClassHeads[sizeClassIndex];
+    if (block->classNext)
+        block->classNext->classPrev = block;
+    allocator->sizeClassHeads[sizeClassIndex] = block;
+    allocator->sizeClassMask |= 1ull << sizeClassIndex;
+    allocator->sizeClassCounts[sizeClassIndex]++;
+    allocator->freeBlockCount++;
+}
+
+/** Removes a FREE block from the size index. Call before changing its size or address. */
+static void removeFreeIndex(Allocator *allocator, Node *block) {
+    allocator->freeTreeRoot = treapRemove(allocator->freeTreeRoot, block);
+    block->sizeLeft = block->sizeRight = NULL;
+
+    int sizeClassIndex = sizeClass(block->availableSpace);
+    if (block->classPrev)
+        block->classPrev->classNext = block->classNext;
+    else
+        allocator->sizeClassHeads[sizeClassIndex] = block->classNext;
+    if (block->classNext)
+        block->classNext->classPrev = block->classPrev;
+    if (!allocator->sizeClassHeads[sizeClassIndex])
+        allocator->sizeClassMask &= ~(1ull << sizeClassIndex);
+    block->classPrev = block->classNext = NULL;
+    allocator->sizeClassCounts[sizeClassIndex]--;
+    allocator->freeBlockCount--;
+}
+
+/** Returns the bytes to skip from address up to the next multiple of alignment (a power of two). */
+static AllocatorSize alignmentPadding(AllocatorSize address, AllocatorSize alignment) {
+    return (alignment - (address & (alignment - 1))) & (alignment - 1);
+}
+
+/** Returns 1 if a FREE block can hold spaceRequested bytes starting at an aligned address. */
+static int blockFits(const Node *block, AllocatorSize spaceRequested, AllocatorSize alignment) {
+    AllocatorSize padding = alignmentPadding(block->startAddress, alignment);
+    return block->availableSpace >= spaceRequested && block->availableSpace - spaceRequested >= padding;
+}
+
+/** Template of findSegregatedFitBlock. */
+SCAN_TEMPLATE Node *scanSegregatedFit(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                                      AllocatorScanStats *scan) {
+    int sizeClassIndex = sizeClass(spaceRequested);
+    Node *block = allocator->sizeClassHeads[sizeClassIndex];
+    for (int probes = 0; block && probes < SEGREGATED_FIT_PROBES; probes++, block = block->classNext) {
+        COUNT_VISITS(scan, 1);
+        if (blockFits(block, spaceRequested, alignment))
+            return block;
+    }
+    unsigned long long largerClasses = sizeClassIndex + 1 < SIZE_CLASS_COUNT
+                                       ? allocator->sizeClassMask & ~((2ull << sizeClassIndex) - 1) : 0;
+    while (largerClasses) { // Without alignment padding the first head always fits
+        Node *head = allocator->sizeClassHeads[lowestSizeClass(largerClasses)];
+        COUNT_VISITS(scan, 1);
+        if (blockFits(head, spaceRequested, alignment))
+            return head;
+        largerClasses &= largerClasses - 1;
+    }
+    for (; block; block = block->classNext) {
+        COUNT_VISITS(scan, 1);
+        if (blockFits(block, spaceRequested, alignment))
+            return block;
+    }
+    return NULL;
+}
+
+/** Finds a FREE block for Segregated Fit: a few probes in the request's own class,
+ *  then the head of the next non-empty larger class that fits, then the rest of the own class. */
+static Node *findSegregatedFitBlock(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                                    AllocatorScanStats *scan) {
+    return alignment == 1 ? scanSegregatedFit(allocator, spaceRequested, 1, scan)
+                          : scanSegregatedFit(allocator, spaceRequested, alignment, scan);
+}
+
+/** Returns the first block in (size, address) order under node that fits with alignment
+ *  padding. Subtrees of blocks too small to hold spaceRequested are skipped. */
+static Node *findAlignedBestFit(Node *node, AllocatorSize spaceRequested, AllocatorSize alignment, AllocatorScanStats *scan) {
+    while (node) {
+        COUNT_VISITS(scan, 1);
+        if (node->availableSpace < spaceRequested) {
+            node = node->sizeRight;
+            continue;
+        }
+        Node *smaller = findAlignedBestFit(node->sizeLeft, spaceRequested, alignment, scan);
+        if (smaller)
+            return smaller;
+        if (blockFits(node, spaceRequested, alignment))
+            return node;
+        node = node->sizeRight;
+    }
+    return NULL;
+}
+
+/** Returns the last block in (size, address) order under node that fits with alignment padding. */
+static Node *findAlignedLargestFit(Node *node, AllocatorSize spaceRequested, AllocatorSize alignment, AllocatorScanStats *scan) {
+    while (node) {
+        COUNT_VISITS(scan, 1);
+        Node *larger = findAlignedLargestFit(node->sizeRight, spaceRequested, alignment, scan);
+        if (larger)
+            return larger;
+        if (node->availableSpace < spaceRequested)
+            return NULL; // Everything to the left is smaller still
+        if (blockFits(node, spaceRequested, alignment))
+            return node;
+        node = node->sizeLeft;
+    }
+    return NULL;
+}
+
+/** Returns the smallest FREE block that can hold spaceRequested aligned bytes, or NULL. */
+static Node *findBestFitBlock(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                              AllocatorScanStats *scan) {
+    if (alignment > 1)
+        return findAlignedBestFit(allocator->freeTreeRoot, spaceRequested, alignment, scan);
+    Node *best = NULL;
+    Node *node = allocator->freeTreeRoot;
+    while (node) {
+        COUNT_VISITS(scan, 1);
+        if (node->availableSpace >= spaceRequested) {
+            best = node;
+            node = node->sizeLeft;
+        } else {
+            node = node->sizeRight;
+        }
+    }
+    return best;
+}
+
+/** Returns the largest FREE block (lowest address among equals), or NULL if there is none. */
+static Node *findLargestFreeBlock(const Allocator *allocator, AllocatorScanStats *scan) {
+    Node *node = allocator->freeTreeRoot;
+    while (node && node->sizeRight) {
+        COUNT_VISITS(scan, 1);
+        node = node->sizeRight;
+    }
+    return node ? findBestFitBlock(allocator, node->availableSpace, 1, scan) : NULL;
+}
+
+/** Template of findFirstFitBlock. */
+SCAN_TEMPLATE Node *scanFirstFit(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                                 AllocatorScanStats *scan) {
+    for (Node *block = allocator->dummyHead->next; block; block = block->next) {
+        COUNT_VISITS(scan, 1);
+        if (block->state == BLOCK_FREE && blockFits(block, spaceRequested, alignment))
+            return block;
+    }
+    return NULL;
+}
+
+/** Returns the first FREE block in address order that can hold spaceRequested aligned bytes. */
+static Node *findFirstFitBlock(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                               AllocatorScanStats *scan) {
+    return alignment == 1 ? scanFirstFit(allocator, spaceRequested, 1, scan)
+                          : scanFirstFit(allocator, spaceRequested, alignment, scan);
+}
+
+/** Template of findNextFitBlock. */
+SCAN_TEMPLATE Node *scanNextFit(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                                AllocatorScanStats *scan) {
+    Node *start = allocator->nextFitCursor ? allocator->nextFitCursor : allocator->dummyHead->next;
+    Node *block = start;
+    while (block) {
+        COUNT_VISITS(scan, 1);
+        if (block->state == BLOCK_FREE && blockFits(block, spaceRequested, alignment))
+            return block;
+        block = block->next ? block->next : allocator->dummyHead->next;
+        if (block == start)
+            return NULL;
+    }
+    return NULL;
+}
+
+/** Returns the first fitting FREE block at or after the Next Fit cursor, wrapping to the head once. */
+static Node *findNextFitBlock(const Allocator *allocator, AllocatorSize spaceRequested, AllocatorSize alignment,
+                              AllocatorScanStats *scan) {
+    return alignment == 1 ? scanNextFit(allocator, spaceRequested, 1, scan)
+                          : scanNextFit(allocator, spaceRequested, alignment, scan);
+}
+
+/** Creates a new free block of leftoverSpace bytes right after the given block. */
+static void createFreeBlock(Allocator *allocator, Node *allocatedBlock, AllocatorSize leftoverSpace) {
+    Node *newFreeBlock = allocateNode(allocator);
+    allocator->splits++;
+    newFreeBlock->state = BLOCK_FREE;
+    newFreeBlock->owner = -1;
+    newFreeBlock->availableSpace = leftoverSpace;
+    newFreeBlock->startAddress = allocatedBlock->endAddress + 1;
+    newFreeBlock->endAddress = newFreeBlock->startAddress + leftoverSpace - 1;
+    if (newFreeBlock->endAddress > allocator->lastAddressSpace)
+        newFreeBlock->endAddress = allocator->lastAddressSpace;
+    newFreeBlock->next = allocatedBlock->next;
+    newFreeBlock->prev = allocatedBlock;
+    if (newFreeBlock->next)
+        newFreeBlock->next->prev = newFreeBlock;
+    allocatedBlock->next = newFreeBlock;
+    insertFreeIndex(allocator, newFreeBlock);
+}
+
+/** Absorbs block->next into block. Both must be FREE. */
+static void absorbNextFreeBlock(Allocator *allocator, Node *block) {
+    Node *tempNode = block->next;
+    removeFreeIndex(allocator, block);
+    removeFreeIndex(allocator, tempNode);
+    block->endAddress = tempNode->endAddress;
+    block->availableSpace += tempNode->availableSpace;
+    block->next = tempNode->next;
+    if (block->next)
+        block->next->prev = block;
+    if (allocator->nextFitCursor == tempNode)
+        allocator->nextFitCursor = block;
+    releaseNode(allocator, tempNode);
+    allocator->merges++;
+    insertFreeIndex(allocator, block);
+}
+
+/** Coalesces a FREE block with its FREE neighbours in O(1). Returns the surviving block. */
+static Node *coalesceFreeBlock(Allocator *allocator, Node *block) {
+    if (block->next && block->next->state == BLOCK_FREE)
+        absorbNextFreeBlock(allocator, block);
+    if (block->prev->state == BLOCK_FREE) {
+        block = block->prev;
+        absorbNextFreeBlock(allocator, block);
+    }
+    return block;
+}
+
+/* ---------------------------------------------------------------------------
+ * Backing store. In backed mode the address range is a real mapping; compaction
+ * moves the bytes and free page runs are returned to the OS.
+ * ------------------------------------------------------------------------- */
+
+/** Returns the host page size. */
+static size_t hostPageSize(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+/** Maps size bytes of zeroed, private read-write memory. Returns NULL on failure. */
+static unsigned char *mapBacking(size_t size) {
+#if defined(_WIN32)
+    return (unsigned char *)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return base == MAP_FAILED ? NULL : (unsigned char *)base;
+#endif
+}
+
+/** Unmaps a buffer returned by mapBacking. */
+static void unmapBacking(unsigned char *base, size_t size) {
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, size);
+#endif
+}
+
+/** Tells the OS the page-aligned range [start, start + length) holds no live data. */
+static void discardPages(unsigned char *start, size_t length) {
+#if defined(_WIN32)
+    VirtualAlloc(start, length, MEM_RESET, PAGE_READWRITE);
+#else
+    madvise(start, length, MADV_DONTNEED);
+#endif
+}
+
+/** Moves page-aligned length bytes from source to a non-overlapping destination by
+ *  remapping the pages. MREMAP_DONTUNMAP leaves source mapped and reading as zeroes, so
+ *  the buffer never has a hole another thread's mmap could land in. Returns 0 if the
+ *  platform or kernel cannot remap this way, in which case nothing has changed. */
+static int remapPages(unsigned char *source, unsigned char *destination, size_t length) {
+#if defined(__linux__)
+#ifndef MREMAP_DONTUNMAP
+#define MREMAP_DONTUNMAP 4 // Linux 5.7+; older kernels reject it with EINVAL
+#endif
+    return mremap(source, length, length, MREMAP_MAYMOVE | MREMAP_FIXED | MREMAP_DONTUNMAP, destination) != MAP_FAILED;
+#else
+    (void)source;
+    (void)destination;
+    (void)length;
+    return 0;
+#endif
+}
+
+/** Moves a relocation run's bytes, remapping its whole pages when the run is large,
+ *  page-congruent and does not overlap itself, and copying everything else. */
+static void moveBackedRun(Allocator *allocator, const AllocatorRelocation *run) {
+    size_t page = allocator->pageSize;
+    size_t oldStart = (size_t)run->oldStart, newStart = (size_t)run->newStart, size = (size_t)run->size;
+    size_t distance = oldStart - newStart;
+    if (size >= BACKING_REMAP_THRESHOLD && distance % page == 0 && distance >= size) {
+        size_t innerStart = (oldStart + page - 1) / page * page;
+        size_t innerEnd = (oldStart + size) / page * page;
+        if (innerEnd > innerStart &&
+            remapPages(allocator->backing + innerStart, allocator->backing + innerStart - distance, innerEnd - innerStart)) {
+            memmove(allocator->backing + newStart, allocator->backing + oldStart, innerStart - oldStart);
+            memmove(allocator->backing + innerEnd - distance, allocator->backing + innerEnd, oldStart + size - innerEnd);
+            allocator->bytesRemapped += innerEnd - innerStart;
+            allocator->bytesCopied += size - (innerEnd - innerStart);
+            return;
+        }
+    }
+    memmove(allocator->backing + newStart, allocator->backing + oldStart, size);
+    allocator->bytesCopied += size;
+}
+
+/** Returns to the OS the whole pages of the FREE range [freeStart, freeEnd] that overlap
+ *  [touchedStart, touchedEnd], the bytes that just became free. */
+static void discardFreePages(Allocator *allocator, AllocatorSize freeStart, AllocatorSize freeEnd,
+                             AllocatorSize touchedStart, AllocatorSize touchedEnd) {
+    if (!allocator->backing)
+        return;
+    size_t page = allocator->pageSize;
+    size_t start = ((size_t)freeStart + page - 1) / page * page;
+    size_t end = ((size_t)freeEnd + 1) / page * page;
+    size_t touchedFirst = (size_t)touchedStart / page * page;
+    size_t touchedLast = ((size_t)touchedEnd + page) / page * page;
+    if (start < touchedFirst)
+        start = touchedFirst;
+    if (end > touchedLast)
+        end = touchedLast;
+    if (end > start && end - start >= BACKING_DISCARD_THRESHOLD) {
+        discardPages(allocator->backing + start, end - start);
+        allocator->bytesDiscarded += end - start;
+    }
+}
+
+/** Moves the pending relocation run's bytes (backed mode), hands it to the visitor and clears it. */
+static void flushRelocationRun(Allocator *allocator) {
+    if (!allocator->pendingRun.blockCount)
+        return;
+    if (allocator->backing)
+        moveBackedRun(allocator, &allocator->pendingRun);
+    if (allocator->relocationVisitor)
+        allocator->relocationVisitor(&allocator->pendingRun, allocator->relocationContext);
+    allocator->pendingRun.blockCount = 0;
+}
+
+/** Records one block move, extending the pending run when the block sat right after it
+ *  and moved by the same distance. */
+static void noteRelocation(Allocator *allocator, AllocatorSize oldStart, AllocatorSize newStart, AllocatorSize size) {
+    AllocatorRelocation *run = &allocator->pendingRun;
+    if (run->blockCount && run->oldStart + run->size == oldStart && run->newStart + run->size == newStart) {
+        run->size += size;
+        run->blockCount++;
+        return;
+    }
+    flushRelocationRun(allocator);
+    run->oldStart = oldStart;
+    run->newStart = newStart;
+    run->size = size;
+    run->blockCount = 1;
+}
+
+/** Slides allocated blocks down over the FREE gap that follows the compaction frontier.
+ *  Each move swaps an allocated block with the gap before it, rewriting both addresses,
+ *  and folds any FREE block behind the gap into it. Stops after maxBlocks moves or once
+ *  maxBytes have been moved (0 means no limit), but always makes one move of progress.
+ *  Aligned blocks land on their next aligned address, leaving the padding FREE.
+ *  Returns 1 once every allocated block is packed at the bottom of the heap. */
+static int slideAllocatedBlocks(Allocator *allocator, int maxBlocks, AllocatorSize maxBytes) {
+    Node *frontier = allocator->compactionFrontier;
+    int movedBlocks = 0;
+    AllocatorSize movedBytes = 0;
+    for (;;) {
+        Node *gap = frontier->next;
+        while (gap && gap->state == BLOCK_ALLOCATED) { // Already packed: advance past it
+            frontier = gap;
+            gap = gap->next;
+        }
+        if (!gap || !gap->next)
+            break; // No free space, or it is all in the final block
+        Node *block = gap->next;
+        if (block->state == BLOCK_FREE) {
+            absorbNextFreeBlock(allocator, gap);
+            continue;
+        }
+        AllocatorSize padding = alignmentPadding(gap->startAddress, processAlignment(allocator, block->owner));
+        if (padding >= gap->availableSpace || (padding > 0 && !reserveNode(allocator))) {
+            frontier = block; // Its alignment pins the block in place; the gap stays behind as padding
+            continue;
+        }
+        if (movedBlocks > 0 && ((maxBlocks > 0 && movedBlocks >= maxBlocks) ||
+                                (maxBytes > 0 && movedBytes + block->availableSpace > maxBytes))) {
+            allocator->compactionFrontier = frontier;
+            flushRelocationRun(allocator);
+            return 0;
+        }
+
+        removeFreeIndex(allocator, gap);
+        Node *before = frontier;
+        if (padding > 0) { // The aligned slot starts inside the gap: its head stays FREE
+            createFreeBlock(allocator, frontier, padding);
+            before = frontier->next;
+            gap->startAddress += padding;
+            gap->availableSpace -= padding;
+        }
+        noteRelocation(allocator, block->startAddress, gap->startAddress, block->availableSpace);
+        block->startAddress = gap->startAddress;
+        block->endAddress = block->startAddress + block->availableSpace - 1;
+        gap->startAddress = block->endAddress + 1;
+        gap->endAddress = gap->startAddress + gap->availableSpace - 1;
+        before->next = block;
+        block->prev = before;
+        gap->next = block->next;
+        if (gap->next)
+            gap->next->prev = gap;
+        block->next = gap;
+        gap->prev = block;
+        insertFreeIndex(allocator, gap);
+        if (gap->next && gap->next->state == BLOCK_FREE)
+            absorbNextFreeBlock(allocator, gap);
+
+        allocator->blocksMoved++;
+        allocator->bytesMoved += block->availableSpace;
+        movedBlocks++;
+        movedBytes += block->availableSpace;
+        frontier = block;
+    }
+    allocator->compactionFrontier = frontier;
+    flushRelocationRun(allocator);
+    Node *top = frontier->next;
+    if (top && movedBlocks > 0)
+        discardFreePages(allocator, top->startAddress, top->endAddress, top->startAddress, top->endAddress);
+    return 1;
+}
+
+/** Marks a FREE block as owned by handle, splitting the alignment padding off its head
+ *  and any leftover space off its tail as FREE blocks. */
+static void placeProcess(Allocator *allocator, Node *block, int handle, AllocatorSize spaceRequested,
+                         AllocatorSize alignment) {
+    removeFreeIndex(allocator, block);
+    AllocatorSize padding = alignmentPadding(block->startAddress, alignment);
+    if (padding > 0) {
+        block->startAddress += padding;
+        block->availableSpace -= padding;
+        createFreeBlock(allocator, block->prev, padding);
+    }
+    allocator->dummyHead->availableSpace -= spaceRequested;
+    block->state = BLOCK_ALLOCATED;
+    block->owner = handle;
+    allocator->processes[handle].block = block;
+    block->endAddress = block->startAddress + spaceRequested - 1;
+    AllocatorSize leftoverSpace = block->availableSpace - spaceRequested;
+    block->availableSpace = spaceRequested;
+    if (leftoverSpace > 0)
+        createFreeBlock(allocator, block, leftoverSpace);
+}
+
+/** Places a request with the list engine's chosen strategy. Returns the block or NULL. */
+static Node *listAllocate(Allocator *allocator, int handle, AllocatorSize spaceRequested, AllocatorSize alignment,
+                          AllocatorStrategy strategy) {
+    AllocatorScanStats *scan = &allocator->scans[strategy];
+    Node *block = NULL;
+    scan->requests++;
+    switch (strategy) {
+    case ALLOCATOR_FIRST_FIT:
+        block = findFirstFitBlock(allocator, spaceRequested, alignment, scan);
+        break;
+    case ALLOCATOR_NEXT_FIT:
+        block = findNextFitBlock(allocator, spaceRequested, alignment, scan);
+        break;
+    case ALLOCATOR_BEST_FIT:
+        block = findBestFitBlock(allocator, spaceRequested, alignment, scan);
+        break;
+    case ALLOCATOR_WORST_FIT:
+        block = findLargestFreeBlock(allocator, scan);
+        if (block && !blockFits(block, spaceRequested, alignment))
+            block = alignment > 1 ? findAlignedLargestFit(allocator->freeTreeRoot, spaceRequested, alignment, scan) : NULL;
+        break;
+    case ALLOCATOR_SEGREGATED_FIT:
+        block = findSegregatedFitBlock(allocator, spaceRequested, alignment, scan);
+        break;
+    default:
+        break;
+    }
+    if (!block)
+        return NULL;
+    placeProcess(allocator, block, handle, spaceRequested, alignment);
+    if (strategy == ALLOCATOR_NEXT_FIT)
+        allocator->nextFitCursor = block->next;
+    return block;
+}
+
+/* ---------------------------------------------------------------------------
+ * Buddy-system engine. The heap is carved into power-of-two blocks aligned to
+ * their size; a block's buddy is found by flipping one bit of its offset, so
+ * splitting and coalescing take O(log n) steps with no list walks.
+ * ------------------------------------------------------------------------- */
+
+/** Returns the offset in bytes of a buddy leaf. */
+static AllocatorSize buddyLeafAddress(int leaf) {
+    return (AllocatorSize)leaf << BUDDY_MIN_ORDER;
+}
+
+/** Pushes a free block onto the free list of its order. */
+static void buddyPushFree(BuddyHeap *buddy, int leaf, int order) {
+    buddy->blockInfo[leaf] = BUDDY_FREE_BIT | order;
+    buddy->prevFree[leaf] = -1;
+    buddy->nextFree[leaf] = buddy->freeHeads[order];
+    if (buddy->nextFree[leaf] >= 0)
+        buddy->prevFree[buddy->nextFree[leaf]] = leaf;
+    buddy->freeHeads[order] = leaf;
+    buddy->freeCounts[order]++;
+    buddy->freeBlockCount++;
+}
+
+/** Unlinks a free block from the free list of its order. */
+static void buddyUnlinkFree(BuddyHeap *buddy, int leaf, int order) {
+    if (buddy->prevFree[leaf] >= 0)
+        buddy->nextFree[buddy->prevFree[leaf]] = buddy->nextFree[leaf];
+    else
+        buddy->freeHeads[order] = buddy->nextFree[leaf];
+    if (buddy->nextFree[leaf] >= 0)
+        buddy->prevFree[buddy->nextFree[leaf]] = buddy->prevFree[leaf];
+    buddy->blockInfo[leaf] = (unsigned char)order;
+    buddy->freeCounts[order]--;
+    buddy->freeBlockCount--;
+}
+
+/** Frees the buddy engine's bookkeeping arrays. */
+static void cleanupBuddyHeap(BuddyHeap *buddy) {
+    free(buddy->blockInfo);
+    free(buddy->nextFree);
+    free(buddy->prevFree);
+    free(buddy->owner);
+    free(buddy->requested);
+    memset(buddy, 0, sizeof(*buddy));
+}
+
+/** Sets up the buddy heap over totalMemory bytes, rounded down to whole leaves.
+ *  Returns 0 if host memory ran out. */
+static int initBuddyHeap(BuddyHeap *buddy, AllocatorSize totalMemory) {
+    buddy->leafCount = (int)(totalMemory >> BUDDY_MIN_ORDER);
+    size_t slots = buddy->leafCount ? (size_t)buddy->leafCount : 1;
+    buddy->blockInfo = (unsigned char *)calloc(slots, sizeof(unsigned char));
+    buddy->nextFree = (int *)malloc(slots * sizeof(int));
+    buddy->prevFree = (int *)malloc(slots * sizeof(int));
+    buddy->owner = (int *)malloc(slots * sizeof(int));
+    buddy->requested = (AllocatorSize *)malloc(slots * sizeof(AllocatorSize));
+    if (!buddy->blockInfo || !buddy->nextFree || !buddy->prevFree || !buddy->owner || !buddy->requested) {
+        cleanupBuddyHeap(buddy);
+        return 0;
+    }
+    for (int order = 0; order < BUDDY_MAX_ORDER; order++)
+        buddy->freeHeads[order] = -1;
+
+    // A non-power-of-two heap becomes one top-level block per set bit, largest first,
+    // so every block stays aligned to its own size.
+    int leaf = 0;
+    for (int order = BUDDY_MAX_ORDER - 1; order >= BUDDY_MIN_ORDER; order--) {
+        int leaves = 1 << (order - BUDDY_MIN_ORDER);
+        if (buddy->leafCount - leaf >= leaves) {
+            buddyPushFree(buddy, leaf, order);
+            leaf += leaves;
+            buddy->blockCount++;
+        }
+    }
+    buddy->peakBlockCount = buddy->blockCount;
+    buddy->freeBytes = buddyLeafAddress(buddy->leafCount);
+    buddy->unusableBytes = totalMemory - buddy->freeBytes;
+    buddy->internalFragmentation = 0;
+    return 1;
+}
+
+/** Returns the smallest order holding spaceRequested bytes at the given alignment,
+ *  or BUDDY_MAX_ORDER if none does. */
+static int buddyOrderFor(AllocatorSize spaceRequested, AllocatorSize alignment) {
+    int order = BUDDY_MIN_ORDER;
+    while (order < BUDDY_MAX_ORDER &&
+           (((AllocatorSize)1 << order) < spaceRequested || ((AllocatorSize)1 << order) < alignment))
+        order++;
+    return order;
+}
+
+/** Allocates a buddy block for handle, rounding the request up to a power of two, and up to
+ *  the alignment, since every block is aligned to its own size. Returns the block's leaf,
+ *  or -1 if no block is large enough. */
+static int buddyAllocate(BuddyHeap *buddy, int handle, AllocatorSize spaceRequested, AllocatorSize alignment) {
+    int needed = buddyOrderFor(spaceRequested, alignment);
+    int order = needed;
+    while (order < BUDDY_MAX_ORDER && buddy->freeHeads[order] < 0)
+        order++;
+    if (order == BUDDY_MAX_ORDER)
+        return -1;
+
+    int leaf = buddy->freeHeads[order];
+    buddyUnlinkFree(buddy, leaf, order);
+    while (order > needed) {
+        order--;
+        buddyPushFree(buddy, leaf + (1 << (order - BUDDY_MIN_ORDER)), order);
+        buddy->blockCount++;
+        buddy->splits++;
+    }
+    if (buddy->blockCount > buddy->peakBlockCount)
+        buddy->peakBlockCount = buddy->blockCount;
+    buddy->blockInfo[leaf] = (unsigned char)order;
+    buddy->owner[leaf] = handle;
+    buddy->requested[leaf] = spaceRequested;
+    buddy->freeBytes -= (AllocatorSize)1 << order;
+    buddy->internalFragmentation += ((AllocatorSize)1 << order) - spaceRequested;
+    return leaf;
+}
+
+/** Releases the buddy block at leaf and coalesces it with its free buddies.
+ *  Returns the leaf of the resulting free block. */
+static int buddyRelease(BuddyHeap *buddy, int leaf) {
+    int order = buddy->blockInfo[leaf];
+    buddy->freeBytes += (AllocatorSize)1 << order;
+    buddy->internalFragmentation -= ((AllocatorSize)1 << order) - buddy->requested[leaf];
+
+    while (order + 1 < BUDDY_MAX_ORDER) {
+        int buddyLeaf = leaf ^ (1 << (order - BUDDY_MIN_ORDER));
+        if (buddyLeaf >= buddy->leafCount || buddy->blockInfo[buddyLeaf] != (BUDDY_FREE_BIT | order))
+            break;
+        buddyUnlinkFree(buddy, buddyLeaf, order);
+        buddy->blockInfo[buddyLeaf > leaf ? buddyLeaf : leaf] = 0;
+        if (buddyLeaf < leaf)
+            leaf = buddyLeaf;
+        order++;
+        buddy->blockCount--;
+        buddy->merges++;
+    }
+    buddyPushFree(buddy, leaf, order);
+    return leaf;
+}
+
+/** Resizes the allocated buddy block at leaf without moving it: shrinking splits off upper
+ *  halves, growing absorbs upper buddies that are free. Returns 0, changing nothing, if a
+ *  buddy needed to grow is not free. */
+static int buddyResizeInPlace(BuddyHeap *buddy, int leaf, AllocatorSize newSize, AllocatorSize alignment) {
+    int order = buddy->blockInfo[leaf];
+    int needed = buddyOrderFor(newSize, alignment);
+    if (needed == BUDDY_MAX_ORDER)
+        return 0;
+    for (int check = order; check < needed; check++) {
+        int buddyLeaf = leaf ^ (1 << (check - BUDDY_MIN_ORDER));
+        if (buddyLeaf < leaf || buddyLeaf >= buddy->leafCount || buddy->blockInfo[buddyLeaf] != (BUDDY_FREE_BIT | check))
+            return 0;
+    }
+
+    AllocatorSize oldSize = (AllocatorSize)1 << order;
+    buddy->internalFragmentation -= oldSize - buddy->requested[leaf];
+    for (; order < needed; order++) {
+        int buddyLeaf = leaf + (1 << (order - BUDDY_MIN_ORDER));
+        buddyUnlinkFree(buddy, buddyLeaf, order);
+        buddy->blockInfo[buddyLeaf] = 0;
+        buddy->blockCount--;
+        buddy->merges++;
+    }
+    while (order > needed) {
+        order--;
+        buddyPushFree(buddy, leaf + (1 << (order - BUDDY_MIN_ORDER)), order);
+        buddy->blockCount++;
+        buddy->splits++;
+    }
+    if (buddy->blockCount > buddy->peakBlockCount)
+        buddy->peakBlockCount = buddy->blockCount;
+    buddy->blockInfo[leaf] = (unsigned char)order;
+    buddy->freeBytes += oldSize - ((AllocatorSize)1 << order);
+    buddy->requested[leaf] = newSize;
+    buddy->internalFragmentation += ((AllocatorSize)1 << order) - newSize;
+    return 1;
+}
+
+/* ---------------------------------------------------------------------------
+ * Array engine. Blocks live in address order in parallel arrays with a gap
+ * buffer: inserts and removals shift only the entries between the previous
+ * edit and this one, and every search is a sequential scan over packed sizes
+ * or a binary search over start addresses, with no pointers to chase. The
+ * First and Best Fit scans compare 4 to 16 sizes per step with AVX2, AVX-512
+ * or NEON when the host has them (build with ALLOCATOR_NO_SIMD to opt out).
+ * ------------------------------------------------------------------------- */
+
+/** Returns the array slot of the block at index, stepping over the gap. */
+static int arraySlot(const BlockArray *array, int index) {
+    return index < array->gapStart ? index : index + array->capacity - array->count;
+}
+
+/** Moves count slots starting at from to to, in every parallel array. */
+static void moveArraySlots(BlockArray *array, int to, int from, int count) {
+    memmove(array->starts + to, array->starts + from, (size_t)count * sizeof(AllocatorSize));
+    memmove(array->sizes + to, array->sizes + from, (size_t)count * sizeof(AllocatorSize));
+    memmove(array->freeSizes + to, array->freeSizes + from, (size_t)count * sizeof(AllocatorSize));
+    memmove(array->owners + to, array->owners + from, (size_t)count * sizeof(int));
+}
+
+/** Moves the gap so it starts right before the block at index. */
+static void moveArrayGap(BlockArray *array, int index) {
+    int gap = array->capacity - array->count;
+    if (index < array->gapStart)
+        moveArraySlots(array, index + gap, index, array->gapStart - index);
+    else if (index > array->gapStart)
+        moveArraySlots(array, array->gapStart, array->gapStart + gap, index - array->gapStart);
+    array->gapStart = index;
+}
+
+/** Makes sure the gap holds at least two slots, enough to split free space off both ends
+ *  of a block. Returns 0 if host memory ran out. */
+static int reserveArraySlots(BlockArray *array) {
+    if (array->capacity - array->count >= 2)
+        return 1;
+    int capacity = array->capacity ? array->capacity * 2 : ARRAY_MIN_CAPACITY;
+    moveArrayGap(array, array->count); // The gap grows at the end
+    AllocatorSize *starts = (AllocatorSize *)realloc(array->starts, (size_t)capacity * sizeof(AllocatorSize));
+    if (starts)
+        array->starts = starts;
+    AllocatorSize *sizes = (AllocatorSize *)realloc(array->sizes, (size_t)capacity * sizeof(AllocatorSize));
+    if (sizes)
+        array->sizes = sizes;
+    AllocatorSize *freeSizes = (AllocatorSize *)realloc(array->freeSizes, (size_t)capacity * sizeof(AllocatorSize));
+    if (freeSizes)
+        array->freeSizes = freeSizes;
+    int *owners = (int *)realloc(array->owners, (size_t)capacity * sizeof(int));
+    if (owners)
+        array->owners = owners;
+    if (!starts || !sizes || !freeSizes || !owners)
+        return 0; // Arrays that did grow are only longer than capacity says
+    array->capacity = capacity;
+    return 1;
+}
+
+/** Frees the array engine's arrays. */
+static void cleanupBlockArray(BlockArray *array) {
+    free(array->starts);
+    free(array->sizes);
+    free(array->freeSizes);
+    free(array->owners);
+    memset(array, 0, sizeof(*array));
+}
+
+/** Keeps the running largest FREE size as a FREE block of size bytes comes (delta 1) or goes
+ *  (delta -1). Only losing the last block of the largest size leaves it to be recomputed. */
+static void trackLargestFree(Allocator *allocator, AllocatorSize size, int delta) {
+    if (delta > 0 && size > allocator->largestFree) {
+        allocator->largestFree = size;
+        allocator->largestFreeCount = 1;
+    } else if (size == allocator->largestFree && (allocator->largestFreeCount += delta) == 0) {
+        allocator->largestFree = 0; // From here on, the largest size added since
+        allocator->largestFreeStale = 1;
+    }
+}
+
+/** Adds (delta 1) or removes (delta -1) a FREE block of size bytes from the free counters. */
+static void countArrayFree(Allocator *allocator, AllocatorSize size, int delta) {
+    trackLargestFree(allocator, size, delta);
+    allocator->sizeClassCounts[sizeClass(size)] += delta;
+    allocator->freeBlockCount += delta;
+    allocator->array.freeBytes += delta * size;
+}
+
+/** Overwrites the block at index; owner -1 makes it FREE. */
+static void writeArrayBlock(Allocator *allocator, int index, AllocatorSize start, AllocatorSize size, int owner) {
+    BlockArray *array = &allocator->array;
+    int slot = arraySlot(array, index);
+    if (array->owners[slot] < 0)
+        countArrayFree(allocator, array->sizes[slot], -1);
+    if (owner < 0)
+        countArrayFree(allocator, size, 1);
+    array->starts[slot] = start;
+    array->sizes[slot] = size;
+    array->freeSizes[slot] = owner < 0 ? size : 0;
+    array->owners[slot] = owner;
+}
+
+/** Inserts a block before the block at index. Callers reserve slots beforehand. */
+static void insertArrayBlock(Allocator *allocator, int index, AllocatorSize start, AllocatorSize size, int owner) {
+    BlockArray *array = &allocator->array;
+    moveArrayGap(array, index);
+    array->owners[index] = 0; // Not FREE, so writeArrayBlock has nothing to uncount
+    array->gapStart++;
+    if (++array->count > array->peakCount)
+        array->peakCount = array->count;
+    writeArrayBlock(allocator, index, start, size, owner);
+}
+
+/** Removes the block at index. */
+static void removeArrayBlock(Allocator *allocator, int index) {
+    BlockArray *array = &allocator->array;
+    int slot = arraySlot(array, index);
+    if (array->owners[slot] < 0)
+        countArrayFree(allocator, array->sizes[slot], -1);
+    moveArrayGap(array, index + 1);
+    array->gapStart--;
+    array->count--;
+}
+
+/** Returns the index of the block holding address, or -1 if address is outside the heap. */
+static int arrayBlockContaining(const BlockArray *array, AllocatorSize address) {
+    if (address < 0 || array->count == 0)
+        return -1;
+    int last = arraySlot(array, array->count - 1);
+    if (address > array->starts[last] + array->sizes[last] - 1)
+        return -1;
+    int low = 0, high = array->count - 1; // Invariant: the answer lies in [low, high]
+    while (low < high) {
+        int middle = low + (high - low + 1) / 2;
+        if (array->starts[arraySlot(array, middle)] <= address)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return low;
+}
+
+/** Returns the first slot in [begin, end) whose FREE size is at least size, or end. */
+static int scanFreeSizes(const AllocatorSize *freeSizes, int begin, int end, AllocatorSize size) {
+    while (begin < end && freeSizes[begin] < size)
+        begin++;
+    return begin;
+}
+
+/** Returns the first slot in [begin, end) holding the smallest FREE size that is at least
+ *  size, or end if none is. */
+static int scanSmallestFreeSize(const AllocatorSize *freeSizes, int begin, int end, AllocatorSize size) {
+    int best = end;
+    for (int slot = begin; slot < end; slot++) {
+        if (freeSizes[slot] >= size && (best == end || freeSizes[slot] < freeSizes[best]))
+            best = slot;
+    }
+    return best;
+}
+
+#if defined(SIMD_X86)
+/* AVX2 has only a signed greater-than for 64-bit lanes, so "at least size" is tested as
+ * "not below size": a lane whose compare mask stays clear is a hit. */
+
+__attribute__((target("avx2"))) static int scanFreeSizesAvx2(const AllocatorSize *freeSizes, int begin, int end,
+                                                             AllocatorSize size) {
+    const __m256i wanted = _mm256_set1_epi64x(size);
+    for (; begin + 16 <= end; begin += 16) {
+        const __m256i *lanes = (const __m256i *)(freeSizes + begin);
+        __m256i below0 = _mm256_cmpgt_epi64(wanted, _mm256_loadu_si256(lanes));
+        __m256i below1 = _mm256_cmpgt_epi64(wanted, _mm256_loadu_si256(lanes + 1));
+        __m256i below2 = _mm256_cmpgt_epi64(wanted, _mm256_loadu_si256(lanes + 2));
+        __m256i below3 = _mm256_cmpgt_epi64(wanted, _mm256_loadu_si256(lanes + 3));
+        __m256i allBelow = _mm256_and_si256(_mm256_and_si256(below0, below1), _mm256_and_si256(below2, below3));
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(allBelow)) == 0xF)
+            continue;
+        unsigned hits = ~((unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(below0)) |
+                          (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(below1)) << 4 |
+                          (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(below2)) << 8 |
+                          (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(below3)) << 12);
+        return begin + __builtin_ctz(hits);
+    }
+    for (; begin + 4 <= end; begin += 4) {
+        __m256i below = _mm256_cmpgt_epi64(wanted, _mm256_loadu_si256((const __m256i *)(freeSizes + begin)));
+        unsigned hits = ~(unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(below)) & 0xFu;
+        if (hits)
+            return begin + __builtin_ctz(hits);
+    }
+    return scanFreeSizes(freeSizes, begin, end, size);
+}
+
+/** Returns the first slot in [begin, end) whose FREE size equals size, or end. */
+__attribute__((target("avx2"))) static int scanEqualFreeSizeAvx2(const AllocatorSize *freeSizes, int begin, int end,
+                                                                 AllocatorSize size) {
+    const __m256i wanted = _mm256_set1_epi64x(size);
+    for (; begin + 8 <= end; begin += 8) {
+        const __m256i *lanes = (const __m256i *)(freeSizes + begin);
+        unsigned hits = (unsigned)_mm256_movemask_pd(
+                            _mm256_castsi256_pd(_mm256_cmpeq_epi64(wanted, _mm256_loadu_si256(lanes)))) |
+                        (unsigned)_mm256_movemask_pd(
+                            _mm256_castsi256_pd(_mm256_cmpeq_epi64(wanted, _mm256_loadu_si256(lanes + 1))))
+                            << 4;
+        if (hits)
+            return begin + __builtin_ctz(hits);
+    }
+    while (begin < end && freeSizes[begin] != size)
+        begin++;
+    return begin;
+}
+
+/** Two passes: the lane-wise minimum over sizes of at least size, then its first slot. */
+__attribute__((target("avx2"))) static int scanSmallestFreeSizeAvx2(const AllocatorSize *freeSizes, int begin,
+                                                                    int end, AllocatorSize size) {
+    const __m256i wanted = _mm256_set1_epi64x(size);
+    const __m256i none = _mm256_set1_epi64x(INT64_MAX);
+    __m256i smallest0 = none, smallest1 = none;
+    int slot = begin;
+    for (; slot + 8 <= end; slot += 8) {
+        const __m256i *lanes = (const __m256i *)(freeSizes + slot);
+        __m256i sizes0 = _mm256_loadu_si256(lanes), sizes1 = _mm256_loadu_si256(lanes + 1);
+        sizes0 = _mm256_blendv_epi8(sizes0, none, _mm256_cmpgt_epi64(wanted, sizes0));
+        sizes1 = _mm256_blendv_epi8(sizes1, none, _mm256_cmpgt_epi64(wanted, sizes1));
+        smallest0 = _mm256_blendv_epi8(smallest0, sizes0, _mm256_cmpgt_epi64(smallest0, sizes0));
+        smallest1 = _mm256_blendv_epi8(smallest1, sizes1, _mm256_cmpgt_epi64(smallest1, sizes1));
+    }
+    smallest0 = _mm256_blendv_epi8(smallest0, smallest1, _mm256_cmpgt_epi64(smallest0, smallest1));
+    AllocatorSize lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, smallest0);
+    AllocatorSize smallest = INT64_MAX;
+    for (int lane = 0; lane < 4; lane++)
+        smallest = lanes[lane] < smallest ? lanes[lane] : smallest;
+    for (; slot < end; slot++)
+        if (freeSizes[slot] >= size && freeSizes[slot] < smallest)
+            smallest = freeSizes[slot];
+    return smallest >= size ? scanEqualFreeSizeAvx2(freeSizes, begin, end, smallest) : end;
+}
+
+__attribute__((target("avx512f"))) static int scanFreeSizesAvx512(const AllocatorSize *freeSizes, int begin, int end,
+                                                                 AllocatorSize size) {
+    const __m512i wanted = _mm512_set1_epi64(size);
+    for (; begin + 16 <= end; begin += 16) {
+        unsigned hits = (unsigned)_mm512_cmpge_epi64_mask(_mm512_loadu_si512(freeSizes + begin), wanted) |
+                        (unsigned)_mm512_cmpge_epi64_mask(_mm512_loadu_si512(freeSizes + begin + 8), wanted) << 8;
+        if (hits)
+            return begin + __builtin_ctz(hits);
+    }
+    for (; begin < end; begin += 8) {
+        __mmask8 live = (__mmask8)(end - begin >= 8 ? 0xFFu : (1u << (end - begin)) - 1);
+        unsigned hits = _mm512_mask_cmpge_epi64_mask(live, _mm512_maskz_loadu_epi64(live, freeSizes + begin), wanted);
+        if (hits)
+            return begin + __builtin_ctz(hits);
+    }
+    return end;
+}
+
+__attribute__((target("avx512f"))) static int scanSmallestFreeSizeAvx512(const AllocatorSize *freeSizes, int begin,
+                                                                        int end, AllocatorSize size) {
+    const __m512i wanted = _mm512_set1_epi64(size);
+    __m512i smallest0 = _mm512_set1_epi64(INT64_MAX), smallest1 = smallest0;
+    int slot = begin;
+    for (; slot + 16 <= end; slot += 16) {
+        __m512i sizes0 = _mm512_loadu_si512(freeSizes + slot), sizes1 = _mm512_loadu_si512(freeSizes + slot + 8);
+        smallest0 = _mm512_mask_min_epi64(smallest0, _mm512_cmpge_epi64_mask(sizes0, wanted), smallest0, sizes0);
+        smallest1 = _mm512_mask_min_epi64(smallest1, _mm512_cmpge_epi64_mask(sizes1, wanted), smallest1, sizes1);
+    }
+    for (; slot < end; slot += 8) {
+        __mmask8 live = (__mmask8)(end - slot >= 8 ? 0xFFu : (1u << (end - slot)) - 1);
+        __m512i sizes = _mm512_maskz_loadu_epi64(live, freeSizes + slot);
+        smallest0 = _mm512_mask_min_epi64(smallest0, _mm512_mask_cmpge_epi64_mask(live, sizes, wanted), smallest0,
+                                          sizes);
+    }
+    AllocatorSize smallest = _mm512_reduce_min_epi64(_mm512_min_epi64(smallest0, smallest1));
+    if (smallest < size)
+        return end;
+    const __m512i found = _mm512_set1_epi64(smallest);
+    for (slot = begin; slot < end; slot += 8) {
+        __mmask8 live = (__mmask8)(end - slot >= 8 ? 0xFFu : (1u << (end - slot)) - 1);
+        unsigned hits = _mm512_mask_cmpeq_epi64_mask(live, _mm512_maskz_loadu_epi64(live, freeSizes + slot), found);
+        if (hits)
+            return slot + __builtin_ctz(hits);
+    }
+    return end;
+}
+#endif
+
+#if defined(SIMD_NEON)
+static int scanFreeSizesNeon(const AllocatorSize *freeSizes, int begin, int end, AllocatorSize size) {
+    const int64x2_t wanted = vdupq_n_s64(size);
+    for (; begin + 8 <= end; begin += 8) {
+        const int64_t *lanes = freeSizes + begin;
+        uint64x2_t hits = vorrq_u64(vorrq_u64(vcgeq_s64(vld1q_s64(lanes), wanted), vcgeq_s64(vld1q_s64(lanes + 2), wanted)),
+                                    vorrq_u64(vcgeq_s64(vld1q_s64(lanes + 4), wanted), vcgeq_s64(vld1q_s64(lanes + 6), wanted)));
+        if (vmaxvq_u32(vreinterpretq_u32_u64(hits)))
+            return scanFreeSizes(freeSizes, begin, begin + 8, size);
+    }
+    return scanFreeSizes(freeSizes, begin, end, size);
+}
+
+static int scanSmallestFreeSizeNeon(const AllocatorSize *freeSizes, int begin, int end, AllocatorSize size) {
+    const int64x2_t wanted = vdupq_n_s64(size);
+    const int64x2_t none = vdupq_n_s64(INT64_MAX);
+    int64x2_t smallest0 = none, smallest1 = none;
+    int slot = begin;
+    for (; slot + 4 <= end; slot += 4) {
+        int64x2_t sizes0 = vld1q_s64(freeSizes + slot), sizes1 = vld1q_s64(freeSizes + slot + 2);
+        sizes0 = vbslq_s64(vcgeq_s64(sizes0, wanted), sizes0, none);
+        sizes1 = vbslq_s64(vcgeq_s64(sizes1, wanted), sizes1, none);
+        smallest0 = vbslq_s64(vcltq_s64(sizes0, smallest0), sizes0, smallest0);
+        smallest1 = vbslq_s64(vcltq_s64(sizes1, smallest1), sizes1, smallest1);
+    }
+    smallest0 = vbslq_s64(vcltq_s64(smallest1, smallest0), smallest1, smallest0);
+    AllocatorSize smallest = vgetq_lane_s64(smallest0, 0) < vgetq_lane_s64(smallest0, 1) ? vgetq_lane_s64(smallest0, 0)
+                                                                                        : vgetq_lane_s64(smallest0, 1);
+    for (; slot < end; slot++)
+        if (freeSizes[slot] >= size && freeSizes[slot] < smallest)
+            smallest = freeSizes[slot];
+    if (smallest < size)
+        return end;
+    const int64x2_t found = vdupq_n_s64(smallest);
+    for (slot = begin; slot + 8 <= end; slot += 8) {
+        const int64_t *lanes = freeSizes + slot;
+        uint64x2_t hits = vorrq_u64(vorrq_u64(vceqq_s64(vld1q_s64(lanes), found), vceqq_s64(vld1q_s64(lanes + 2), found)),
+                                    vorrq_u64(vceqq_s64(vld1q_s64(lanes + 4), found), vceqq_s64(vld1q_s64(lanes + 6), found)));
+        if (vmaxvq_u32(vreinterpretq_u32_u64(hits)))
+            break;
+    }
+    while (freeSizes[slot] != smallest)
+        slot++;
+    return slot;
+}
+#endif
+
+static const FreeSizeKernels scalarKernels = {"scalar", scanFreeSizes, scanSmallestFreeSize};
+#if defined(SIMD_X86)
+static const FreeSizeKernels avx2Kernels = {"avx2", scanFreeSizesAvx2, scanSmallestFreeSizeAvx2};
+static const FreeSizeKernels avx512Kernels = {"avx512", scanFreeSizesAvx512, scanSmallestFreeSizeAvx512};
+#endif
+#if defined(SIMD_NEON)
+static const FreeSizeKernels neonKernels = {"neon", scanFreeSizesNeon, scanSmallestFreeSizeNeon};
+#endif
+
+/** Picks the widest scan kernels this CPU runs. Every set returns the slot the scalar loops
+ *  would, so placement does not depend on the host. */
+static const FreeSizeKernels *selectFreeSizeKernels(void) {
+#if defined(SIMD_X86)
+    if (__builtin_cpu_supports("avx512f"))
+        return &avx512Kernels;
+    if (__builtin_cpu_supports("avx2"))
+        return &avx2Kernels;
+#elif defined(SIMD_NEON)
+    return &neonKernels; // Part of every AArch64 CPU
+#endif
+    return &scalarKernels;
+}
+
+/** Returns 1 if the FREE block in slot can hold size bytes starting at an aligned address. */
+static int arraySlotFits(const BlockArray *array, int slot, AllocatorSize size, AllocatorSize alignment) {
+    AllocatorSize padding = alignmentPadding(array->starts[slot], alignment);
+    return array->freeSizes[slot] >= size && array->freeSizes[slot] - size >= padding;
+}
+
+/** Returns the first block in [from, to) that can hold size aligned bytes, or -1. */
+static int findArrayFirstFit(const BlockArray *array, int from, int to, AllocatorSize size, AllocatorSize alignment,
+                             AllocatorScanStats *scan) {
+    int gap = array->capacity - array->count;
+    for (int pass = 0; pass < 2; pass++) { // The blocks before the gap, then those after it
+        int begin = pass == 0 ? from : (from > array->gapStart ? from : array->gapStart);
+        int end = pass == 0 ? (to < array->gapStart ? to : array->gapStart) : to;
+        int offset = pass == 0 ? 0 : gap;
+        for (int slot = begin + offset; slot < end + offset; slot++) {
+            int hit = array->kernels->firstAtLeast(array->freeSizes, slot, end + offset, size);
+            COUNT_VISITS(scan, hit - slot + (hit < end + offset));
+            if (hit == end + offset)
+                break;
+            if (alignment == 1 || arraySlotFits(array, hit, size, alignment))
+                return hit - offset;
+            slot = hit;
+        }
+    }
+    return -1;
+}
+
+/** Returns the smallest block that can hold size aligned bytes (lowest address among equals), or -1. */
+static int findArrayBestFit(const BlockArray *array, AllocatorSize size, AllocatorSize alignment, AllocatorScanStats *scan) {
+    COUNT_VISITS(scan, array->count);
+    if (alignment == 1) { // Every block of at least size fits, so this is a plain minimum over freeSizes
+        int gap = array->capacity - array->count;
+        int before = array->kernels->smallestAtLeast(array->freeSizes, 0, array->gapStart, size);
+        int after = array->kernels->smallestAtLeast(array->freeSizes, array->gapStart + gap, array->capacity, size);
+        if (after < array->capacity &&
+            (before == array->gapStart || array->freeSizes[after] < array->freeSizes[before]))
+            return after - gap;
+        return before < array->gapStart ? before : -1;
+    }
+    int best = -1;
+    AllocatorSize bestSize = 0;
+    for (int index = 0; index < array->count; index++) {
+        int slot = arraySlot(array, index);
+        AllocatorSize freeSize = array->freeSizes[slot];
+        if (freeSize >= size && (best < 0 || freeSize < bestSize) && arraySlotFits(array, slot, size, alignment)) {
+            best = index;
+            bestSize = freeSize;
+        }
+    }
+    return best;
+}
+
+/** Template of findArrayWorstFit. */
+SCAN_TEMPLATE int scanArrayWorstFit(const BlockArray *array, AllocatorSize size, AllocatorSize alignment,
+                                    AllocatorScanStats *scan) {
+    int largest = -1, largestFitting = -1;
+    AllocatorSize largestSize = 0, fittingSize = 0;
+    for (int index = 0; index < array->count; index++) {
+        int slot = arraySlot(array, index);
+        AllocatorSize freeSize = array->freeSizes[slot];
+        if (freeSize > largestSize) {
+            largest = index;
+            largestSize = freeSize;
+        }
+        if (alignment > 1 && freeSize >= fittingSize && freeSize > 0 && arraySlotFits(array, slot, size, alignment)) {
+            largestFitting = index;
+            fittingSize = freeSize;
+        }
+    }
+    COUNT_VISITS(scan, array->count);
+    if (largest >= 0 && arraySlotFits(array, arraySlot(array, largest), size, alignment))
+        return largest;
+    return largestFitting;
+}
+
+/** Returns the largest block (lowest address among equals) if it can hold size aligned bytes.
+ *  Otherwise, for an aligned request, the largest block that can (highest address among
+ *  equals, as the list engine's size index picks it); else -1. */
+static int findArrayWorstFit(const BlockArray *array, AllocatorSize size, AllocatorSize alignment,
+                             AllocatorScanStats *scan) {
+    return alignment == 1 ? scanArrayWorstFit(array, size, 1, scan)
+                          : scanArrayWorstFit(array, size, alignment, scan);
+}
+
+/** Template of findArraySegregatedFit. */
+SCAN_TEMPLATE int scanArraySegregatedFit(const BlockArray *array, AllocatorSize size, AllocatorSize alignment,
+                                         AllocatorScanStats *scan) {
+    int requestClass = sizeClass(size), best = -1, bestClass = SIZE_CLASS_COUNT;
+    for (int index = 0; index < array->count; index++) {
+        int slot = arraySlot(array, index);
+        COUNT_VISITS(scan, 1);
+        if (array->freeSizes[slot] < size || sizeClass(array->freeSizes[slot]) >= bestClass ||
+            !arraySlotFits(array, slot, size, alignment))
+            continue;
+        best = index;
+        bestClass = sizeClass(array->freeSizes[slot]);
+        if (bestClass == requestClass)
+            break;
+    }
+    return best;
+}
+
+/** Segregated Fit without per-class lists: the lowest-address block of the smallest size class
+ *  that can hold size aligned bytes. Stops at the first fit in the request's own class. */
+static int findArraySegregatedFit(const BlockArray *array, AllocatorSize size, AllocatorSize alignment,
+                                  AllocatorScanStats *scan) {
+    return alignment == 1 ? scanArraySegregatedFit(array, size, 1, scan)
+                          : scanArraySegregatedFit(array, size, alignment, scan);
+}
+
+/** Marks the FREE block at index as owned by handle, splitting the alignment padding off its
+ *  head and any leftover space off its tail as FREE blocks. Returns the owned block's index. */
+static int placeArrayProcess(Allocator *allocator, int index, int handle, AllocatorSize size, AllocatorSize alignment) {
+    BlockArray *array = &allocator->array;
+    int slot = arraySlot(array, index);
+    AllocatorSize start = array->starts[slot], available = array->sizes[slot];
+    AllocatorSize padding = alignmentPadding(start, alignment);
+    if (padding > 0) {
+        writeArrayBlock(allocator, index, start, padding, -1);
+        allocator->splits++;
+        start += padding;
+        available -= padding;
+        insertArrayBlock(allocator, ++index, start, size, handle);
+    } else {
+        writeArrayBlock(allocator, index, start, size, handle);
+    }
+    if (available > size) {
+        insertArrayBlock(allocator, index + 1, start + size, available - size, -1);
+        allocator->splits++;
+    }
+    allocator->processes[handle].arrayStart = start;
+    return index;
+}
+
+/** Places a request with the array engine's chosen strategy. Returns the block's index or -1. */
+static int arrayAllocate(Allocator *allocator, int handle, AllocatorSize size, AllocatorSize alignment,
+                         AllocatorStrategy strategy) {
+    BlockArray *array = &allocator->array;
+    AllocatorScanStats *scan = &allocator->scans[strategy];
+    int index = -1;
+    scan->requests++;
+    switch (strategy) {
+    case ALLOCATOR_FIRST_FIT:
+        index = findArrayFirstFit(array, 0, array->count, size, alignment, scan);
+        break;
+    case ALLOCATOR_NEXT_FIT: {
+        int start = array->nextFitAddress >= 0 ? arrayBlockContaining(array, array->nextFitAddress) : 0;
+        index = findArrayFirstFit(array, start, array->count, size, alignment, scan);
+        if (index < 0)
+            index = findArrayFirstFit(array, 0, start, size, alignment, scan);
+        break;
+    }
+    case ALLOCATOR_BEST_FIT:
+        index = findArrayBestFit(array, size, alignment, scan);
+        break;
+    case ALLOCATOR_WORST_FIT:
+        index = findArrayWorstFit(array, size, alignment, scan);
+        break;
+    case ALLOCATOR_SEGREGATED_FIT:
+        index = findArraySegregatedFit(array, size, alignment, scan);
+        break;
+    default:
+        break;
+    }
+    if (index < 0)
+        return -1;
+    index = placeArrayProcess(allocator, index, handle, size, alignment);
+    if (strategy == ALLOCATOR_NEXT_FIT) {
+        AllocatorSize next = allocator->processes[handle].arrayStart + size;
+        array->nextFitAddress = next <= allocator->lastAddressSpace ? next : -1;
+    }
+    return index;
+}
+
+/** Turns the allocated block at index FREE and merges it with FREE neighbours. Returns the
+ *  index of the surviving FREE block. The bytes are left in place. */
+static int freeArrayBlock(Allocator *allocator, int index) {
+    BlockArray *array = &allocator->array;
+    int slot = arraySlot(array, index);
+    AllocatorSize start = array->starts[slot], size = array->sizes[slot];
+    if (index + 1 < array->count && array->owners[arraySlot(array, index + 1)] < 0) {
+        size += array->sizes[arraySlot(array, index + 1)];
+        removeArrayBlock(allocator, index + 1);
+        allocator->merges++;
+    }
+    if (index > 0 && array->owners[arraySlot(array, index - 1)] < 0) {
+        removeArrayBlock(allocator, index);
+        index--;
+        slot = arraySlot(array, index);
+        start = array->starts[slot];
+        size += array->sizes[slot];
+        allocator->merges++;
+    }
+    writeArrayBlock(allocator, index, start, size, -1);
+    if (start < array->compactedBelow)
+        array->compactedBelow = start;
+    return index;
+}
+
+/** Releases the array block at index and discards its whole free pages. */
+static void releaseArrayBlock(Allocator *allocator, int index) {
+    BlockArray *array = &allocator->array;
+    int slot = arraySlot(array, index);
+    AllocatorSize releasedStart = array->starts[slot], releasedEnd = releasedStart + array->sizes[slot] - 1;
+    slot = arraySlot(array, freeArrayBlock(allocator, index));
+    discardFreePages(allocator, array->starts[slot], array->starts[slot] + array->sizes[slot] - 1, releasedStart,
+                     releasedEnd);
+}
+
+/** Merges every run of FREE blocks and blocks marked ARRAY_RELEASED in one pass that closes
+ *  the gap, so a bulk release shifts each surviving block at most once. */
+static void coalesceArrayReleases(Allocator *allocator) {
+    BlockArray *array = &allocator->array;
+    moveArrayGap(array, array->count);
+    int kept = 0;
+    for (int index = 0; index < array->count;) {
+        if (array->owners[index] >= 0) {
+            if (kept != index)
+                moveArraySlots(array, kept, index, 1);
+            kept++;
+            index++;
+            continue;
+        }
+        AllocatorSize start = array->starts[index], size = 0;
+        AllocatorSize releasedStart = -1, releasedEnd = -1;
+        for (int first = index; index < array->count && array->owners[index] < 0; index++) {
+            if (array->owners[index] == -1)
+                countArrayFree(allocator, array->sizes[index], -1);
+            else if (releasedStart < 0)
+                releasedStart = array->starts[index];
+            if (array->owners[index] == ARRAY_RELEASED)
+                releasedEnd = array->starts[index] + array->sizes[index] - 1;
+            if (index > first)
+                allocator->merges++;
+            size += array->sizes[index];
+        }
+        array->starts[kept] = start;
+        array->sizes[kept] = array->freeSizes[kept] = size;
+        array->owners[kept] = -1;
+        countArrayFree(allocator, size, 1);
+        kept++;
+        if (releasedStart >= 0) {
+            if (start < array->compactedBelow)
+                array->compactedBelow = start;
+            discardFreePages(allocator, start, start + size - 1, releasedStart, releasedEnd);
+        }
+    }
+    array->count = array->gapStart = kept;
+}
+
+/** Slides allocated blocks down over FREE gaps as slideAllocatedBlocks does for the list
+ *  engine, swapping neighbouring array entries in place, with the same budget and alignment
+ *  rules. The scan resumes at compactedBelow, below which every block is already packed. */
+static int slideArrayBlocks(Allocator *allocator, int maxBlocks, AllocatorSize maxBytes) {
+    BlockArray *array = &allocator->array;
+    int index = array->compactedBelow > 0 ? arrayBlockContaining(array, array->compactedBelow) : 0;
+    int movedBlocks = 0;
+    AllocatorSize movedBytes = 0;
+    if (index < 0)
+        index = array->count;
+    for (;;) {
+        while (index < array->count && array->owners[arraySlot(array, index)] >= 0)
+            index++;
+        if (index + 1 >= array->count)
+            break; // No free space, or it is all in the final block
+        int gapSlot = arraySlot(array, index), blockSlot = arraySlot(array, index + 1);
+        AllocatorSize gapStart = array->starts[gapSlot], gapSize = array->sizes[gapSlot];
+        int owner = array->owners[blockSlot];
+        if (owner < 0) {
+            writeArrayBlock(allocator, index, gapStart, gapSize + array->sizes[blockSlot], -1);
+            removeArrayBlock(allocator, index + 1);
+            allocator->merges++;
+            continue;
+        }
+        AllocatorSize blockStart = array->starts[blockSlot], blockSize = array->sizes[blockSlot];
+        AllocatorSize padding = alignmentPadding(gapStart, processAlignment(allocator, owner));
+        if (padding >= gapSize || (padding > 0 && !reserveArraySlots(array))) {
+            index += 2; // Its alignment pins the block in place; the gap stays behind as padding
+            continue;
+        }
+        if (movedBlocks > 0 && ((maxBlocks > 0 && movedBlocks >= maxBlocks) ||
+                                (maxBytes > 0 && movedBytes + blockSize > maxBytes))) {
+            array->compactedBelow = gapStart;
+            flushRelocationRun(allocator);
+            return 0;
+        }
+
+        if (padding > 0) { // The aligned slot starts inside the gap: its head stays FREE
+            writeArrayBlock(allocator, index, gapStart, padding, -1);
+            insertArrayBlock(allocator, ++index, gapStart + padding, blockSize, owner);
+            allocator->splits++;
+        } else {
+            writeArrayBlock(allocator, index, gapStart, blockSize, owner);
+        }
+        AllocatorSize newStart = gapStart + padding;
+        writeArrayBlock(allocator, index + 1, newStart + blockSize, gapSize - padding, -1);
+        noteRelocation(allocator, blockStart, newStart, blockSize);
+        allocator->processes[owner].arrayStart = newStart;
+        if (index + 2 < array->count && array->owners[arraySlot(array, index + 2)] < 0) {
+            writeArrayBlock(allocator, index + 1, newStart + blockSize,
+                            gapSize - padding + array->sizes[arraySlot(array, index + 2)], -1);
+            removeArrayBlock(allocator, index + 2);
+            allocator->merges++;
+        }
+
+        allocator->blocksMoved++;
+        allocator->bytesMoved += blockSize;
+        movedBlocks++;
+        movedBytes += blockSize;
+        index++;
+    }
+    array->compactedBelow = index < array->count ? array->starts[arraySlot(array, index)] : allocator->lastAddressSpace + 1;
+    flushRelocationRun(allocator);
+    if (index + 1 == array->count && movedBlocks > 0) {
+        int top = arraySlot(array, index);
+        discardFreePages(allocator, array->starts[top], allocator->lastAddressSpace, array->starts[top],
+                         allocator->lastAddressSpace);
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------------------
+ * Bitmap engine. The heap is an array of fixed-size granules with one bit
+ * each, so a block costs two bits per granule plus one owner table slot
+ * instead of a Node. Searches walk 64 granules per word with ctz/clz and
+ * skip whole regions through the summary words; releasing a block clears
+ * its bits, and its FREE neighbours merge simply by being clear too.
+ * ------------------------------------------------------------------------- */
+
+/** Returns the index of the highest set bit of a non-zero word. */
+static int highestBit(unsigned long long word) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(word);
+#else
+    int bit = 0;
+    while (word >>= 1)
+        bit++;
+    return bit;
+#endif
+}
+
+/** Sets (value 1) or clears (value 0) bit index of words. */
+static void writeBit(unsigned long long *words, AllocatorSize index, int value) {
+    unsigned long long bit = 1ULL << (index & 63);
+    if (value)
+        words[index >> 6] |= bit;
+    else
+        words[index >> 6] &= ~bit;
+}
+
+/** Returns 1 if granule is allocated. */
+static int granuleUsed(const GranuleBitmap *bitmap, AllocatorSize granule) {
+    return (int)(bitmap->used[granule >> 6] >> (granule & 63)) & 1;
+}
+
+/** Returns word of used with the wanted bits (allocated for used 1, FREE for used 0) set. */
+static unsigned long long granuleBits(const GranuleBitmap *bitmap, AllocatorSize word, int used) {
+    return used ? bitmap->used[word] : ~bitmap->used[word];
+}
+
+/** Returns the address of a granule. */
+static AllocatorSize granuleAddress(const GranuleBitmap *bitmap, AllocatorSize granule) {
+    return granule << bitmap->granuleShift;
+}
+
+/** Returns the granules a block of bytes takes, rounded up. */
+static AllocatorSize granulesFor(const GranuleBitmap *bitmap, AllocatorSize bytes) {
+    return (bytes >> bitmap->granuleShift) + ((bytes & (((AllocatorSize)1 << bitmap->granuleShift) - 1)) != 0);
+}
+
+/** Returns an alignment in granules. Every granule is aligned to the granule size. */
+static AllocatorSize granuleAlignment(const GranuleBitmap *bitmap, AllocatorSize alignment) {
+    AllocatorSize granules = alignment >> bitmap->granuleShift;
+    return granules > 1 ? granules : 1;
+}
+
+/** Re-derives both summary levels for word of used. */
+static void refreshSummaries(GranuleBitmap *bitmap, AllocatorSize word) {
+    AllocatorSize summary = word >> 6;
+    writeBit(bitmap->usedSummary[0], word, bitmap->used[word] != 0);
+    writeBit(bitmap->freeSummary[0], word, ~bitmap->used[word] != 0);
+    writeBit(bitmap->usedSummary[1], summary, bitmap->usedSummary[0][summary] != 0);
+    writeBit(bitmap->freeSummary[1], summary, bitmap->freeSummary[0][summary] != 0);
+}
+
+/** Marks granules [first, first + count) allocated (used 1) or FREE (used 0), a word at a time. */
+static void markGranules(GranuleBitmap *bitmap, AllocatorSize first, AllocatorSize count, int used) {
+    AllocatorSize end = first + count;
+    while (first < end) {
+        AllocatorSize word = first >> 6;
+        AllocatorSize wordEnd = end - (word << 6) < 64 ? end : (word + 1) << 6;
+        unsigned long long mask = ~0ULL << (first & 63);
+        if (wordEnd & 63)
+            mask &= ~(~0ULL << (wordEnd & 63));
+        if (used)
+            bitmap->used[word] |= mask;
+        else
+            bitmap->used[word] &= ~mask;
+        refreshSummaries(bitmap, word);
+        first = wordEnd;
+    }
+}
+
+/** Returns the first word at or after word holding a wanted bit, or -1, letting the summary
+ *  levels skip every word without one. */
+static AllocatorSize nextMarkedWord(const GranuleBitmap *bitmap, AllocatorSize word, int used) {
+    const unsigned long long *level0 = used ? bitmap->usedSummary[0] : bitmap->freeSummary[0];
+    const unsigned long long *level1 = used ? bitmap->usedSummary[1] : bitmap->freeSummary[1];
+    if (word >= bitmap->wordCount)
+        return -1;
+    AllocatorSize summary = word >> 6;
+    unsigned long long bits = level0[summary] & (~0ULL << (word & 63));
+    if (!bits) {
+        AllocatorSize next = summary + 1; // First level-0 word still to search
+        if (next >= bitmap->summaryWords[0])
+            return -1;
+        AllocatorSize top = next >> 6;
+        unsigned long long topBits = level1[top] & (~0ULL << (next & 63));
+        while (!topBits) {
+            if (++top >= bitmap->summaryWords[1])
+                return -1;
+            topBits = level1[top];
+        }
+        summary = (top << 6) + lowestSizeClass(topBits);
+        bits = level0[summary];
+    }
+    return (summary << 6) + lowestSizeClass(bits);
+}
+
+/** Returns the last word at or before word holding a wanted bit, or -1. */
+static AllocatorSize previousMarkedWord(const GranuleBitmap *bitmap, AllocatorSize word, int used) {
+    const unsigned long long *level0 = used ? bitmap->usedSummary[0] : bitmap->freeSummary[0];
+    const unsigned long long *level1 = used ? bitmap->usedSummary[1] : bitmap->freeSummary[1];
+    if (word < 0)
+        return -1;
+    AllocatorSize summary = word >> 6;
+    unsigned long long bits = level0[summary] & (~0ULL >> (63 - (word & 63)));
+    if (!bits) {
+        AllocatorSize previous = summary - 1; // Last level-0 word still to search
+        if (previous < 0)
+            return -1;
+        AllocatorSize top = previous >> 6;
+        unsigned long long topBits = level1[top] & (~0ULL >> (63 - (previous & 63)));
+        while (!topBits) {
+            if (--top < 0)
+                return -1;
+            topBits = level1[top];
+        }
+        summary = (top << 6) + highestBit(topBits);
+        bits = level0[summary];
+    }
+    return (summary << 6) + highestBit(bits);
+}
+
+/** Returns the first granule at or after from that is allocated (used 1) or FREE (used 0),
+ *  or granuleCount if there is none. */
+static AllocatorSize nextGranule(const GranuleBitmap *bitmap, AllocatorSize from, int used) {
+    if (from >= bitmap->granuleCount)
+        return bitmap->granuleCount;
+    AllocatorSize word = from >> 6;
+    unsigned long long bits = granuleBits(bitmap, word, used) & (~0ULL << (from & 63));
+    if (!bits && ++word < bitmap->wordCount) // Runs often end in the next word: try it before the summaries
+        bits = granuleBits(bitmap, word, used);
+    if (!bits) {
+        word = nextMarkedWord(bitmap, word + 1, used);
+        if (word < 0)
+            return bitmap->granuleCount;
+        bits = granuleBits(bitmap, word, used);
+    }
+    AllocatorSize granule = (word << 6) + lowestSizeClass(bits);
+    return granule < bitmap->granuleCount ? granule : bitmap->granuleCount;
+}
+
+/** Returns the last granule before before that is allocated (used 1) or FREE (used 0), or -1. */
+static AllocatorSize previousGranule(const GranuleBitmap *bitmap, AllocatorSize before, int used) {
+    if (before <= 0)
+        return -1;
+    AllocatorSize word = (before - 1) >> 6;
+    unsigned long long bits = granuleBits(bitmap, word, used) & (~0ULL >> (63 - ((before - 1) & 63)));
+    if (!bits && --word >= 0)
+        bits = granuleBits(bitmap, word, used);
+    if (!bits) {
+        word = previousMarkedWord(bitmap, word - 1, used);
+        if (word < 0)
+            return -1;
+        bits = granuleBits(bitmap, word, used);
+    }
+    return (word << 6) + highestBit(bits);
+}
+
+/** Returns the first granule of the allocated block holding granule. */
+static AllocatorSize blockStartGranule(const GranuleBitmap *bitmap, AllocatorSize granule) {
+    AllocatorSize word = granule >> 6;
+    unsigned long long bits = bitmap->starts[word] & (~0ULL >> (63 - (granule & 63)));
+    while (!bits)
+        bits = bitmap->starts[--word];
+    return (word << 6) + highestBit(bits);
+}
+
+/** Frees the bitmap engine's bit arrays and owner table. */
+static void cleanupGranuleBitmap(GranuleBitmap *bitmap) {
+    free(bitmap->used);
+    free(bitmap->starts);
+    for (int level = 0; level < 2; level++) {
+        free(bitmap->usedSummary[level]);
+        free(bitmap->freeSummary[level]);
+    }
+    free(bitmap->owners);
+    memset(bitmap, 0, sizeof(*bitmap));
+}
+
+/** Sets up an all-FREE bitmap over the whole granules of totalMemory bytes. Returns 0 if the
+ *  heap holds no granule or host memory ran out (the caller cleans up). */
+static int initGranuleBitmap(GranuleBitmap *bitmap, AllocatorSize totalMemory, int granuleShift) {
+    bitmap->granuleShift = granuleShift;
+    bitmap->granuleCount = totalMemory >> granuleShift;
+    bitmap->wordCount = (bitmap->granuleCount + 63) >> 6;
+    bitmap->summaryWords[0] = (bitmap->wordCount + 63) >> 6;
+    bitmap->summaryWords[1] = (bitmap->summaryWords[0] + 63) >> 6;
+    if (bitmap->granuleCount == 0 || (unsigned long long)bitmap->wordCount > SIZE_MAX / sizeof(unsigned long long))
+        return 0;
+    bitmap->used = (unsigned long long *)calloc((size_t)bitmap->wordCount, sizeof(unsigned long long));
+    bitmap->starts = (unsigned long long *)calloc((size_t)bitmap->wordCount, sizeof(unsigned long long));
+    for (int level = 0; level < 2; level++) {
+        bitmap->usedSummary[level] = (unsigned long long *)calloc((size_t)bitmap->summaryWords[level], sizeof(unsigned long long));
+        bitmap->freeSummary[level] = (unsigned long long *)calloc((size_t)bitmap->summaryWords[level], sizeof(unsigned long long));
+        if (!bitmap->usedSummary[level] || !bitmap->freeSummary[level])
+            return 0;
+    }
+    if (!bitmap->used || !bitmap->starts)
+        return 0;
+    if (bitmap->granuleCount & 63) // Padding reads as allocated, so FREE runs end at granuleCount
+        bitmap->used[bitmap->wordCount - 1] = ~0ULL << (bitmap->granuleCount & 63);
+    for (AllocatorSize word = 0; word < bitmap->wordCount; word++)
+        refreshSummaries(bitmap, word);
+    return 1;
+}
+
+/** Adds (delta 1) or removes (delta -1) a FREE run of granules from the free counters. */
+static void countBitmapFree(Allocator *allocator, AllocatorSize granules, int delta) {
+    trackLargestFree(allocator, granuleAddress(&allocator->bitmap, granules), delta);
+    allocator->sizeClassCounts[sizeClass(granuleAddress(&allocator->bitmap, granules))] += delta;
+    allocator->freeBlockCount += delta;
+    allocator->bitmap.freeGranules += delta * granules;
+}
+
+/** Raises the bitmap engine's block high-water mark to the current block count. */
+static void noteBitmapPeak(Allocator *allocator) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    if (bitmap->ownerCount + allocator->freeBlockCount > bitmap->peakBlockCount)
+        bitmap->peakBlockCount = bitmap->ownerCount + allocator->freeBlockCount;
+}
+
+/** Spreads a start granule over the owner table. */
+static size_t hashGranule(AllocatorSize granule) {
+    unsigned long long hash = (unsigned long long)granule * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+/** Returns the owner slot of the block starting at granule, or the empty slot where it would go. */
+static int *probeBitmapOwners(const Allocator *allocator, int *slots, size_t capacity, AllocatorSize granule) {
+    size_t slot = hashGranule(granule) & (capacity - 1);
+    while (slots[slot] && allocator->processes[slots[slot] - 1].bitmapStart != granule)
+        slot = (slot + 1) & (capacity - 1);
+    return &slots[slot];
+}
+
+/** Makes sure the owner table has room for one more block. Returns 0 if host memory ran out. */
+static int reserveBitmapOwner(Allocator *allocator) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    if ((size_t)(bitmap->ownerCount + 1) * 2 <= bitmap->ownerCapacity)
+        return 1;
+    size_t capacity = bitmap->ownerCapacity ? bitmap->ownerCapacity * 2 : BITMAP_OWNER_MIN_CAPACITY;
+    int *slots = (int *)calloc(capacity, sizeof(int));
+    if (!slots)
+        return 0;
+    for (size_t slot = 0; slot < bitmap->ownerCapacity; slot++) {
+        int entry = bitmap->owners[slot];
+        if (entry)
+            *probeBitmapOwners(allocator, slots, capacity, allocator->processes[entry - 1].bitmapStart) = entry;
+    }
+    free(bitmap->owners);
+    bitmap->owners = slots;
+    bitmap->ownerCapacity = capacity;
+    return 1;
+}
+
+/** Files the block owned by handle under its start granule. Callers reserve a slot beforehand. */
+static void insertBitmapOwner(Allocator *allocator, int handle) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    *probeBitmapOwners(allocator, bitmap->owners, bitmap->ownerCapacity, allocator->processes[handle].bitmapStart) =
+        handle + 1;
+    bitmap->ownerCount++;
+}
+
+/** Removes the block owned by handle from the owner table, shifting back the entries after
+ *  it in its probe run that would otherwise become unreachable. */
+static void removeBitmapOwner(Allocator *allocator, int handle) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    size_t mask = bitmap->ownerCapacity - 1;
+    size_t hole = (size_t)(probeBitmapOwners(allocator, bitmap->owners, bitmap->ownerCapacity,
+                                             allocator->processes[handle].bitmapStart) - bitmap->owners);
+    bitmap->owners[hole] = 0;
+    for (size_t slot = (hole + 1) & mask; bitmap->owners[slot]; slot = (slot + 1) & mask) {
+        size_t home = hashGranule(allocator->processes[bitmap->owners[slot] - 1].bitmapStart) & mask;
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            bitmap->owners[hole] = bitmap->owners[slot];
+            bitmap->owners[slot] = 0;
+            hole = slot;
+        }
+    }
+    bitmap->ownerCount--;
+}
+
+/** Returns the handle owning the allocated block that starts at granule. */
+static int bitmapOwner(const Allocator *allocator, AllocatorSize granule) {
+    const GranuleBitmap *bitmap = &allocator->bitmap;
+    return *probeBitmapOwners(allocator, bitmap->owners, bitmap->ownerCapacity, granule) - 1;
+}
+
+/** Returns the granules of the block owned by handle. */
+static AllocatorSize ownedGranules(const Allocator *allocator, int handle) {
+    return granulesFor(&allocator->bitmap, allocator->processes[handle].bitmapRequested);
+}
+
+/** Finds the first FREE run at or after from: returns its first granule and sets *end to the
+ *  granule after it. Returns granuleCount if there is none. */
+static AllocatorSize nextFreeRun(const GranuleBitmap *bitmap, AllocatorSize from, AllocatorSize *end) {
+    AllocatorSize start = nextGranule(bitmap, from, 0);
+    *end = nextGranule(bitmap, start, 1);
+    return start;
+}
+
+/** Returns 1 if the FREE run [start, end) can hold granules starting at a multiple of alignment. */
+static int runFits(AllocatorSize start, AllocatorSize end, AllocatorSize granules, AllocatorSize alignment) {
+    return end - start >= granules && end - start - granules >= alignmentPadding(start, alignment);
+}
+
+/** Template of findBitmapFirstFit. */
+SCAN_TEMPLATE AllocatorSize scanBitmapFirstFit(const GranuleBitmap *bitmap, AllocatorSize from, AllocatorSize to,
+                                               AllocatorSize granules, AllocatorSize alignment,
+                                               AllocatorScanStats *scan) {
+    AllocatorSize end;
+    for (AllocatorSize start = nextFreeRun(bitmap, from, &end); start < to; start = nextFreeRun(bitmap, end, &end)) {
+        COUNT_VISITS(scan, 1);
+        if (runFits(start, end, granules, alignment))
+            return start;
+    }
+    return -1;
+}
+
+/** Returns the first FREE run starting in [from, to) that can hold granules aligned, or -1. */
+static AllocatorSize findBitmapFirstFit(const GranuleBitmap *bitmap, AllocatorSize from, AllocatorSize to,
+                                        AllocatorSize granules, AllocatorSize alignment, AllocatorScanStats *scan) {
+    return alignment == 1 ? scanBitmapFirstFit(bitmap, from, to, granules, 1, scan)
+                          : scanBitmapFirstFit(bitmap, from, to, granules, alignment, scan);
+}
+
+/** Template of findBitmapBestFit. */
+SCAN_TEMPLATE AllocatorSize scanBitmapBestFit(const GranuleBitmap *bitmap, AllocatorSize granules,
+                                              AllocatorSize alignment, AllocatorScanStats *scan) {
+    AllocatorSize best = -1, bestSize = 0, end;
+    for (AllocatorSize start = nextFreeRun(bitmap, 0, &end); start < bitmap->granuleCount;
+         start = nextFreeRun(bitmap, end, &end)) {
+        COUNT_VISITS(scan, 1);
+        if (runFits(start, end, granules, alignment) && (best < 0 || end - start < bestSize)) {
+            best = start;
+            bestSize = end - start;
+        }
+    }
+    return best;
+}
+
+/** Returns the smallest FREE run that can hold granules aligned (lowest address among equals), or -1. */
+static AllocatorSize findBitmapBestFit(const GranuleBitmap *bitmap, AllocatorSize granules, AllocatorSize alignment,
+                                       AllocatorScanStats *scan) {
+    return alignment == 1 ? scanBitmapBestFit(bitmap, granules, 1, scan)
+                          : scanBitmapBestFit(bitmap, granules, alignment, scan);
+}
+
+/** Template of findBitmapWorstFit. */
+SCAN_TEMPLATE AllocatorSize scanBitmapWorstFit(const GranuleBitmap *bitmap, AllocatorSize granules,
+                                               AllocatorSize alignment, AllocatorScanStats *scan) {
+    AllocatorSize largest = -1, largestFitting = -1, largestSize = 0, fittingSize = 0, end;
+    for (AllocatorSize start = nextFreeRun(bitmap, 0, &end); start < bitmap->granuleCount;
+         start = nextFreeRun(bitmap, end, &end)) {
+        COUNT_VISITS(scan, 1);
+        if (end - start > largestSize) {
+            largest = start;
+            largestSize = end - start;
+        }
+        if (alignment > 1 && end - start >= fittingSize && runFits(start, end, granules, alignment)) {
+            largestFitting = start;
+            fittingSize = end - start;
+        }
+    }
+    if (largest >= 0 && runFits(largest, largest + largestSize, granules, alignment))
+        return largest;
+    return largestFitting;
+}
+
+/** Picks a Worst Fit run the way findArrayWorstFit picks a block. Returns -1 if none fits. */
+static AllocatorSize findBitmapWorstFit(const GranuleBitmap *bitmap, AllocatorSize granules, AllocatorSize alignment,
+                                        AllocatorScanStats *scan) {
+    return alignment == 1 ? scanBitmapWorstFit(bitmap, granules, 1, scan)
+                          : scanBitmapWorstFit(bitmap, granules, alignment, scan);
+}
+
+/** Template of findBitmapSegregatedFit. */
+SCAN_TEMPLATE AllocatorSize scanBitmapSegregatedFit(const GranuleBitmap *bitmap, AllocatorSize granules,
+                                                    AllocatorSize alignment, AllocatorScanStats *scan) {
+    int requestClass = sizeClass(granuleAddress(bitmap, granules)), bestClass = SIZE_CLASS_COUNT;
+    AllocatorSize best = -1, end;
+    for (AllocatorSize start = nextFreeRun(bitmap, 0, &end); start < bitmap->granuleCount;
+         start = nextFreeRun(bitmap, end, &end)) {
+        COUNT_VISITS(scan, 1);
+        int runClass = sizeClass(granuleAddress(bitmap, end - start));
+        if (runClass >= bestClass || !runFits(start, end, granules, alignment))
+            continue;
+        best = start;
+        bestClass = runClass;
+        if (bestClass == requestClass)
+            break;
+    }
+    return best;
+}
+
+/** Segregated Fit over FREE runs: the lowest-address run of the smallest size class that can
+ *  hold granules aligned. Stops at the first fit in the request's own class. */
+static AllocatorSize findBitmapSegregatedFit(const GranuleBitmap *bitmap, AllocatorSize granules,
+                                             AllocatorSize alignment, AllocatorScanStats *scan) {
+    return alignment == 1 ? scanBitmapSegregatedFit(bitmap, granules, 1, scan)
+                          : scanBitmapSegregatedFit(bitmap, granules, alignment, scan);
+}
+
+/** Allocates requested bytes for handle at the first aligned granule of the FREE run that
+ *  starts at start. The skipped head and the rest of the run stay FREE as their own runs. */
+static void placeBitmapProcess(Allocator *allocator, AllocatorSize start, int handle, AllocatorSize requested,
+                               AllocatorSize alignment) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    ProcessEntry *entry = &allocator->processes[handle];
+    AllocatorSize end = nextGranule(bitmap, start, 1);
+    AllocatorSize first = start + alignmentPadding(start, alignment), granules = granulesFor(bitmap, requested);
+    countBitmapFree(allocator, end - start, -1);
+    if (first > start) {
+        countBitmapFree(allocator, first - start, 1);
+        allocator->splits++;
+    }
+    if (end > first + granules) {
+        countBitmapFree(allocator, end - first - granules, 1);
+        allocator->splits++;
+    }
+    markGranules(bitmap, first, granules, 1);
+    writeBit(bitmap->starts, first, 1);
+    entry->bitmapStart = first;
+    entry->bitmapRequested = requested;
+    insertBitmapOwner(allocator, handle);
+    bitmap->internalFragmentation += granuleAddress(bitmap, granules) - requested;
+    noteBitmapPeak(allocator);
+}
+
+/** Places a request with the bitmap engine's chosen strategy. Returns 0 if nothing fits. */
+static int bitmapAllocate(Allocator *allocator, int handle, AllocatorSize size, AllocatorSize alignment,
+                          AllocatorStrategy strategy) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    AllocatorScanStats *scan = &allocator->scans[strategy];
+    AllocatorSize granules = granulesFor(bitmap, size), start = -1;
+    alignment = granuleAlignment(bitmap, alignment);
+    scan->requests++;
+    if (granules > bitmap->freeGranules)
+        return 0;
+    switch (strategy) {
+    case ALLOCATOR_FIRST_FIT:
+        start = findBitmapFirstFit(bitmap, 0, bitmap->granuleCount, granules, alignment, scan);
+        break;
+    case ALLOCATOR_NEXT_FIT: {
+        AllocatorSize from = bitmap->nextFitGranule;
+        if (from < bitmap->granuleCount && !granuleUsed(bitmap, from))
+            from = previousGranule(bitmap, from, 1) + 1; // The whole run holding the cursor
+        start = findBitmapFirstFit(bitmap, from, bitmap->granuleCount, granules, alignment, scan);
+        if (start < 0)
+            start = findBitmapFirstFit(bitmap, 0, from, granules, alignment, scan);
+        break;
+    }
+    case ALLOCATOR_BEST_FIT:
+        start = findBitmapBestFit(bitmap, granules, alignment, scan);
+        break;
+    case ALLOCATOR_WORST_FIT:
+        start = findBitmapWorstFit(bitmap, granules, alignment, scan);
+        break;
+    case ALLOCATOR_SEGREGATED_FIT:
+        start = findBitmapSegregatedFit(bitmap, granules, alignment, scan);
+        break;
+    default:
+        break;
+    }
+    if (start < 0)
+        return 0;
+    placeBitmapProcess(allocator, start, handle, size, alignment);
+    if (strategy == ALLOCATOR_NEXT_FIT)
+        bitmap->nextFitGranule = allocator->processes[handle].bitmapStart + granules;
+    return 1;
+}
+
+/** Clears granules [first, first + count) and folds the FREE runs on either side into the
+ *  new one. The bytes are left in place. */
+static void freeBitmapGranules(Allocator *allocator, AllocatorSize first, AllocatorSize count) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    AllocatorSize runStart = previousGranule(bitmap, first, 1) + 1, runEnd = nextGranule(bitmap, first + count, 1);
+    if (runStart < first) {
+        countBitmapFree(allocator, first - runStart, -1);
+        allocator->merges++;
+    }
+    if (runEnd > first + count) {
+        countBitmapFree(allocator, runEnd - first - count, -1);
+        allocator->merges++;
+    }
+    markGranules(bitmap, first, count, 0);
+    countBitmapFree(allocator, runEnd - runStart, 1);
+    if (runStart < bitmap->compactedBelow)
+        bitmap->compactedBelow = runStart;
+}
+
+/** Returns to the OS the whole pages of the FREE run holding granules [first, first + count)
+ *  that overlap them. */
+static void discardBitmapPages(Allocator *allocator, AllocatorSize first, AllocatorSize count) {
+    const GranuleBitmap *bitmap = &allocator->bitmap;
+    if (!allocator->backing)
+        return;
+    AllocatorSize runStart = previousGranule(bitmap, first, 1) + 1, runEnd = nextGranule(bitmap, first, 1);
+    discardFreePages(allocator, granuleAddress(bitmap, runStart), granuleAddress(bitmap, runEnd) - 1,
+                     granuleAddress(bitmap, first), granuleAddress(bitmap, first + count) - 1);
+}
+
+/** Takes the block owned by handle out of the owner table and frees its granules. */
+static void freeBitmapBlock(Allocator *allocator, int handle) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    ProcessEntry *entry = &allocator->processes[handle];
+    AllocatorSize first = entry->bitmapStart, granules = ownedGranules(allocator, handle);
+    removeBitmapOwner(allocator, handle);
+    writeBit(bitmap->starts, first, 0);
+    bitmap->internalFragmentation -= granuleAddress(bitmap, granules) - entry->bitmapRequested;
+    freeBitmapGranules(allocator, first, granules);
+    entry->bitmapStart = -1;
+}
+
+/** Releases the block owned by handle and discards its whole free pages. */
+static void releaseBitmapBlock(Allocator *allocator, int handle) {
+    AllocatorSize first = allocator->processes[handle].bitmapStart, granules = ownedGranules(allocator, handle);
+    freeBitmapBlock(allocator, handle);
+    discardBitmapPages(allocator, first, granules);
+}
+
+/** Resizes the bitmap block owned by handle the way resizeArrayBlock resizes an array block:
+ *  in place when it keeps its granule count, shrinks, or the FREE run after it is large
+ *  enough, else by moving it. Returns 0 (with nothing changed) if it has nowhere to go. */
+static int resizeBitmapBlock(Allocator *allocator, int handle, AllocatorSize newSize, AllocatorStrategy strategy) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    ProcessEntry *entry = &allocator->processes[handle];
+    AllocatorSize alignment = processAlignment(allocator, handle);
+    AllocatorSize first = entry->bitmapStart, requested = entry->bitmapRequested;
+    AllocatorSize granules = granulesFor(bitmap, requested), newGranules = granulesFor(bitmap, newSize);
+    AllocatorSize end = first + granules, nextEnd = nextGranule(bitmap, end, 1);
+
+    if (newGranules <= granules || nextEnd - end >= newGranules - granules) {
+        if (newGranules < granules) { // The tail granules become FREE, merged into a FREE successor
+            AllocatorSize tail = first + newGranules;
+            if (nextEnd > end)
+                countBitmapFree(allocator, nextEnd - end, -1);
+            else
+                allocator->splits++;
+            markGranules(bitmap, tail, granules - newGranules, 0);
+            countBitmapFree(allocator, nextEnd - tail, 1);
+            if (tail < bitmap->compactedBelow)
+                bitmap->compactedBelow = tail;
+            noteBitmapPeak(allocator);
+            discardBitmapPages(allocator, tail, granules - newGranules);
+        } else if (newGranules > granules) { // Take the head of the FREE successor
+            countBitmapFree(allocator, nextEnd - end, -1);
+            if (nextEnd > first + newGranules)
+                countBitmapFree(allocator, nextEnd - first - newGranules, 1);
+            markGranules(bitmap, end, newGranules - granules, 1);
+        }
+        bitmap->internalFragmentation +=
+            granuleAddress(bitmap, newGranules) - newSize - (granuleAddress(bitmap, granules) - requested);
+        entry->bitmapRequested = newSize;
+        allocator->resizesInPlace++;
+        return 1;
+    }
+
+    removeBitmapOwner(allocator, handle); // The search below may file the moved block under its new start
+    if (bitmapAllocate(allocator, handle, newSize, alignment, strategy)) {
+        if (allocator->backing)
+            memcpy(allocator->backing + granuleAddress(bitmap, entry->bitmapStart),
+                   allocator->backing + granuleAddress(bitmap, first), (size_t)granuleAddress(bitmap, granules));
+        writeBit(bitmap->starts, first, 0);
+        bitmap->internalFragmentation -= granuleAddress(bitmap, granules) - requested;
+        freeBitmapGranules(allocator, first, granules);
+        discardBitmapPages(allocator, first, granules);
+        allocator->resizesMoved++;
+        return 1;
+    }
+    AllocatorSize regionStart = previousGranule(bitmap, first, 1) + 1;
+    if (nextEnd - regionStart < newGranules + alignmentPadding(regionStart, granuleAlignment(bitmap, alignment))) {
+        insertBitmapOwner(allocator, handle);
+        return 0;
+    }
+    writeBit(bitmap->starts, first, 0);
+    bitmap->internalFragmentation -= granuleAddress(bitmap, granules) - requested;
+    freeBitmapGranules(allocator, first, granules);
+    placeBitmapProcess(allocator, regionStart, handle, newSize, granuleAlignment(bitmap, alignment));
+    AllocatorSize newEnd = entry->bitmapStart + newGranules;
+    if (allocator->backing) {
+        memmove(allocator->backing + granuleAddress(bitmap, entry->bitmapStart),
+                allocator->backing + granuleAddress(bitmap, first), (size_t)granuleAddress(bitmap, granules));
+        if (newEnd < bitmap->granuleCount && !granuleUsed(bitmap, newEnd))
+            discardFreePages(allocator, granuleAddress(bitmap, newEnd),
+                             granuleAddress(bitmap, nextGranule(bitmap, newEnd, 1)) - 1, granuleAddress(bitmap, first),
+                             granuleAddress(bitmap, end) - 1);
+    }
+    allocator->resizesMoved++;
+    return 1;
+}
+
+/** Slides allocated blocks down over FREE runs with the same budget and alignment rules as
+ *  slideArrayBlocks. Each move clears the block's old bits and sets its new ones, so a full
+ *  compaction rebuilds the bitmap in one pass from compactedBelow to the last block. */
+static int slideBitmapBlocks(Allocator *allocator, int maxBlocks, AllocatorSize maxBytes) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    AllocatorSize position = bitmap->compactedBelow, gapStart;
+    int movedBlocks = 0;
+    AllocatorSize movedBytes = 0;
+    if (position < bitmap->granuleCount && !granuleUsed(bitmap, position))
+        position = previousGranule(bitmap, position, 1) + 1;
+    for (;;) {
+        gapStart = nextGranule(bitmap, position, 0);
+        AllocatorSize first = nextGranule(bitmap, gapStart, 1);
+        if (first >= bitmap->granuleCount)
+            break; // No free space, or it is all in the final run
+        int owner = bitmapOwner(allocator, first);
+        AllocatorSize granules = ownedGranules(allocator, owner), bytes = granuleAddress(bitmap, granules);
+        AllocatorSize target = gapStart + alignmentPadding(gapStart, granuleAlignment(bitmap, processAlignment(allocator, owner)));
+        if (target >= first) {
+            position = first + granules; // Its alignment pins the block in place; the gap stays behind as padding
+            continue;
+        }
+        if (movedBlocks > 0 && ((maxBlocks > 0 && movedBlocks >= maxBlocks) ||
+                                (maxBytes > 0 && movedBytes + bytes > maxBytes))) {
+            bitmap->compactedBelow = gapStart;
+            flushRelocationRun(allocator);
+            return 0;
+        }
+
+        AllocatorSize end = first + granules, runEnd = nextGranule(bitmap, end, 1);
+        countBitmapFree(allocator, first - gapStart, -1);
+        if (runEnd > end) {
+            countBitmapFree(allocator, runEnd - end, -1);
+            allocator->merges++;
+        }
+        removeBitmapOwner(allocator, owner);
+        writeBit(bitmap->starts, first, 0);
+        markGranules(bitmap, first, granules, 0);
+        markGranules(bitmap, target, granules, 1);
+        writeBit(bitmap->starts, target, 1);
+        allocator->processes[owner].bitmapStart = target;
+        insertBitmapOwner(allocator, owner);
+        if (target > gapStart) { // The aligned slot starts inside the gap: its head stays FREE
+            countBitmapFree(allocator, target - gapStart, 1);
+            allocator->splits++;
+        }
+        countBitmapFree(allocator, runEnd - target - granules, 1);
+        noteBitmapPeak(allocator);
+        noteRelocation(allocator, granuleAddress(bitmap, first), granuleAddress(bitmap, target), bytes);
+
+        allocator->blocksMoved++;
+        allocator->bytesMoved += bytes;
+        movedBlocks++;
+        movedBytes += bytes;
+        position = target + granules;
+    }
+    bitmap->compactedBelow = gapStart;
+    flushRelocationRun(allocator);
+    if (gapStart < bitmap->granuleCount && movedBlocks > 0)
+        discardFreePages(allocator, granuleAddress(bitmap, gapStart), granuleAddress(bitmap, bitmap->granuleCount) - 1,
+                         granuleAddress(bitmap, gapStart), granuleAddress(bitmap, bitmap->granuleCount) - 1);
+    return 1;
+}
+
+/** Describes a list block to the caller. */
+static void describeListBlock(const Allocator *allocator, const Node *node, AllocatorBlock *block) {
+    block->startAddress = node->startAddress;
+    block->endAddress = node->endAddress;
+    block->size = node->availableSpace;
+    block->isFree = node->state == BLOCK_FREE;
+    block->requested = block->isFree ? 0 : node->availableSpace;
+    block->handle = block->isFree ? -1 : publicHandle(allocator, node->owner);
+    block->data = allocator->backing ? allocator->backing + block->startAddress : NULL;
+    block->owner = block->isFree ? NULL : allocator->processes[node->owner].processId;
+}
+
+/** Describes the buddy block starting at leaf to the caller. */
+static void describeBuddyBlock(const Allocator *allocator, int leaf, AllocatorBlock *block) {
+    const BuddyHeap *buddy = &allocator->buddy;
+    block->startAddress = buddyLeafAddress(leaf);
+    block->size = (AllocatorSize)1 << (buddy->blockInfo[leaf] & ~BUDDY_FREE_BIT);
+    block->endAddress = block->startAddress + block->size - 1;
+    block->isFree = (buddy->blockInfo[leaf] & BUDDY_FREE_BIT) != 0;
+    block->requested = block->isFree ? 0 : buddy->requested[leaf];
+    block->handle = block->isFree ? -1 : publicHandle(allocator, buddy->owner[leaf]);
+    block->data = allocator->backing ? allocator->backing + block->startAddress : NULL;
+    block->owner = block->isFree ? NULL : allocator->processes[buddy->owner[leaf]].processId;
+}
+
+/** Describes the array block at index to the caller. */
+static void describeArrayBlock(const Allocator *allocator, int index, AllocatorBlock *block) {
+    const BlockArray *array = &allocator->array;
+    int slot = arraySlot(array, index);
+    block->startAddress = array->starts[slot];
+    block->size = array->sizes[slot];
+    block->endAddress = block->startAddress + block->size - 1;
+    block->isFree = array->owners[slot] < 0;
+    block->requested = block->isFree ? 0 : block->size;
+    block->handle = block->isFree ? -1 : publicHandle(allocator, array->owners[slot]);
+    block->data = allocator->backing ? allocator->backing + block->startAddress : NULL;
+    block->owner = block->isFree ? NULL : allocator->processes[array->owners[slot]].processId;
+}
+
+/** Describes the bitmap block starting at granule first to the caller. Returns the granule
+ *  after it. */
+static AllocatorSize describeBitmapBlock(const Allocator *allocator, AllocatorSize first, AllocatorBlock *block) {
+    const GranuleBitmap *bitmap = &allocator->bitmap;
+    block->isFree = !granuleUsed(bitmap, first);
+    int owner = block->isFree ? -1 : bitmapOwner(allocator, first);
+    AllocatorSize end = block->isFree ? nextGranule(bitmap, first, 1) : first + ownedGranules(allocator, owner);
+    block->startAddress = granuleAddress(bitmap, first);
+    block->size = granuleAddress(bitmap, end - first);
+    block->endAddress = block->startAddress + block->size - 1;
+    block->requested = block->isFree ? 0 : allocator->processes[owner].bitmapRequested;
+    block->handle = publicHandle(allocator, owner);
+    block->data = allocator->backing ? allocator->backing + block->startAddress : NULL;
+    block->owner = block->isFree ? NULL : allocator->processes[owner].processId;
+    return end;
+}
+
+/** Returns the first granule of the bitmap block holding address, or -1 past the last granule. */
+static AllocatorSize bitmapBlockContaining(const GranuleBitmap *bitmap, AllocatorSize address) {
+    AllocatorSize granule = address >> bitmap->granuleShift;
+    if (granule >= bitmap->granuleCount)
+        return -1;
+    return granuleUsed(bitmap, granule) ? blockStartGranule(bitmap, granule) : previousGranule(bitmap, granule, 1) + 1;
+}
+
+/** Returns the leaf where the buddy block holding address starts, or -1 past the last leaf.
+ *  Only a block's first leaf has a non-zero blockInfo, so the smallest order whose aligned
+ *  candidate start records that order is the containing block. */
+static int buddyBlockContaining(const BuddyHeap *buddy, AllocatorSize address) {
+    if (address >= buddyLeafAddress(buddy->leafCount))
+        return -1;
+    int leaf = (int)(address >> BUDDY_MIN_ORDER);
+    for (int order = BUDDY_MIN_ORDER; order < BUDDY_MAX_ORDER; order++) {
+        int start = leaf & ~((1 << (order - BUDDY_MIN_ORDER)) - 1);
+        if ((buddy->blockInfo[start] & ~BUDDY_FREE_BIT) == order)
+            return start;
+    }
+    return -1;
+}
+
+/** Makes sure the engine can split free space off both ends of a block without asking the
+ *  host for memory. Returns 0 if host memory ran out. */
+static int reserveBlocks(Allocator *allocator) {
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY)
+        return reserveArraySlots(&allocator->array);
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        return reserveBitmapOwner(allocator);
+    return reserveNode(allocator);
+}
+
+/** Maps a real buffer under a fresh heap. Destroys the heap and returns NULL if it cannot. */
+static Allocator *attachBacking(Allocator *allocator) {
+    if (!allocator)
+        return NULL;
+    if ((unsigned long long)allocator->lastAddressSpace >= SIZE_MAX) {
+        allocator_destroy(allocator); // Larger than this host can map
+        return NULL;
+    }
+    allocator->pageSize = hostPageSize();
+    allocator->backing = mapBacking((size_t)allocator->lastAddressSpace + 1);
+    if (!allocator->backing) {
+        allocator_destroy(allocator);
+        return NULL;
+    }
+    return allocator;
+}
+
+/** Returns log2 of a bitmap granule size, or -1 if it is not a power of two in range. */
+static int bitmapGranuleShift(AllocatorSize granule) {
+    if (granule <= 0 || (granule & (granule - 1)) != 0 || granule > ((AllocatorSize)1 << BITMAP_MAX_GRANULE_SHIFT))
+        return -1;
+    return sizeClass(granule);
+}
+
+/** Creates a simulated heap for any engine; granuleShift is only read by the bitmap engine. */
+static Allocator *createAllocator(AllocatorSize size, AllocatorEngine engine, int granuleShift) {
+    if (size < 1 || (unsigned)engine >= ALLOCATOR_ENGINE_COUNT || (engine == ALLOCATOR_ENGINE_BUDDY && size > BUDDY_MAX_SIZE))
+        return NULL;
+    Allocator *allocator = (Allocator *)calloc(1, sizeof(Allocator));
+    if (!allocator)
+        return NULL;
+    allocator->engine = engine;
+    allocator->treapSeed = 2463534242u;
+    allocator->waits.freeEntry = -1;
+    allocator->freeProcess = -1;
+    allocator->lastAddressSpace = size - 1;
+    if (!reserveNode(allocator)) {
+        free(allocator);
+        return NULL;
+    }
+    allocator->dummyHead = allocateNode(allocator);
+    allocator->dummyHead->availableSpace = size;
+    allocator->dummyHead->state = BLOCK_ALLOCATED; // Sentinel: never merged
+    allocator->dummyHead->owner = -1;
+    allocator->dummyHead->next = NULL;
+    allocator->dummyHead->prev = NULL;
+    allocator->dummyHead->startAddress = allocator->dummyHead->endAddress = -1;
+    allocator->compactionFrontier = allocator->dummyHead;
+
+    if (engine == ALLOCATOR_ENGINE_BUDDY) {
+        if (!initBuddyHeap(&allocator->buddy, size)) {
+            allocator_destroy(allocator);
+            return NULL;
+        }
+        return allocator;
+    }
+    if (engine == ALLOCATOR_ENGINE_ARRAY) {
+        allocator->array.nextFitAddress = -1;
+        allocator->array.kernels = selectFreeSizeKernels();
+        if (!reserveArraySlots(&allocator->array)) {
+            allocator_destroy(allocator);
+            return NULL;
+        }
+        insertArrayBlock(allocator, 0, 0, size, -1);
+        return allocator;
+    }
+    if (engine == ALLOCATOR_ENGINE_BITMAP) {
+        if (!initGranuleBitmap(&allocator->bitmap, size, granuleShift) || !reserveBitmapOwner(allocator)) {
+            allocator_destroy(allocator);
+            return NULL;
+        }
+        countBitmapFree(allocator, allocator->bitmap.granuleCount, 1);
+        allocator->bitmap.peakBlockCount = 1;
+        return allocator;
+    }
+
+    Node *initialBlock = allocateNode(allocator);
+    initialBlock->state = BLOCK_FREE;
+    initialBlock->owner = -1;
+    initialBlock->startAddress = 0;
+    initialBlock->endAddress = allocator->lastAddressSpace;
+    initialBlock->availableSpace = size;
+    initialBlock->next = NULL;
+    initialBlock->prev = allocator->dummyHead;
+    allocator->dummyHead->next = initialBlock;
+    insertFreeIndex(allocator, initialBlock);
+    return allocator;
+}
+
+/* ---------------------------------------------------------------------------
+ * Wait queue. A request that finds no room parks in the heap of the size class
+ * of the block it needs. When space frees up, a wake looks only at the classes
+ * the largest FREE block could serve and retries their best entry first.
+ * ------------------------------------------------------------------------- */
+
+/** Recomputes a stale running largest FREE size. If the largest size added since it went
+ *  stale is the only FREE block in the highest non-empty size class, that is the answer;
+ *  otherwise the FREE blocks are rescanned. */
+static void refreshLargestFree(Allocator *allocator) {
+    int top = SIZE_CLASS_COUNT - 1;
+    while (top >= 0 && allocator->sizeClassCounts[top] == 0)
+        top--;
+    allocator->largestFreeStale = 0;
+    if (top < 0) {
+        allocator->largestFree = 0;
+        allocator->largestFreeCount = 0;
+        return;
+    }
+    if (allocator->largestFreeCount > 0 && sizeClass(allocator->largestFree) == top &&
+        allocator->sizeClassCounts[top] == 1)
+        return;
+    AllocatorSize largest = 0;
+    int count = 0;
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        const GranuleBitmap *bitmap = &allocator->bitmap;
+        AllocatorSize end;
+        for (AllocatorSize start = nextFreeRun(bitmap, 0, &end); start < bitmap->granuleCount;
+             start = nextFreeRun(bitmap, end, &end)) {
+            AllocatorSize freeSize = granuleAddress(bitmap, end - start);
+            if (freeSize > largest) {
+                largest = freeSize;
+                count = 0;
+            }
+            count += freeSize == largest;
+        }
+    } else {
+        const BlockArray *array = &allocator->array;
+        for (int index = 0; index < array->count; index++) {
+            AllocatorSize freeSize = array->freeSizes[arraySlot(array, index)];
+            if (freeSize > largest) {
+                largest = freeSize;
+                count = 0;
+            }
+            count += freeSize == largest;
+        }
+    }
+    allocator->largestFree = largest;
+    allocator->largestFreeCount = count;
+}
+
+/** Returns the size of the largest FREE block. On the array and bitmap engines a stale
+ *  running maximum is refreshed first, which may rescan the FREE blocks. */
+static AllocatorSize largestFreeBlock(Allocator *allocator) {
+    AllocatorSize largest = 0;
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        for (int order = BUDDY_MAX_ORDER - 1; order >= BUDDY_MIN_ORDER; order--) {
+            if (allocator->buddy.freeHeads[order] >= 0)
+                return (AllocatorSize)1 << order;
+        }
+    } else if (allocator->engine == ALLOCATOR_ENGINE_ARRAY || allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        if (allocator->largestFreeStale)
+            refreshLargestFree(allocator);
+        largest = allocator->largestFree;
+    } else {
+        const Node *node = allocator->freeTreeRoot;
+        while (node && node->sizeRight)
+            node = node->sizeRight;
+        largest = node ? node->availableSpace : 0;
+    }
+    return largest;
+}
+
+/** Returns 1 if an empty heap could hold size bytes at alignment, so waiting can succeed. */
+static int fitsEmptyHeap(const Allocator *allocator, AllocatorSize size, AllocatorSize alignment) {
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        int order = buddyOrderFor(size, alignment);
+        return order < BUDDY_MAX_ORDER && (allocator->buddy.leafCount >> (order - BUDDY_MIN_ORDER)) > 0;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        return granulesFor(&allocator->bitmap, size) <= allocator->bitmap.granuleCount;
+    return size <= allocator->lastAddressSpace + 1;
+}
+
+/** Returns the size class of the smallest FREE block that could hold a request, after the
+ *  engine's rounding and ignoring alignment padding. */
+static int waitSizeClass(const Allocator *allocator, AllocatorSize size, AllocatorSize alignment) {
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY)
+        return buddyOrderFor(size, alignment);
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        return sizeClass(granuleAddress(&allocator->bitmap, granulesFor(&allocator->bitmap, size)));
+    return sizeClass(size);
+}
+
+/** Describes the block owned by handle to the caller. */
+static void describeProcessBlock(const Allocator *allocator, int handle, AllocatorBlock *block) {
+    const ProcessEntry *entry = &allocator->processes[handle];
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY)
+        describeBuddyBlock(allocator, entry->buddyLeaf, block);
+    else if (allocator->engine == ALLOCATOR_ENGINE_ARRAY)
+        describeArrayBlock(allocator, arrayBlockContaining(&allocator->array, entry->arrayStart), block);
+    else if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        describeBitmapBlock(allocator, entry->bitmapStart, block);
+    else
+        describeListBlock(allocator, entry->block, block);
+}
+
+/** Places a validated request for handle with the engine's placement, filling in *block
+ *  (if non-NULL). Returns ALLOCATOR_ERR_NO_SPACE if no FREE block holds it. */
+static AllocatorStatus placeRequest(Allocator *allocator, int handle, AllocatorSize size, AllocatorSize alignment,
+                                    AllocatorStrategy strategy, AllocatorBlock *block) {
+    if (!reserveBlocks(allocator))
+        return ALLOCATOR_ERR_NO_MEMORY;
+    unsigned char alignShift = 0;
+    while (((AllocatorSize)1 << alignShift) < alignment)
+        alignShift++;
+    allocator->processes[handle].alignShift = alignShift;
+
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        int leaf = buddyAllocate(&allocator->buddy, handle, size, alignment);
+        if (leaf < 0)
+            return ALLOCATOR_ERR_NO_SPACE;
+        allocator->processes[handle].buddyLeaf = leaf;
+        if (block)
+            describeBuddyBlock(allocator, leaf, block);
+        return ALLOCATOR_OK;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+        int index = arrayAllocate(allocator, handle, size, alignment, strategy);
+        if (index < 0)
+            return ALLOCATOR_ERR_NO_SPACE;
+        if (block)
+            describeArrayBlock(allocator, index, block);
+        return ALLOCATOR_OK;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        if (!bitmapAllocate(allocator, handle, size, alignment, strategy))
+            return ALLOCATOR_ERR_NO_SPACE;
+        if (block)
+            describeBitmapBlock(allocator, allocator->processes[handle].bitmapStart, block);
+        return ALLOCATOR_OK;
+    }
+
+    Node *placed = listAllocate(allocator, handle, size, alignment, strategy);
+    if (!placed)
+        return ALLOCATOR_ERR_NO_SPACE;
+    if (block)
+        describeListBlock(allocator, placed, block);
+    return ALLOCATOR_OK;
+}
+
+/** Returns 1 if entry a is retried before entry b under the queue's policy. */
+static int waitsBefore(const WaitQueue *queue, int a, int b) {
+    const WaitEntry *x = &queue->entries[a], *y = &queue->entries[b];
+    if (queue->policy == ALLOCATOR_WAIT_PRIORITY && x->priority != y->priority)
+        return x->priority > y->priority;
+    return x->sequence < y->sequence;
+}
+
+/** Stores entry at index of heap. */
+static void setWaitHeapEntry(WaitQueue *queue, WaitHeap *heap, int index, int entry) {
+    heap->entries[index] = entry;
+    queue->entries[entry].heapIndex = index;
+}
+
+/** Moves the entry at index towards the root while it is retried before its parent. */
+static void siftWaitUp(WaitQueue *queue, WaitHeap *heap, int index) {
+    int entry = heap->entries[index];
+    while (index > 0 && waitsBefore(queue, entry, heap->entries[(index - 1) / 2])) {
+        setWaitHeapEntry(queue, heap, index, heap->entries[(index - 1) / 2]);
+        index = (index - 1) / 2;
+    }
+    setWaitHeapEntry(queue, heap, index, entry);
+}
+
+/** Moves the entry at index towards the leaves while a child is retried before it. */
+static void siftWaitDown(WaitQueue *queue, WaitHeap *heap, int index) {
+    int entry = heap->entries[index];
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count && waitsBefore(queue, heap->entries[child + 1], heap->entries[child]))
+            child++;
+        if (!waitsBefore(queue, heap->entries[child], entry))
+            break;
+        setWaitHeapEntry(queue, heap, index, heap->entries[child]);
+        index = child;
+    }
+    setWaitHeapEntry(queue, heap, index, entry);
+}
+
+/** Adds entry to the heap of its size class, which reserveWaitEntry made room in. */
+static void pushWaitEntry(WaitQueue *queue, int entry) {
+    int waitClass = queue->entries[entry].sizeClass;
+    WaitHeap *heap = &queue->heaps[waitClass];
+    heap->entries[heap->count++] = entry;
+    siftWaitUp(queue, heap, heap->count - 1);
+    queue->mask |= 1ULL << waitClass;
+}
+
+/** Takes entry out of its heap. */
+static void unlinkWaitEntry(WaitQueue *queue, int entry) {
+    int waitClass = queue->entries[entry].sizeClass;
+    WaitHeap *heap = &queue->heaps[waitClass];
+    int index = queue->entries[entry].heapIndex;
+    int last = heap->entries[--heap->count];
+    queue->entries[entry].heapIndex = -1;
+    if (index < heap->count) {
+        setWaitHeapEntry(queue, heap, index, last);
+        siftWaitUp(queue, heap, index);
+        siftWaitDown(queue, heap, queue->entries[last].heapIndex);
+    }
+    if (!heap->count)
+        queue->mask &= ~(1ULL << waitClass);
+}
+
+/** Makes room for one more entry in the pool and in the heap of waitClass. Entries passed
+ *  over by a running wake still count against their heap, since they go back in when it
+ *  ends. Returns 0 if host memory ran out. */
+static int reserveWaitEntry(WaitQueue *queue, int waitClass) {
+    if (queue->freeEntry < 0 && queue->used == queue->capacity) {
+        int capacity = queue->capacity ? queue->capacity * 2 : WAIT_QUEUE_MIN_CAPACITY;
+        WaitEntry *entries = (WaitEntry *)realloc(queue->entries, (size_t)capacity * sizeof(WaitEntry));
+        if (!entries)
+            return 0;
+        queue->entries = entries;
+        queue->capacity = capacity;
+    }
+    WaitHeap *heap = &queue->heaps[waitClass];
+    if (heap->members == heap->capacity) {
+        int capacity = heap->capacity ? heap->capacity * 2 : WAIT_QUEUE_MIN_CAPACITY;
+        int *entries = (int *)realloc(heap->entries, (size_t)capacity * sizeof(int));
+        if (!entries)
+            return 0;
+        heap->entries = entries;
+        heap->capacity = capacity;
+    }
+    return 1;
+}
+
+/** Returns an entry to the pool. */
+static void recycleWaitEntry(WaitQueue *queue, int entry) {
+    queue->heaps[queue->entries[entry].sizeClass].members--;
+    queue->entries[entry].next = queue->freeEntry;
+    queue->freeEntry = entry;
+}
+
+/** Finishes a parked request that is out of its heap: detaches it from its process, fills
+ *  in its future and runs its callback. An entry a running wake passed over stays out of
+ *  the pool (handle -1) until that wake drops it. */
+static void completeWaitEntry(Allocator *allocator, int entry, int passedOver, AllocatorStatus status,
+                              const AllocatorBlock *block) {
+    WaitQueue *queue = &allocator->waits;
+    WaitEntry *waiting = &queue->entries[entry];
+    ProcessEntry *process = &allocator->processes[waiting->handle];
+    char processId[PROCESS_ID_SIZE];
+    memcpy(processId, process->processId, PROCESS_ID_SIZE); // The callback may grow the process table
+    process->waitEntry = -1;
+    retireProcess(allocator, waiting->handle); // Unless the request was just placed
+    AllocatorWaitCallback callback = waiting->callback;
+    void *context = waiting->context;
+    AllocatorFuture result;
+    AllocatorFuture *future = waiting->future ? waiting->future : &result;
+    if (passedOver)
+        waiting->handle = -1;
+    else
+        recycleWaitEntry(queue, entry);
+    queue->count--;
+
+    future->status = status;
+    if (block) {
+        future->block = *block;
+    } else {
+        memset(&future->block, 0, sizeof(future->block));
+        future->block.startAddress = future->block.endAddress = -1;
+        future->block.handle = -1;
+    }
+    if (callback)
+        callback(processId, future, context);
+}
+
+/** Retries parked requests after space frees up. Each round takes the best entry among the
+ *  size classes the largest FREE block can serve; an entry that still does not fit (its
+ *  alignment padding or strategy needs more) is passed over until the wake ends, so it
+ *  does not hold back smaller requests behind it. Every engine keeps the largest FREE size
+ *  up to date, so a round never scans the heap. */
+static void wakeWaiters(Allocator *allocator) {
+    WaitQueue *queue = &allocator->waits;
+    if (!queue->count)
+        return;
+    if (queue->waking) {
+        queue->wakeAgain = 1; // A callback freed space; the running wake takes another pass
+        return;
+    }
+    queue->waking = 1;
+    do {
+        queue->wakeAgain = 0;
+        int passedOver = -1;
+        AllocatorSize largest = largestFreeBlock(allocator); // Read again only once a request is placed
+        while (largest) {
+            int top = sizeClass(largest);
+            unsigned long long eligible = queue->mask & (top >= 63 ? ~0ULL : (2ULL << top) - 1);
+            if (!eligible)
+                break;
+            int best = -1;
+            for (; eligible; eligible &= eligible - 1) {
+                int head = queue->heaps[lowestSizeClass(eligible)].entries[0];
+                if (best < 0 || waitsBefore(queue, head, best))
+                    best = head;
+            }
+            unlinkWaitEntry(queue, best);
+            const WaitEntry *waiting = &queue->entries[best];
+            AllocatorBlock block;
+            if (placeRequest(allocator, waiting->handle, waiting->size, waiting->alignment, waiting->strategy,
+                             &block) != ALLOCATOR_OK) {
+                queue->entries[best].next = passedOver;
+                passedOver = best;
+                continue;
+            }
+            queue->woken++;
+            completeWaitEntry(allocator, best, 0, ALLOCATOR_OK, &block);
+            largest = largestFreeBlock(allocator);
+        }
+        while (passedOver >= 0) {
+            int entry = passedOver;
+            passedOver = queue->entries[entry].next;
+            if (queue->entries[entry].handle < 0)
+                recycleWaitEntry(queue, entry); // Cancelled by a callback while passed over
+            else
+                pushWaitEntry(queue, entry);
+        }
+    } while (queue->wakeAgain);
+    queue->waking = 0;
+}
+
+/** Cancels every parked request and frees the wait queue. */
+static void cleanupWaitQueue(Allocator *allocator) {
+    WaitQueue *queue = &allocator->waits;
+    for (int waitClass = 0; waitClass < SIZE_CLASS_COUNT; waitClass++) {
+        WaitHeap *heap = &queue->heaps[waitClass];
+        while (heap->count) {
+            int entry = heap->entries[heap->count - 1];
+            unlinkWaitEntry(queue, entry);
+            queue->cancelled++;
+            completeWaitEntry(allocator, entry, 0, ALLOCATOR_ERR_CANCELLED, NULL);
+        }
+        free(heap->entries);
+    }
+    free(queue->entries);
+}
+
+/* ---------------------------------------------------------------------------
+ * Compaction policy. Watches external fragmentation and runs bounded compaction
+ * steps on its own, piggybacked on allocator calls or in the owner's idle time.
+ * ------------------------------------------------------------------------- */
+
+/** Returns the bytes in FREE blocks. */
+static AllocatorSize freeByteCount(const Allocator *allocator) {
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY)
+        return allocator->buddy.freeBytes;
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY)
+        return allocator->array.freeBytes;
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        return granuleAddress(&allocator->bitmap, allocator->bitmap.freeGranules);
+    return allocator->dummyHead->availableSpace;
+}
+
+/** Returns 1 if the policy should run a step: it is part way through a compaction, or free
+ *  space outside the largest FREE block has reached the threshold since the last one. Reads
+ *  only the counters every engine keeps as blocks split and merge, never the blocks. */
+static int compactionDue(Allocator *allocator) {
+    if (allocator->compaction.threshold <= 0 || allocator->engine == ALLOCATOR_ENGINE_BUDDY)
+        return 0;
+    if (allocator->policyCompacting)
+        return 1;
+    if (allocator->policySettled || allocator->freeBlockCount < 2)
+        return 0; // Only alignment padding is left outside the largest block, or nothing is
+    AllocatorSize free = freeByteCount(allocator);
+    return free > 0 && (double)(free - largestFreeBlock(allocator)) >= allocator->compaction.threshold * (double)free;
+}
+
+/** Runs one policy step if it is due. Returns 1 if it ran one. */
+static int runPolicyStep(Allocator *allocator) {
+    allocator->policyCalls = 0;
+    if (!compactionDue(allocator))
+        return 0;
+    allocator->policySteps++;
+    allocator->policyCompacting =
+        !allocator_compact_step(allocator, allocator->compaction.stepBlocks, allocator->compaction.stepBytes);
+    return 1;
+}
+
+/** Counts an allocate, resize or release call and lets the policy look once every
+ *  stepInterval of them. */
+static void maintainHeap(Allocator *allocator) {
+    if (allocator->compaction.threshold > 0 && ++allocator->policyCalls >= allocator->compaction.stepInterval)
+        runPolicyStep(allocator);
+}
+
+/** Compacts fully for an allocation of size bytes that found no room, if the policy asks
+ *  for it and compaction can make a large enough block. Returns 1 if it compacted. */
+static int compactForFailure(Allocator *allocator, AllocatorSize size) {
+    if (!allocator->compaction.compactOnFailure || allocator->engine == ALLOCATOR_ENGINE_BUDDY ||
+        allocator->policySettled || freeByteCount(allocator) < size)
+        return 0;
+    allocator->failureCompactions++;
+    allocator_compact(allocator);
+    return 1;
+}
+
+/** Notes that a release or resize freed space: the policy may look at the heap again, and
+ *  parked requests may now fit. */
+static void spaceFreed(Allocator *allocator) {
+    allocator->policySettled = 0;
+    wakeWaiters(allocator);
+}
+
+/* ---------------------------------------------------------------------------
+ * Public API
+ * ------------------------------------------------------------------------- */
+
+Allocator *allocator_create(AllocatorSize size, AllocatorEngine engine) {
+    return createAllocator(size, engine, BITMAP_DEFAULT_GRANULE_SHIFT);
+}
+
+Allocator *allocator_create_backed(AllocatorSize size, AllocatorEngine engine) {
+    return attachBacking(createAllocator(size, engine, BITMAP_DEFAULT_GRANULE_SHIFT));
+}
+
+Allocator *allocator_create_bitmap(AllocatorSize size, AllocatorSize granule) {
+    int granuleShift = bitmapGranuleShift(granule);
+    return granuleShift < 0 ? NULL : createAllocator(size, ALLOCATOR_ENGINE_BITMAP, granuleShift);
+}
+
+Allocator *allocator_create_bitmap_backed(AllocatorSize size, AllocatorSize granule) {
+    return attachBacking(allocator_create_bitmap(size, granule));
+}
+
+void *allocator_base(const Allocator *allocator) {
+    return allocator->backing;
+}
+
+void allocator_destroy(Allocator *allocator) {
+    if (!allocator)
+        return;
+    cleanupWaitQueue(allocator); // Callbacks may still read the process table
+    while (allocator->nodeSlabs) {
+        NodeSlab *slab = allocator->nodeSlabs;
+        allocator->nodeSlabs = slab->next;
+        free(slab);
+    }
+    free(allocator->processSlots);
+    free(allocator->processes);
+    cleanupBuddyHeap(&allocator->buddy);
+    cleanupBlockArray(&allocator->array);
+    cleanupGranuleBitmap(&allocator->bitmap);
+    free(allocator->deferred.slots);
+    if (allocator->backing)
+        unmapBacking(allocator->backing, (size_t)allocator->lastAddressSpace + 1);
+    free(allocator);
+}
+
+AllocatorStatus allocator_allocate(Allocator *allocator, const char *processId, AllocatorSize size,
+                                   AllocatorStrategy strategy, AllocatorBlock *block) {
+    return allocator_allocate_aligned(allocator, processId, size, 1, strategy, block);
+}
+
+/** Body of allocator_allocate_aligned. *handle receives the interned handle, or -1 if the
+ *  request was rejected before interning; the caller retires it if the request failed. */
+static AllocatorStatus allocateProcess(Allocator *allocator, const char *processId, AllocatorSize size,
+                                       AllocatorSize alignment, AllocatorStrategy strategy, AllocatorBlock *block,
+                                       int *handle) {
+    *handle = -1;
+    allocator_drain_releases(allocator);
+    if (!validProcessId(processId))
+        return ALLOCATOR_ERR_INVALID_ID;
+    int existing = lookupProcess(allocator, processId);
+    if (processOwnsBlock(allocator, existing) || processWaiting(allocator, existing))
+        return ALLOCATOR_ERR_EXISTS;
+    if ((unsigned)strategy >= ALLOCATOR_STRATEGY_COUNT)
+        return ALLOCATOR_ERR_INVALID_STRATEGY;
+    if (size <= 0)
+        return ALLOCATOR_ERR_INVALID_SIZE;
+    if (alignment <= 0 || (alignment & (alignment - 1)) != 0)
+        return ALLOCATOR_ERR_INVALID_ALIGNMENT;
+    *handle = internProcess(allocator, processId);
+    if (*handle < 0)
+        return ALLOCATOR_ERR_NO_MEMORY;
+    maintainHeap(allocator);
+    AllocatorStatus status = placeRequest(allocator, *handle, size, alignment, strategy, block);
+    if (status == ALLOCATOR_ERR_NO_SPACE && compactForFailure(allocator, size))
+        status = placeRequest(allocator, *handle, size, alignment, strategy, block);
+    return status;
+}
+
+AllocatorStatus allocator_allocate_aligned(Allocator *allocator, const char *processId, AllocatorSize size,
+                                           AllocatorSize alignment, AllocatorStrategy strategy, AllocatorBlock *block) {
+    int handle;
+    AllocatorStatus status = allocateProcess(allocator, processId, size, alignment, strategy, block, &handle);
+    retireProcess(allocator, handle); // Keeps it only if the block was placed
+    return status;
+}
+
+AllocatorStatus allocator_allocate_or_wait(Allocator *allocator, const char *processId, AllocatorSize size,
+                                           AllocatorSize alignment, AllocatorStrategy strategy, int priority,
+                                           AllocatorBlock *block, AllocatorWaitCallback callback, void *context,
+                                           AllocatorFuture *future) {
+    int handle;
+    AllocatorStatus status = allocateProcess(allocator, processId, size, alignment, strategy, block, &handle);
+    if (status != ALLOCATOR_ERR_NO_SPACE || !fitsEmptyHeap(allocator, size, alignment)) {
+        retireProcess(allocator, handle);
+        return status;
+    }
+
+    WaitQueue *queue = &allocator->waits;
+    int waitClass = waitSizeClass(allocator, size, alignment);
+    if (!reserveWaitEntry(queue, waitClass)) {
+        retireProcess(allocator, handle);
+        return ALLOCATOR_ERR_NO_MEMORY;
+    }
+    int entry = queue->freeEntry;
+    if (entry >= 0)
+        queue->freeEntry = queue->entries[entry].next;
+    else
+        entry = queue->used++;
+    WaitEntry *waiting = &queue->entries[entry];
+    waiting->size = size;
+    waiting->alignment = alignment;
+    waiting->strategy = strategy;
+    waiting->priority = priority;
+    waiting->sequence = queue->nextSequence++;
+    waiting->handle = handle;
+    waiting->sizeClass = waitClass;
+    waiting->callback = callback;
+    waiting->context = context;
+    waiting->future = future;
+    allocator->processes[waiting->handle].waitEntry = entry;
+    queue->heaps[waitClass].members++;
+    pushWaitEntry(queue, entry);
+    queue->count++;
+    queue->parked++;
+    if (future) {
+        memset(future, 0, sizeof(*future));
+        future->status = ALLOCATOR_PENDING;
+        future->block.startAddress = future->block.endAddress = -1;
+        future->block.handle = -1;
+    }
+    return ALLOCATOR_PENDING;
+}
+
+AllocatorStatus allocator_cancel_wait(Allocator *allocator, const char *processId) {
+    if (!validProcessId(processId))
+        return ALLOCATOR_ERR_INVALID_ID;
+    int handle = lookupProcess(allocator, processId);
+    if (!processWaiting(allocator, handle))
+        return ALLOCATOR_ERR_NOT_FOUND;
+    WaitQueue *queue = &allocator->waits;
+    int entry = allocator->processes[handle].waitEntry;
+    int passedOver = queue->entries[entry].heapIndex < 0; // Out of its heap while a wake runs
+    if (!passedOver)
+        unlinkWaitEntry(queue, entry);
+    queue->cancelled++;
+    completeWaitEntry(allocator, entry, passedOver, ALLOCATOR_ERR_CANCELLED, NULL);
+    return ALLOCATOR_OK;
+}
+
+void allocator_set_wait_policy(Allocator *allocator, AllocatorWaitPolicy policy) {
+    WaitQueue *queue = &allocator->waits;
+    queue->policy = policy;
+    for (int waitClass = 0; waitClass < SIZE_CLASS_COUNT; waitClass++) {
+        WaitHeap *heap = &queue->heaps[waitClass];
+        for (int index = heap->count / 2 - 1; index >= 0; index--)
+            siftWaitDown(queue, heap, index);
+    }
+}
+
+/** Orders bulk items by handle, then input position, to find repeated process IDs. */
+static int compareBulkHandle(const void *a, const void *b) {
+    const BulkItem *x = (const BulkItem *)a, *y = (const BulkItem *)b;
+    if (x->handle != y->handle)
+        return x->handle < y->handle ? -1 : 1;
+    return x->index - y->index;
+}
+
+/** Orders bulk items by size, then input position. */
+static int compareBulkSize(const void *a, const void *b) {
+    const BulkItem *x = (const BulkItem *)a, *y = (const BulkItem *)b;
+    if (x->size != y->size)
+        return x->size < y->size ? -1 : 1;
+    return x->index - y->index;
+}
+
+int allocator_allocate_many(Allocator *allocator, AllocatorRequest *requests, int count, AllocatorStrategy strategy) {
+    allocator_drain_releases(allocator);
+    if (count <= 0)
+        return 0;
+    maintainHeap(allocator);
+    BulkItem *items = (BulkItem *)malloc((size_t)count * sizeof(BulkItem));
+    int pending = 0;
+    for (int i = 0; i < count; i++) {
+        AllocatorRequest *request = &requests[i];
+        int handle = -1;
+        int valid = validProcessId(request->processId);
+        int existing = valid ? lookupProcess(allocator, request->processId) : -1;
+        if (!valid)
+            request->status = ALLOCATOR_ERR_INVALID_ID;
+        else if (processOwnsBlock(allocator, existing) || processWaiting(allocator, existing))
+            request->status = ALLOCATOR_ERR_EXISTS;
+        else if ((unsigned)strategy >= ALLOCATOR_STRATEGY_COUNT)
+            request->status = ALLOCATOR_ERR_INVALID_STRATEGY;
+        else if (request->size <= 0)
+            request->status = ALLOCATOR_ERR_INVALID_SIZE;
+        else if (!items || (handle = internProcess(allocator, request->processId)) < 0)
+            request->status = ALLOCATOR_ERR_NO_MEMORY;
+        else {
+            request->status = ALLOCATOR_OK;
+            items[pending].size = request->size;
+            items[pending].handle = handle;
+            items[pending].index = i;
+            pending++;
+        }
+    }
+    if (!items)
+        return 0; // Every valid request already failed with ALLOCATOR_ERR_NO_MEMORY
+
+    // Only the first occurrence of a process ID can be placed; later ones already "exist".
+    qsort(items, (size_t)pending, sizeof(BulkItem), compareBulkHandle);
+    int unique = 0;
+    for (int i = 0; i < pending; i++) {
+        if (unique > 0 && items[unique - 1].handle == items[i].handle)
+            requests[items[i].index].status = ALLOCATOR_ERR_EXISTS;
+        else
+            items[unique++] = items[i];
+    }
+    qsort(items, (size_t)unique, sizeof(BulkItem), compareBulkSize);
+
+    // With sizes ascending, every FREE block before the last First Fit placement is too small
+    // for the rest of the batch, so each scan resumes right after the previous placement.
+    AllocatorScanStats *scan = &allocator->scans[ALLOCATOR_FIRST_FIT];
+    Node *cursor = allocator->dummyHead->next;
+    int arrayCursor = 0;
+    AllocatorSize bitmapCursor = 0;
+    int placed = 0;
+    for (int i = 0; i < unique; i++) {
+        AllocatorRequest *request = &requests[items[i].index];
+        int handle = items[i].handle;
+        allocator->processes[handle].alignShift = 0;
+        if (!reserveBlocks(allocator)) {
+            request->status = ALLOCATOR_ERR_NO_MEMORY;
+            continue;
+        }
+        if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+            int leaf = buddyAllocate(&allocator->buddy, handle, request->size, 1);
+            if (leaf < 0) {
+                request->status = ALLOCATOR_ERR_NO_SPACE;
+                continue;
+            }
+            allocator->processes[handle].buddyLeaf = leaf;
+            describeBuddyBlock(allocator, leaf, &request->block);
+            placed++;
+            continue;
+        }
+        if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+            int index;
+            if (strategy == ALLOCATOR_FIRST_FIT) {
+                scan->requests++;
+                index = findArrayFirstFit(&allocator->array, arrayCursor, allocator->array.count, request->size, 1, scan);
+                if (index >= 0) {
+                    index = placeArrayProcess(allocator, index, handle, request->size, 1);
+                    arrayCursor = index + 1;
+                }
+            } else {
+                index = arrayAllocate(allocator, handle, request->size, 1, strategy);
+            }
+            if (index < 0) {
+                request->status = ALLOCATOR_ERR_NO_SPACE;
+                continue;
+            }
+            describeArrayBlock(allocator, index, &request->block);
+            placed++;
+            continue;
+        }
+        if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+            GranuleBitmap *bitmap = &allocator->bitmap;
+            int fits;
+            if (strategy == ALLOCATOR_FIRST_FIT) {
+                scan->requests++;
+                AllocatorSize granules = granulesFor(bitmap, request->size);
+                AllocatorSize start = findBitmapFirstFit(bitmap, bitmapCursor, bitmap->granuleCount, granules, 1, scan);
+                fits = start >= 0;
+                if (fits) {
+                    placeBitmapProcess(allocator, start, handle, request->size, 1);
+                    bitmapCursor = start + granules;
+                }
+            } else {
+                fits = bitmapAllocate(allocator, handle, request->size, 1, strategy);
+            }
+            if (!fits) {
+                request->status = ALLOCATOR_ERR_NO_SPACE;
+                continue;
+            }
+            describeBitmapBlock(allocator, allocator->processes[handle].bitmapStart, &request->block);
+            placed++;
+            continue;
+        }
+
+        Node *block;
+        if (strategy == ALLOCATOR_FIRST_FIT) {
+            scan->requests++;
+            for (; cursor; cursor = cursor->next) {
+                COUNT_VISITS(scan, 1);
+                if (cursor->state == BLOCK_FREE && blockFits(cursor, request->size, 1))
+                    break;
+            }
+            block = cursor;
+            if (block) {
+                placeProcess(allocator, block, handle, request->size, 1);
+                cursor = block->next;
+            }
+        } else {
+            block = listAllocate(allocator, handle, request->size, 1, strategy);
+        }
+        if (!block) {
+            request->status = ALLOCATOR_ERR_NO_SPACE;
+            continue;
+        }
+        describeListBlock(allocator, block, &request->block);
+        placed++;
+    }
+
+    // Items that found no room get the same compact-and-retry as allocator_allocate. Compaction
+    // moves the blocks placed above, so their descriptions are refreshed once it has run.
+    int compacted = 0;
+    for (int i = 0; i < unique; i++) {
+        AllocatorRequest *request = &requests[items[i].index];
+        if (request->status != ALLOCATOR_ERR_NO_SPACE || (!compacted && !compactForFailure(allocator, request->size)))
+            continue;
+        compacted = 1;
+        request->status = placeRequest(allocator, items[i].handle, request->size, 1, strategy, NULL);
+        if (request->status == ALLOCATOR_OK)
+            placed++;
+    }
+    for (int i = 0; compacted && i < unique; i++) {
+        AllocatorRequest *request = &requests[items[i].index];
+        if (request->status == ALLOCATOR_OK)
+            describeProcessBlock(allocator, items[i].handle, &request->block);
+    }
+    for (int i = 0; i < unique; i++)
+        retireProcess(allocator, items[i].handle); // Those whose request failed
+    free(items);
+    return placed;
+}
+
+/** Pulls the compaction frontier back to before when a FREE hole opens right after it inside
+ *  the packed prefix. A FREE before (alignment padding the hole will absorb) is skipped. */
+static void retreatCompactionFrontier(Allocator *allocator, Node *before) {
+    if (allocator->compactionFrontier == allocator->dummyHead ||
+        before->startAddress >= allocator->compactionFrontier->startAddress)
+        return;
+    allocator->compactionFrontier = before->state == BLOCK_FREE ? before->prev : before;
+}
+
+/** Turns an allocated list block FREE and coalesces it. Returns the surviving FREE block.
+ *  The bytes are left in place; callers discard pages once they no longer need them. */
+static Node *freeListBlock(Allocator *allocator, Node *block) {
+    retreatCompactionFrontier(allocator, block->prev);
+    allocator->dummyHead->availableSpace += block->availableSpace;
+    block->state = BLOCK_FREE;
+    block->owner = -1;
+    insertFreeIndex(allocator, block);
+    return coalesceFreeBlock(allocator, block);
+}
+
+/** Releases the buddy block at leaf, coalesces it and discards its whole free pages. */
+static void freeBuddyBlock(Allocator *allocator, int leaf) {
+    AllocatorSize releasedEnd = buddyLeafAddress(leaf) + ((AllocatorSize)1 << allocator->buddy.blockInfo[leaf]) - 1;
+    int merged = buddyRelease(&allocator->buddy, leaf);
+    AllocatorSize mergedSize = (AllocatorSize)1 << (allocator->buddy.blockInfo[merged] & ~BUDDY_FREE_BIT);
+    discardFreePages(allocator, buddyLeafAddress(merged), buddyLeafAddress(merged) + mergedSize - 1,
+                     buddyLeafAddress(leaf), releasedEnd);
+}
+
+/** Releases the block owned by handle, coalesces it and retires the handle. Returns 0 if
+ *  handle owns no block. */
+static int releaseHandle(Allocator *allocator, int handle) {
+    if (!processOwnsBlock(allocator, handle))
+        return 0;
+    ProcessEntry *entry = &allocator->processes[handle];
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        freeBuddyBlock(allocator, entry->buddyLeaf);
+        entry->buddyLeaf = -1;
+    } else if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+        releaseArrayBlock(allocator, arrayBlockContaining(&allocator->array, entry->arrayStart));
+        entry->arrayStart = -1;
+    } else if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        releaseBitmapBlock(allocator, handle);
+    } else {
+        Node *block = entry->block;
+        entry->block = NULL;
+        AllocatorSize releasedStart = block->startAddress, releasedEnd = block->endAddress;
+        block = freeListBlock(allocator, block);
+        discardFreePages(allocator, block->startAddress, block->endAddress, releasedStart, releasedEnd);
+    }
+    retireProcess(allocator, handle);
+    return 1;
+}
+
+/** Gives the last bytes of an allocated list block back as FREE space, merged into a FREE successor. */
+static void shrinkListBlock(Allocator *allocator, Node *block, AllocatorSize bytes) {
+    retreatCompactionFrontier(allocator, block);
+    block->availableSpace -= bytes;
+    block->endAddress -= bytes;
+    allocator->dummyHead->availableSpace += bytes;
+    Node *freed = block->next;
+    if (freed && freed->state == BLOCK_FREE) {
+        removeFreeIndex(allocator, freed);
+        freed->startAddress -= bytes;
+        freed->availableSpace += bytes;
+        insertFreeIndex(allocator, freed);
+    } else {
+        createFreeBlock(allocator, block, bytes);
+        freed = block->next;
+    }
+    discardFreePages(allocator, freed->startAddress, freed->endAddress, block->endAddress + 1, block->endAddress + bytes);
+}
+
+/** Grows an allocated list block by bytes taken from the head of its FREE successor. */
+static void growListBlock(Allocator *allocator, Node *block, AllocatorSize bytes) {
+    Node *next = block->next;
+    removeFreeIndex(allocator, next);
+    if (next->availableSpace == bytes) {
+        block->next = next->next;
+        if (block->next)
+            block->next->prev = block;
+        if (allocator->nextFitCursor == next)
+            allocator->nextFitCursor = block->next;
+        releaseNode(allocator, next);
+    } else {
+        next->startAddress += bytes;
+        next->availableSpace -= bytes;
+        insertFreeIndex(allocator, next);
+    }
+    block->availableSpace += bytes;
+    block->endAddress += bytes;
+    allocator->dummyHead->availableSpace -= bytes;
+}
+
+/** Moves the list block owned by handle to a newSize-byte block: first anywhere the strategy
+ *  finds room, else over the space it would free together with its FREE neighbours.
+ *  Returns the new block, or NULL (with nothing changed) if neither fits. */
+static Node *moveListBlock(Allocator *allocator, int handle, AllocatorSize newSize, AllocatorStrategy strategy) {
+    Node *old = allocator->processes[handle].block;
+    AllocatorSize alignment = processAlignment(allocator, handle);
+    AllocatorSize oldStart = old->startAddress, oldEnd = old->endAddress;
+    Node *placed = listAllocate(allocator, handle, newSize, alignment, strategy);
+    if (placed) {
+        if (allocator->backing)
+            memcpy(allocator->backing + placed->startAddress, allocator->backing + oldStart, (size_t)old->availableSpace);
+        Node *freed = freeListBlock(allocator, old);
+        discardFreePages(allocator, freed->startAddress, freed->endAddress, oldStart, oldEnd);
+        return placed;
+    }
+
+    AllocatorSize regionStart = old->prev->state == BLOCK_FREE ? old->prev->startAddress : oldStart;
+    AllocatorSize regionEnd = old->next && old->next->state == BLOCK_FREE ? old->next->endAddress : oldEnd;
+    AllocatorSize padding = alignmentPadding(regionStart, alignment);
+    if (regionEnd - regionStart + 1 < newSize + padding)
+        return NULL;
+    AllocatorSize oldSize = old->availableSpace;
+    Node *region = freeListBlock(allocator, old);
+    placeProcess(allocator, region, handle, newSize, alignment);
+    if (allocator->backing)
+        memmove(allocator->backing + region->startAddress, allocator->backing + oldStart, (size_t)oldSize);
+    if (region->next && region->next->state == BLOCK_FREE)
+        discardFreePages(allocator, region->next->startAddress, region->next->endAddress, oldStart, oldEnd);
+    return region;
+}
+
+/** Resizes the array block owned by handle the way allocator_resize resizes a list block:
+ *  in place when it shrinks or its FREE successor is large enough, else by moving it.
+ *  Returns the block's index, or -1 (with nothing changed) if it has nowhere to go. */
+static int resizeArrayBlock(Allocator *allocator, int handle, AllocatorSize newSize, AllocatorStrategy strategy) {
+    BlockArray *array = &allocator->array;
+    ProcessEntry *entry = &allocator->processes[handle];
+    AllocatorSize alignment = processAlignment(allocator, handle);
+    int index = arrayBlockContaining(array, entry->arrayStart);
+    int slot = arraySlot(array, index);
+    AllocatorSize start = array->starts[slot], size = array->sizes[slot], end = start + size - 1;
+    int nextFree = index + 1 < array->count && array->owners[arraySlot(array, index + 1)] < 0;
+    AllocatorSize nextSize = nextFree ? array->sizes[arraySlot(array, index + 1)] : 0;
+
+    if (newSize < size) { // The tail becomes FREE, merged into a FREE successor
+        writeArrayBlock(allocator, index, start, newSize, handle);
+        if (nextFree) {
+            writeArrayBlock(allocator, index + 1, start + newSize, nextSize + size - newSize, -1);
+        } else {
+            insertArrayBlock(allocator, index + 1, start + newSize, size - newSize, -1);
+            allocator->splits++;
+        }
+        if (start + newSize < array->compactedBelow)
+            array->compactedBelow = start + newSize;
+        int freed = arraySlot(array, index + 1);
+        discardFreePages(allocator, array->starts[freed], array->starts[freed] + array->sizes[freed] - 1, start + newSize,
+                         end);
+        allocator->resizesInPlace++;
+        return index;
+    }
+    if (newSize == size || nextSize >= newSize - size) { // Take the head of the FREE successor
+        if (newSize > size && nextSize == newSize - size)
+            removeArrayBlock(allocator, index + 1);
+        else if (newSize > size)
+            writeArrayBlock(allocator, index + 1, start + newSize, nextSize - (newSize - size), -1);
+        writeArrayBlock(allocator, index, start, newSize, handle);
+        allocator->resizesInPlace++;
+        return index;
+    }
+
+    if (arrayAllocate(allocator, handle, newSize, alignment, strategy) >= 0) {
+        AllocatorSize newStart = entry->arrayStart;
+        if (allocator->backing)
+            memcpy(allocator->backing + newStart, allocator->backing + start, (size_t)size);
+        releaseArrayBlock(allocator, arrayBlockContaining(array, start));
+        allocator->resizesMoved++;
+        return arrayBlockContaining(array, newStart);
+    }
+    AllocatorSize regionStart = index > 0 && array->owners[arraySlot(array, index - 1)] < 0
+                                ? array->starts[arraySlot(array, index - 1)] : start;
+    AllocatorSize regionEnd = end + nextSize;
+    if (regionEnd - regionStart + 1 < newSize + alignmentPadding(regionStart, alignment))
+        return -1;
+    index = placeArrayProcess(allocator, freeArrayBlock(allocator, index), handle, newSize, alignment);
+    if (allocator->backing)
+        memmove(allocator->backing + entry->arrayStart, allocator->backing + start, (size_t)size);
+    if (index + 1 < array->count && array->owners[arraySlot(array, index + 1)] < 0) {
+        int freed = arraySlot(array, index + 1);
+        discardFreePages(allocator, array->starts[freed], array->starts[freed] + array->sizes[freed] - 1, start, end);
+    }
+    allocator->resizesMoved++;
+    return index;
+}
+
+/** Resizes the block owned by handle with the engine's resize; see allocator_resize. */
+static AllocatorStatus resizeOwnedBlock(Allocator *allocator, int handle, AllocatorSize newSize,
+                                        AllocatorStrategy strategy, AllocatorBlock *block) {
+    if (!reserveBlocks(allocator))
+        return ALLOCATOR_ERR_NO_MEMORY;
+    ProcessEntry *entry = &allocator->processes[handle];
+    AllocatorSize alignment = processAlignment(allocator, handle);
+
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        BuddyHeap *buddy = &allocator->buddy;
+        int leaf = entry->buddyLeaf;
+        if (buddyResizeInPlace(buddy, leaf, newSize, alignment)) {
+            allocator->resizesInPlace++;
+        } else {
+            int moved = buddyAllocate(buddy, handle, newSize, alignment);
+            if (moved < 0)
+                return ALLOCATOR_ERR_NO_SPACE;
+            if (allocator->backing)
+                memcpy(allocator->backing + buddyLeafAddress(moved), allocator->backing + buddyLeafAddress(leaf),
+                       (size_t)buddy->requested[leaf]);
+            freeBuddyBlock(allocator, leaf);
+            entry->buddyLeaf = leaf = moved;
+            allocator->resizesMoved++;
+        }
+        if (block)
+            describeBuddyBlock(allocator, leaf, block);
+        return ALLOCATOR_OK;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+        int index = resizeArrayBlock(allocator, handle, newSize, strategy);
+        if (index < 0)
+            return ALLOCATOR_ERR_NO_SPACE;
+        if (block)
+            describeArrayBlock(allocator, index, block);
+        return ALLOCATOR_OK;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        if (!resizeBitmapBlock(allocator, handle, newSize, strategy))
+            return ALLOCATOR_ERR_NO_SPACE;
+        if (block)
+            describeBitmapBlock(allocator, entry->bitmapStart, block);
+        return ALLOCATOR_OK;
+    }
+
+    Node *resized = entry->block;
+    AllocatorSize growth = newSize - resized->availableSpace;
+    if (growth < 0) {
+        shrinkListBlock(allocator, resized, -growth);
+        allocator->resizesInPlace++;
+    } else if (growth == 0 || (resized->next && resized->next->state == BLOCK_FREE &&
+                               resized->next->availableSpace >= growth)) {
+        if (growth > 0)
+            growListBlock(allocator, resized, growth);
+        allocator->resizesInPlace++;
+    } else {
+        resized = moveListBlock(allocator, handle, newSize, strategy);
+        if (!resized)
+            return ALLOCATOR_ERR_NO_SPACE;
+        allocator->resizesMoved++;
+    }
+    if (block)
+        describeListBlock(allocator, resized, block);
+    return ALLOCATOR_OK;
+}
+
+AllocatorStatus allocator_resize(Allocator *allocator, const char *processId, AllocatorSize newSize,
+                                 AllocatorStrategy strategy, AllocatorBlock *block) {
+    allocator_drain_releases(allocator);
+    if (!validProcessId(processId))
+        return ALLOCATOR_ERR_INVALID_ID;
+    int handle = lookupProcess(allocator, processId);
+    if (!processOwnsBlock(allocator, handle))
+        return ALLOCATOR_ERR_NOT_FOUND;
+    if ((unsigned)strategy >= ALLOCATOR_STRATEGY_COUNT)
+        return ALLOCATOR_ERR_INVALID_STRATEGY;
+    if (newSize <= 0)
+        return ALLOCATOR_ERR_INVALID_SIZE;
+    maintainHeap(allocator);
+    AllocatorBlock before, after;
+    describeProcessBlock(allocator, handle, &before);
+    AllocatorStatus status = resizeOwnedBlock(allocator, handle, newSize, strategy, &after);
+    if (status != ALLOCATOR_OK)
+        return status;
+    if (after.size < before.size || after.startAddress != before.startAddress)
+        spaceFreed(allocator); // Shrinking or moving the block frees space; growing in place does not
+    if (block)
+        *block = after;
+    return status;
+}
+
+AllocatorStatus allocator_enable_deferred_release(Allocator *allocator, int capacity) {
+    DeferredQueue *queue = &allocator->deferred;
+    if (queue->slots)
+        return ALLOCATOR_OK;
+    size_t slotCount = DEFERRED_QUEUE_MIN_CAPACITY;
+    while ((int)slotCount < capacity && slotCount < ((size_t)1 << 30))
+        slotCount *= 2;
+    DeferredSlot *slots = (DeferredSlot *)malloc(slotCount * sizeof(DeferredSlot));
+    if (!slots)
+        return ALLOCATOR_ERR_NO_MEMORY;
+    for (size_t i = 0; i < slotCount; i++)
+        atomic_init(&slots[i].sequence, i);
+    atomic_init(&queue->enqueuePosition, 0);
+    queue->dequeuePosition = 0;
+    queue->mask = slotCount - 1;
+    queue->slots = slots;
+    return ALLOCATOR_OK;
+}
+
+AllocatorStatus allocator_release_deferred(Allocator *allocator, AllocatorHandle handle) {
+    DeferredQueue *queue = &allocator->deferred;
+    if (!queue->slots)
+        return ALLOCATOR_ERR_QUEUE_FULL;
+    size_t position = atomic_load_explicit(&queue->enqueuePosition, memory_order_relaxed);
+    for (;;) {
+        DeferredSlot *slot = &queue->slots[position & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        ptrdiff_t lag = (ptrdiff_t)(sequence - position);
+        if (lag == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->handle = handle;
+                atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+                return ALLOCATOR_OK;
+            }
+        } else if (lag < 0) {
+            return ALLOCATOR_ERR_QUEUE_FULL; // The consumer has not freed this slot yet
+        } else {
+            position = atomic_load_explicit(&queue->enqueuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+int allocator_drain_releases(Allocator *allocator) {
+    DeferredQueue *queue = &allocator->deferred;
+    if (!queue->slots)
+        return 0;
+    int drained = 0;
+    long long applied = queue->applied;
+    for (;;) {
+        DeferredSlot *slot = &queue->slots[queue->dequeuePosition & queue->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence != queue->dequeuePosition + 1)
+            break; // Empty, or the next producer has claimed the slot but not filled it yet
+        int handle = handleFromPublic(allocator, slot->handle);
+        atomic_store_explicit(&slot->sequence, queue->dequeuePosition + queue->mask + 1, memory_order_release);
+        queue->dequeuePosition++;
+        if (releaseHandle(allocator, handle))
+            queue->applied++;
+        else
+            queue->misses++;
+        drained++;
+    }
+    if (queue->applied > applied)
+        spaceFreed(allocator);
+    return drained;
+}
+
+AllocatorStatus allocator_release(Allocator *allocator, const char *processId) {
+    allocator_drain_releases(allocator);
+    if (!validProcessId(processId))
+        return ALLOCATOR_ERR_INVALID_ID;
+    if (!releaseHandle(allocator, lookupProcess(allocator, processId)))
+        return ALLOCATOR_ERR_NOT_FOUND;
+    spaceFreed(allocator);
+    maintainHeap(allocator);
+    return ALLOCATOR_OK;
+}
+
+/** Orders released nodes by address. */
+static int compareNodeAddress(const void *a, const void *b) {
+    const Node *x = *(Node *const *)a, *y = *(Node *const *)b;
+    return x->startAddress < y->startAddress ? -1 : x->startAddress > y->startAddress;
+}
+
+int allocator_release_many(Allocator *allocator, const char *const *processIds, int count, AllocatorStatus *statuses) {
+    allocator_drain_releases(allocator);
+    Node **freed = NULL;
+    if (allocator->engine == ALLOCATOR_ENGINE_LIST && count > 0)
+        freed = (Node **)malloc((size_t)count * sizeof(Node *));
+    int released = 0;
+    for (int i = 0; i < count; i++) {
+        int valid = validProcessId(processIds[i]);
+        int handle = valid ? lookupProcess(allocator, processIds[i]) : -1;
+        int owned = processOwnsBlock(allocator, handle);
+        if (owned && allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+            // Mark it now; coalesceArrayReleases merges every freed block in one pass.
+            BlockArray *array = &allocator->array;
+            array->owners[arraySlot(array, arrayBlockContaining(array, allocator->processes[handle].arrayStart))] =
+                ARRAY_RELEASED;
+            allocator->processes[handle].arrayStart = -1;
+            retireProcess(allocator, handle);
+        } else if (owned && freed) {
+            // Mark it FREE now; the merge pass below coalesces and indexes it.
+            Node *block = allocator->processes[handle].block;
+            allocator->processes[handle].block = NULL;
+            retireProcess(allocator, handle);
+            allocator->dummyHead->availableSpace += block->availableSpace;
+            block->state = BLOCK_FREE;
+            block->owner = -1;
+            freed[released] = block;
+        } else if (owned) {
+            releaseHandle(allocator, handle); // Buddy or bitmap engine, or no room for the merge pass
+        }
+        released += owned;
+        if (statuses)
+            statuses[i] = owned ? ALLOCATOR_OK : valid ? ALLOCATOR_ERR_NOT_FOUND : ALLOCATOR_ERR_INVALID_ID;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY && released > 0)
+        coalesceArrayReleases(allocator);
+    if (!freed) {
+        if (released > 0)
+            spaceFreed(allocator);
+        maintainHeap(allocator);
+        return released;
+    }
+
+    // Each run of adjacent FREE blocks holding freed nodes collapses into its first block.
+    qsort(freed, (size_t)released, sizeof(Node *), compareNodeAddress);
+    for (int i = 0; i < released;) {
+        Node *head = freed[i];
+        AllocatorSize releasedStart = head->startAddress;
+        int following = i + 1; // Next freed node the run may reach
+        retreatCompactionFrontier(allocator, head->prev);
+        if (head->prev->state == BLOCK_FREE) {
+            head = head->prev;
+            removeFreeIndex(allocator, head);
+            following = i;
+        }
+        AllocatorSize releasedEnd = freed[i]->endAddress;
+        while (head->next && head->next->state == BLOCK_FREE) {
+            Node *absorbed = head->next;
+            if (following < released && absorbed == freed[following])
+                releasedEnd = freed[following++]->endAddress;
+            else
+                removeFreeIndex(allocator, absorbed);
+            head->endAddress = absorbed->endAddress;
+            head->availableSpace += absorbed->availableSpace;
+            head->next = absorbed->next;
+            if (head->next)
+                head->next->prev = head;
+            if (allocator->nextFitCursor == absorbed)
+                allocator->nextFitCursor = head;
+            releaseNode(allocator, absorbed);
+            allocator->merges++;
+        }
+        insertFreeIndex(allocator, head);
+        discardFreePages(allocator, head->startAddress, head->endAddress, releasedStart, releasedEnd);
+        i = following;
+    }
+    free(freed);
+    if (released > 0)
+        spaceFreed(allocator);
+    maintainHeap(allocator);
+    return released;
+}
+
+void allocator_compact(Allocator *allocator) {
+    allocator_compact_step(allocator, 0, 0);
+}
+
+int allocator_compact_step(Allocator *allocator, int maxBlocks, AllocatorSize maxBytes) {
+    allocator_drain_releases(allocator);
+    // Buddy blocks coalesce on release, so there is nothing left to compact.
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY)
+        return 1;
+    int compacted;
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY)
+        compacted = slideArrayBlocks(allocator, maxBlocks, maxBytes);
+    else if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        compacted = slideBitmapBlocks(allocator, maxBlocks, maxBytes);
+    else
+        compacted = slideAllocatedBlocks(allocator, maxBlocks, maxBytes);
+    if (compacted) {
+        allocator->policyCompacting = 0; // Nothing left for the policy until space is freed
+        allocator->policySettled = 1;
+    }
+    wakeWaiters(allocator); // Sliding merges free space into larger blocks
+    return compacted;
+}
+
+void allocator_set_compaction_policy(Allocator *allocator, const AllocatorCompactionPolicy *policy) {
+    memset(&allocator->compaction, 0, sizeof(allocator->compaction));
+    if (policy)
+        allocator->compaction = *policy;
+    allocator->policyCalls = 0;
+    allocator->policyCompacting = 0;
+}
+
+int allocator_idle(Allocator *allocator) {
+    allocator_drain_releases(allocator);
+    return runPolicyStep(allocator) && allocator->policyCompacting;
+}
+
+void allocator_set_relocation_visitor(Allocator *allocator, AllocatorRelocationVisitor visitor, void *context) {
+    allocator->relocationVisitor = visitor;
+    allocator->relocationContext = context;
+}
+
+void allocator_stats(Allocator *allocator, AllocatorStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->engine = allocator->engine;
+    stats->totalSize = allocator->lastAddressSpace + 1;
+    memcpy(stats->scans, allocator->scans, sizeof(stats->scans));
+    stats->deferredReleases = allocator->deferred.applied;
+    stats->deferredMisses = allocator->deferred.misses;
+    stats->blocksMoved = allocator->blocksMoved;
+    stats->bytesMoved = allocator->bytesMoved;
+    stats->resizesInPlace = allocator->resizesInPlace;
+    stats->resizesMoved = allocator->resizesMoved;
+    stats->bytesCopied = allocator->bytesCopied;
+    stats->bytesRemapped = allocator->bytesRemapped;
+    stats->bytesDiscarded = allocator->bytesDiscarded;
+    stats->nodeAllocations = allocator->nodeAllocations;
+    stats->nodeReleases = allocator->nodeReleases;
+    stats->slabAllocations = allocator->slabAllocations;
+    stats->waitingRequests = allocator->waits.count;
+    stats->parkedRequests = allocator->waits.parked;
+    stats->wokenRequests = allocator->waits.woken;
+    stats->cancelledRequests = allocator->waits.cancelled;
+    stats->policySteps = allocator->policySteps;
+    stats->failureCompactions = allocator->failureCompactions;
+    stats->largestFreeBlock = largestFreeBlock(allocator);
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        const BuddyHeap *buddy = &allocator->buddy;
+        stats->freeBytes = buddy->freeBytes;
+        stats->blockCount = buddy->blockCount;
+        stats->peakBlockCount = buddy->peakBlockCount;
+        stats->splits = buddy->splits;
+        stats->merges = buddy->merges;
+        stats->freeBlockCount = buddy->freeBlockCount;
+        stats->allocatedBlockCount = buddy->blockCount - buddy->freeBlockCount;
+        memcpy(stats->freeSizeHistogram, buddy->freeCounts, sizeof(buddy->freeCounts));
+        stats->internalFragmentation = buddy->internalFragmentation;
+        stats->unusableBytes = buddy->unusableBytes;
+        return;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+        const BlockArray *array = &allocator->array;
+        stats->freeBytes = array->freeBytes;
+        stats->blockCount = array->count;
+        stats->peakBlockCount = array->peakCount;
+    } else if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        const GranuleBitmap *bitmap = &allocator->bitmap;
+        stats->freeBytes = granuleAddress(bitmap, bitmap->freeGranules);
+        stats->blockCount = bitmap->ownerCount + allocator->freeBlockCount;
+        stats->peakBlockCount = bitmap->peakBlockCount;
+        stats->internalFragmentation = bitmap->internalFragmentation;
+        stats->unusableBytes = stats->totalSize - granuleAddress(bitmap, bitmap->granuleCount);
+        stats->granuleSize = granuleAddress(bitmap, 1);
+    } else {
+        stats->freeBytes = allocator->dummyHead->availableSpace;
+        stats->blockCount = allocator->nodeCount - 1;         // Exclude dummyHead
+        stats->peakBlockCount = allocator->peakNodeCount - 1;
+    }
+    stats->splits = allocator->splits;
+    stats->merges = allocator->merges;
+    stats->freeBlockCount = allocator->freeBlockCount;
+    stats->allocatedBlockCount = stats->blockCount - allocator->freeBlockCount;
+    memcpy(stats->freeSizeHistogram, allocator->sizeClassCounts, sizeof(allocator->sizeClassCounts));
+}
+
+void allocator_for_each_block(const Allocator *allocator, AllocatorBlockVisitor visitor, void *context) {
+    AllocatorBlock block;
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        const BuddyHeap *buddy = &allocator->buddy;
+        for (int leaf = 0; leaf < buddy->leafCount;) {
+            describeBuddyBlock(allocator, leaf, &block);
+            visitor(&block, context);
+            leaf += 1 << ((buddy->blockInfo[leaf] & ~BUDDY_FREE_BIT) - BUDDY_MIN_ORDER);
+        }
+        return;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+        for (int index = 0; index < allocator->array.count; index++) {
+            describeArrayBlock(allocator, index, &block);
+            visitor(&block, context);
+        }
+        return;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        for (AllocatorSize first = 0; first < allocator->bitmap.granuleCount;) {
+            first = describeBitmapBlock(allocator, first, &block);
+            visitor(&block, context);
+        }
+        return;
+    }
+    for (const Node *node = allocator->dummyHead->next; node; node = node->next) {
+        describeListBlock(allocator, node, &block);
+        visitor(&block, context);
+    }
+}
+
+AllocatorSize allocator_walk_blocks(const Allocator *allocator, AllocatorSize fromAddress, AllocatorBlockWalker walker,
+                                    void *context) {
+    AllocatorBlock block;
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY) {
+        const BuddyHeap *buddy = &allocator->buddy;
+        int leaf = buddyBlockContaining(buddy, fromAddress > 0 ? fromAddress : 0);
+        if (leaf < 0)
+            return -1;
+        while (leaf < buddy->leafCount) {
+            describeBuddyBlock(allocator, leaf, &block);
+            leaf += 1 << ((buddy->blockInfo[leaf] & ~BUDDY_FREE_BIT) - BUDDY_MIN_ORDER);
+            if (!walker(&block, context))
+                return leaf < buddy->leafCount ? buddyLeafAddress(leaf) : -1;
+        }
+        return -1;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_ARRAY) {
+        const BlockArray *array = &allocator->array;
+        int index = arrayBlockContaining(array, fromAddress > 0 ? fromAddress : 0);
+        if (index < 0)
+            return -1;
+        for (; index < array->count; index++) {
+            describeArrayBlock(allocator, index, &block);
+            if (!walker(&block, context))
+                return index + 1 < array->count ? array->starts[arraySlot(array, index + 1)] : -1;
+        }
+        return -1;
+    }
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP) {
+        const GranuleBitmap *bitmap = &allocator->bitmap;
+        AllocatorSize first = bitmapBlockContaining(bitmap, fromAddress > 0 ? fromAddress : 0);
+        if (first < 0)
+            return -1;
+        while (first < bitmap->granuleCount) {
+            first = describeBitmapBlock(allocator, first, &block);
+            if (!walker(&block, context))
+                return first < bitmap->granuleCount ? granuleAddress(bitmap, first) : -1;
+        }
+        return -1;
+    }
+    // The packed compaction prefix is a safe place to start skipping from.
+    const Node *node = allocator->dummyHead->next;
+    if (allocator->compactionFrontier != allocator->dummyHead && allocator->compactionFrontier->startAddress <= fromAddress)
+        node = allocator->compactionFrontier;
+    while (node && node->endAddress < fromAddress)
+        node = node->next;
+    for (; node; node = node->next) {
+        describeListBlock(allocator, node, &block);
+        if (!walker(&block, context))
+            return node->next ? node->next->startAddress : -1;
+    }
+    return -1;
+}
+
+/** Counts the visited blocks for allocator_snapshot_size. */
+static void countBlock(const AllocatorBlock *block, void *context) {
+    (void)block;
+    (*(size_t *)context)++;
+}
+
+size_t allocator_snapshot_size(const Allocator *allocator) {
+    size_t blocks = 0;
+    if (allocator->engine == ALLOCATOR_ENGINE_BUDDY)
+        allocator_for_each_block(allocator, countBlock, &blocks);
+    else if (allocator->engine == ALLOCATOR_ENGINE_ARRAY)
+        blocks = (size_t)allocator->array.count;
+    else if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        blocks = (size_t)(allocator->bitmap.ownerCount + allocator->freeBlockCount);
+    else
+        blocks = (size_t)allocator->nodeCount - 1; // Exclude dummyHead
+    return sizeof(SnapshotHeader) + blocks * sizeof(SnapshotBlock);
+}
+
+/** Write position of allocator_snapshot. */
+typedef struct SnapshotWriter {
+    const Allocator *allocator;
+    unsigned char *cursor;
+} SnapshotWriter;
+
+/** Appends one block record for allocator_snapshot. */
+static void writeSnapshotBlock(const AllocatorBlock *block, void *context) {
+    SnapshotWriter *writer = (SnapshotWriter *)context;
+    SnapshotBlock record;
+    memset(&record, 0, sizeof(record));
+    record.startAddress = block->startAddress;
+    record.size = block->size;
+    record.requested = block->requested;
+    record.isFree = (uint8_t)block->isFree;
+    if (!block->isFree) {
+        record.alignShift = writer->allocator->processes[handleFromPublic(writer->allocator, block->handle)].alignShift;
+        memcpy(record.processId, block->owner, strlen(block->owner) + 1);
+    }
+    memcpy(writer->cursor, &record, sizeof(record));
+    writer->cursor += sizeof(record);
+}
+
+/** Returns the checksum of a snapshot: FNV-1a over its bytes, reading the header's checksum
+ *  field as zero. */
+static uint64_t snapshotChecksum(const void *snapshot, size_t length) {
+    SnapshotHeader header;
+    memcpy(&header, snapshot, sizeof(header));
+    header.checksum = 0;
+    uint64_t hash = 14695981039346656037u;
+    const unsigned char *bytes = (const unsigned char *)&header;
+    for (size_t i = 0; i < length; i++) {
+        if (i == sizeof(header))
+            bytes = (const unsigned char *)snapshot;
+        hash ^= bytes[i];
+        hash *= 1099511628211u;
+    }
+    return hash;
+}
+
+void allocator_snapshot(const Allocator *allocator, void *buffer) {
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.engine = (uint32_t)allocator->engine;
+    header.totalSize = allocator->lastAddressSpace + 1;
+    if (allocator->engine == ALLOCATOR_ENGINE_BITMAP)
+        header.granuleShift = (uint32_t)allocator->bitmap.granuleShift;
+    header.blockCount = (int64_t)((allocator_snapshot_size(allocator) - sizeof(header)) / sizeof(SnapshotBlock));
+    memcpy(buffer, &header, sizeof(header));
+    SnapshotWriter writer = {allocator, (unsigned char *)buffer + sizeof(header)};
+    allocator_for_each_block(allocator, writeSnapshotBlock, &writer);
+    header.checksum = snapshotChecksum(buffer, (size_t)(writer.cursor - (unsigned char *)buffer));
+    memcpy(buffer, &header, sizeof(header));
+}
+
+/** Interns the owner of an allocated snapshot record. Returns its handle, or -1 if the ID is
+ *  empty, unterminated or already owns a block, the block breaks its alignment, or host
+ *  memory ran out. */
+static int restoreOwner(Allocator *allocator, const SnapshotBlock *record) {
+    if (!record->processId[0] || !memchr(record->processId, '\0', PROCESS_ID_SIZE) || record->alignShift > 62 ||
+        alignmentPadding(record->startAddress, (AllocatorSize)1 << record->alignShift) != 0 ||
+        processOwnsBlock(allocator, lookupProcess(allocator, record->processId)))
+        return -1;
+    int handle = internProcess(allocator, record->processId);
+    if (handle >= 0)
+        allocator->processes[handle].alignShift = record->alignShift;
+    return handle;
+}
+
+/** Replaces a fresh list heap's single FREE block with the snapshot's blocks. Returns 0 if a
+ *  record is out of place, overlaps, leaves a gap, or sits FREE next to another FREE block. */
+static int restoreListBlocks(Allocator *allocator, const unsigned char *records, int64_t count) {
+    Node *initial = allocator->dummyHead->next;
+    removeFreeIndex(allocator, initial);
+    releaseNode(allocator, initial);
+    allocator->dummyHead->next = NULL;
+    allocator->dummyHead->availableSpace = 0;
+    Node *last = allocator->dummyHead;
+    for (int64_t i = 0; i < count; i++) {
+        SnapshotBlock record;
+        memcpy(&record, records + i * sizeof(SnapshotBlock), sizeof(record));
+        if (record.startAddress != last->endAddress + 1 || record.size <= 0 ||
+            record.size > allocator->lastAddressSpace - last->endAddress ||
+            (record.isFree && last->state == BLOCK_FREE) || !reserveNode(allocator))
+            return 0;
+        Node *node = allocateNode(allocator);
+        node->startAddress = record.startAddress;
+        node->availableSpace = record.size;
+        node->endAddress = record.startAddress + record.size - 1;
+        node->prev = last;
+        node->next = NULL;
+        last->next = node;
+        last = node;
+        if (record.isFree) {
+            node->state = BLOCK_FREE;
+            node->owner = -1;
+            allocator->dummyHead->availableSpace += record.size;
+            insertFreeIndex(allocator, node);
+            continue;
+        }
+        node->state = BLOCK_ALLOCATED;
+        node->owner = restoreOwner(allocator, &record);
+        if (node->owner < 0)
+            return 0;
+        allocator->processes[node->owner].block = node;
+    }
+    allocator->peakNodeCount = allocator->nodeCount;
+    return last->endAddress == allocator->lastAddressSpace;
+}
+
+/** Replaces a fresh array heap's single FREE block with the snapshot's blocks, appending each
+ *  at the end of the arrays. Returns 0 under the same conditions as restoreListBlocks. */
+static int restoreArrayBlocks(Allocator *allocator, const unsigned char *records, int64_t count) {
+    BlockArray *array = &allocator->array;
+    removeArrayBlock(allocator, 0);
+    AllocatorSize nextStart = 0;
+    int lastFree = 0;
+    for (int64_t i = 0; i < count; i++) {
+        SnapshotBlock record;
+        memcpy(&record, records + i * sizeof(SnapshotBlock), sizeof(record));
+        if (record.startAddress != nextStart || record.size <= 0 ||
+            record.size > allocator->lastAddressSpace + 1 - nextStart || (record.isFree && lastFree) ||
+            !reserveArraySlots(array))
+            return 0;
+        int owner = record.isFree ? -1 : restoreOwner(allocator, &record);
+        if (!record.isFree && owner < 0)
+            return 0;
+        insertArrayBlock(allocator, array->count, record.startAddress, record.size, owner);
+        if (owner >= 0)
+            allocator->processes[owner].arrayStart = record.startAddress;
+        nextStart += record.size;
+        lastFree = record.isFree;
+    }
+    array->peakCount = array->count;
+    return nextStart == allocator->lastAddressSpace + 1;
+}
+
+/** Replaces a fresh buddy heap's free blocks with the snapshot's blocks. Returns 0 if a record
+ *  is not a properly aligned buddy block in sequence, or a FREE block's lower buddy is FREE
+ *  at the same order (it would have coalesced). */
+static int restoreBuddyBlocks(Allocator *allocator, const unsigned char *records, int64_t count) {
+    BuddyHeap *buddy = &allocator->buddy;
+    memset(buddy->blockInfo, 0, (size_t)buddy->leafCount);
+    for (int order = 0; order < BUDDY_MAX_ORDER; order++) {
+        buddy->freeHeads[order] = -1;
+        buddy->freeCounts[order] = 0;
+    }
+    buddy->freeBlockCount = buddy->blockCount = 0;
+    buddy->freeBytes = 0;
+    AllocatorSize nextStart = 0;
+    for (int64_t i = 0; i < count; i++) {
+        SnapshotBlock record;
+        memcpy(&record, records + i * sizeof(SnapshotBlock), sizeof(record));
+        int order = BUDDY_MIN_ORDER;
+        while (order < BUDDY_MAX_ORDER && ((AllocatorSize)1 << order) < record.size)
+            order++;
+        if (record.startAddress != nextStart || order == BUDDY_MAX_ORDER || ((AllocatorSize)1 << order) != record.size ||
+            (record.startAddress & (record.size - 1)) != 0 ||
+            record.size > buddyLeafAddress(buddy->leafCount) - record.startAddress)
+            return 0;
+        int leaf = (int)(record.startAddress >> BUDDY_MIN_ORDER);
+        int lowerBuddy = leaf ^ (1 << (order - BUDDY_MIN_ORDER));
+        nextStart += record.size;
+        buddy->blockCount++;
+        if (record.isFree) {
+            if (lowerBuddy < leaf && buddy->blockInfo[lowerBuddy] == (BUDDY_FREE_BIT | order))
+                return 0;
+            buddyPushFree(buddy, leaf, order);
+            buddy->freeBytes += record.size;
+            continue;
+        }
+        int handle = restoreOwner(allocator, &record);
+        if (handle < 0 || record.requested <= 0 || record.requested > record.size)
+            return 0;
+        buddy->blockInfo[leaf] = (unsigned char)order;
+        buddy->owner[leaf] = handle;
+        buddy->requested[leaf] = record.requested;
+        buddy->internalFragmentation += record.size - record.requested;
+        allocator->processes[handle].buddyLeaf = leaf;
+    }
+    buddy->peakBlockCount = buddy->blockCount;
+    return nextStart == buddyLeafAddress(buddy->leafCount);
+}
+
+/** Replaces a fresh bitmap heap's single FREE run with the snapshot's blocks. Returns 0 under
+ *  the same conditions as restoreListBlocks, or if a block is not a whole number of granules
+ *  or its requested bytes would round to a different one. */
+static int restoreBitmapBlocks(Allocator *allocator, const unsigned char *records, int64_t count) {
+    GranuleBitmap *bitmap = &allocator->bitmap;
+    AllocatorSize granule = granuleAddress(bitmap, 1), heapEnd = granuleAddress(bitmap, bitmap->granuleCount);
+    countBitmapFree(allocator, bitmap->granuleCount, -1);
+    AllocatorSize nextStart = 0;
+    int lastFree = 0;
+    for (int64_t i = 0; i < count; i++) {
+        SnapshotBlock record;
+        memcpy(&record, records + i * sizeof(SnapshotBlock), sizeof(record));
+        if (record.startAddress != nextStart || record.size <= 0 || (record.size & (granule - 1)) != 0 ||
+            record.size > heapEnd - nextStart || (record.isFree && lastFree))
+            return 0;
+        AllocatorSize first = record.startAddress >> bitmap->granuleShift;
+        nextStart += record.size;
+        lastFree = record.isFree;
+        if (record.isFree) {
+            countBitmapFree(allocator, record.size >> bitmap->granuleShift, 1);
+            continue;
+        }
+        if (record.requested <= record.size - granule || record.requested > record.size || !reserveBitmapOwner(allocator))
+            return 0;
+        int handle = restoreOwner(allocator, &record);
+        if (handle < 0)
+            return 0;
+        ProcessEntry *entry = &allocator->processes[handle];
+        markGranules(bitmap, first, record.size >> bitmap->granuleShift, 1);
+        writeBit(bitmap->starts, first, 1);
+        entry->bitmapStart = first;
+        entry->bitmapRequested = record.requested;
+        insertBitmapOwner(allocator, handle);
+        bitmap->internalFragmentation += record.size - record.requested;
+    }
+    bitmap->peakBlockCount = bitmap->ownerCount + allocator->freeBlockCount;
+    return nextStart == heapEnd;
+}
+
+/** Validates a snapshot header and rebuilds its heap, backed or simulated. */
+static Allocator *restoreSnapshot(const void *snapshot, size_t length, int backed) {
+    SnapshotHeader header;
+    if (length < sizeof(header))
+        return NULL;
+    memcpy(&header, snapshot, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION ||
+        header.byteOrder != SNAPSHOT_BYTE_ORDER || header.engine >= ALLOCATOR_ENGINE_COUNT || header.blockCount < 0 ||
+        (uint64_t)header.blockCount != (length - sizeof(header)) / sizeof(SnapshotBlock) ||
+        (length - sizeof(header)) % sizeof(SnapshotBlock) != 0 ||
+        (header.engine == ALLOCATOR_ENGINE_BITMAP && header.granuleShift > BITMAP_MAX_GRANULE_SHIFT) ||
+        header.checksum != snapshotChecksum(snapshot, length))
+        return NULL;
+    AllocatorEngine engine = (AllocatorEngine)header.engine;
+    int granuleShift = engine == ALLOCATOR_ENGINE_BITMAP ? (int)header.granuleShift : BITMAP_DEFAULT_GRANULE_SHIFT;
+    Allocator *allocator = createAllocator(header.totalSize, engine, granuleShift);
+    if (backed)
+        allocator = attachBacking(allocator);
+    if (!allocator)
+        return NULL;
+    const unsigned char *records = (const unsigned char *)snapshot + sizeof(header);
+    int restored = engine == ALLOCATOR_ENGINE_BUDDY    ? restoreBuddyBlocks(allocator, records, header.blockCount)
+                   : engine == ALLOCATOR_ENGINE_ARRAY  ? restoreArrayBlocks(allocator, records, header.blockCount)
+                   : engine == ALLOCATOR_ENGINE_BITMAP ? restoreBitmapBlocks(allocator, records, header.blockCount)
+                                                       : restoreListBlocks(allocator, records, header.blockCount);
+    if (!restored) {
+        allocator_destroy(allocator);
+        return NULL;
+    }
+    return allocator;
+}
+
+Allocator *allocator_restore(const void *snapshot, size_t length) {
+    return restoreSnapshot(snapshot, length, 0);
+}
+
+Allocator *allocator_restore_backed(const void *snapshot, size_t length) {
+    return restoreSnapshot(snapshot, length, 1);
+}
+
+int allocator_parse_strategy(char letter, AllocatorStrategy *strategy) {
+    switch (letter) {
+    case 'F': *strategy = ALLOCATOR_FIRST_FIT; return 1;
+    case 'N': *strategy = ALLOCATOR_NEXT_FIT; return 1;
+    case 'B': *strategy = ALLOCATOR_BEST_FIT; return 1;
+    case 'W': *strategy = ALLOCATOR_WORST_FIT; return 1;
+    case 'S': *strategy = ALLOCATOR_SEGREGATED_FIT; return 1;
+    default: return 0;
+    }
+}
+
+const char *allocator_strategy_name(AllocatorStrategy strategy) {
+    static const char *const names[ALLOCATOR_STRATEGY_COUNT] = {
+        "First Fit", "Next Fit", "Best Fit", "Worst Fit", "Segregated Fit",
+    };
+    return (unsigned)strategy < ALLOCATOR_STRATEGY_COUNT ? names[strategy] : "Unknown";
+}
+
+const char *allocator_engine_name(AllocatorEngine engine) {
+    static const char *const names[ALLOCATOR_ENGINE_COUNT] = {"list", "buddy", "array", "bitmap"};
+    return (unsigned)engine < ALLOCATOR_ENGINE_COUNT ? names[engine] : "unknown";
+}
+
+const char *allocator_scan_kernels(void) {
+    return selectFreeSizeKernels()->name;
+}
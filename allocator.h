@@ -0,0 +1,369 @@
+/**
+ * \file    allocator.h
+ * \brief   Embeddable contiguous memory allocator.
+ *
+ * Each Allocator handle manages its own simulated address space [0, size - 1]
+ * with no global state and no console output, so several heaps can live in
+ * one process and be driven in a tight loop. Operations report their outcome
+ * through AllocatorStatus codes; the CLI in contiguous_memory_allocator.c is a
+ * thin front end that turns those codes into messages.
+ *
+ * An Allocator is single-threaded: only allocator_release_deferred may be called
+ * from other threads while its owner uses it.
+ */
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+#define ALLOCATOR_PROCESS_ID_SIZE 16 // Process ID buffer size; longer IDs fail with ALLOCATOR_ERR_INVALID_ID
+#define ALLOCATOR_BUDDY_MAX_SIZE (2147483647LL << 4) // Largest buddy heap: 2^31 - 1 leaves of 16 bytes
+#define ALLOCATOR_SIZE_CLASS_COUNT 64 // Power-of-two size classes: class k holds sizes [2^k, 2^(k+1))
+#define ALLOCATOR_BITMAP_GRANULE 16 // Bitmap engine granule used by allocator_create
+
+/* Instrumentation level, fixed at build time: 1 counts the blocks every placement scan visits
+ * into AllocatorScanStats.nodesVisited; -DALLOCATOR_SCAN_STATS=0 compiles the counting out of
+ * the scan loops and leaves nodesVisited at 0. */
+#ifndef ALLOCATOR_SCAN_STATS
+#define ALLOCATOR_SCAN_STATS 1
+#endif
+
+/** Byte counts and addresses. 64-bit so heaps can exceed 2 GiB; signed so -1 can mean "none". */
+typedef long long AllocatorSize;
+
+/** Names a process for deferred release: its table slot plus the slot's reuse generation.
+ *  A process ID is forgotten once it owns no block and is not parked, and its slot goes
+ *  to the next new ID under a new generation, so a handle kept past its release never
+ *  names the newcomer. -1 means none. */
+typedef long long AllocatorHandle;
+
+/** Allocation backend chosen when the heap is created. */
+typedef enum AllocatorEngine {
+    ALLOCATOR_ENGINE_LIST,   // Linked list of blocks with F/N/B/W/S placement
+    ALLOCATOR_ENGINE_BUDDY,  // Power-of-two buddy system
+    ALLOCATOR_ENGINE_ARRAY,  // Address-ordered parallel arrays of blocks with F/N/B/W/S placement
+    ALLOCATOR_ENGINE_BITMAP, // One bit per fixed-size granule with F/N/B/W/S placement
+    ALLOCATOR_ENGINE_COUNT
+} AllocatorEngine;
+
+/** Placement strategy for the list, array and bitmap engines. The buddy engine accepts any of them. */
+typedef enum AllocatorStrategy {
+    ALLOCATOR_FIRST_FIT,
+    ALLOCATOR_NEXT_FIT,
+    ALLOCATOR_BEST_FIT,
+    ALLOCATOR_WORST_FIT,
+    ALLOCATOR_SEGREGATED_FIT,
+    ALLOCATOR_STRATEGY_COUNT
+} AllocatorStrategy;
+
+/** Result of an allocator operation. */
+typedef enum AllocatorStatus {
+    ALLOCATOR_OK = 0,
+    ALLOCATOR_ERR_EXISTS,           // The process already owns a block
+    ALLOCATOR_ERR_NOT_FOUND,        // The process owns no block
+    ALLOCATOR_ERR_NO_SPACE,         // No free block can hold the request
+    ALLOCATOR_ERR_INVALID_SIZE,     // Size is not positive
+    ALLOCATOR_ERR_INVALID_STRATEGY, // Strategy is out of range
+    ALLOCATOR_ERR_NO_MEMORY,        // Host memory for bookkeeping ran out
+    ALLOCATOR_ERR_QUEUE_FULL,       // The deferred release queue is full (or not enabled)
+    ALLOCATOR_ERR_INVALID_ALIGNMENT, // Alignment is not a positive power of two
+    ALLOCATOR_PENDING,              // The request is parked in the wait queue
+    ALLOCATOR_ERR_CANCELLED,        // A parked request was cancelled before it was placed
+    ALLOCATOR_ERR_INVALID_ID        // The process ID is NULL or ALLOCATOR_PROCESS_ID_SIZE characters or longer
+} AllocatorStatus;
+
+/** Order in which parked requests are retried when space frees up. */
+typedef enum AllocatorWaitPolicy {
+    ALLOCATOR_WAIT_FIFO,    // Oldest request first
+    ALLOCATOR_WAIT_PRIORITY // Highest priority first, oldest first among equals
+} AllocatorWaitPolicy;
+
+/** A block as reported by allocation and iteration. */
+typedef struct AllocatorBlock {
+    AllocatorSize startAddress;
+    AllocatorSize endAddress;
+    AllocatorSize size;      // Bytes covered by the block
+    AllocatorSize requested; // Bytes the owner asked for (differs from size under the buddy and bitmap engines)
+    int isFree;
+    const char *owner; // Owning process ID, NULL for FREE blocks
+    AllocatorHandle handle; // Owner's process handle for deferred release, -1 for FREE blocks
+    void *data;        // Backed heaps: the block's bytes; NULL for simulated heaps
+} AllocatorBlock;
+
+/** Per-strategy count of requests and nodes visited while placing them (the latter only
+ *  when ALLOCATOR_SCAN_STATS is 1). */
+typedef struct AllocatorScanStats {
+    long long requests;
+    long long nodesVisited;
+} AllocatorScanStats;
+
+/** Heap-wide counters. Every field except largestFreeBlock is maintained as blocks split
+ *  and merge, so reading it never walks the block list. The list and buddy engines find
+ *  largestFreeBlock from their free indexes without a scan. The array and bitmap engines keep
+ *  it as a running maximum: the first read after the last FREE block of that size was split
+ *  or taken rescans their FREE blocks, unless a single block tops the size classes. */
+typedef struct AllocatorStats {
+    AllocatorEngine engine;
+    AllocatorSize totalSize;             // Bytes in the address space
+    AllocatorSize freeBytes;             // Bytes in FREE blocks
+    AllocatorSize largestFreeBlock;      // Size of the largest FREE block
+    int blockCount;                      // FREE and allocated blocks
+    int peakBlockCount;                  // High-water mark of blockCount
+    int freeBlockCount;                  // FREE blocks
+    int allocatedBlockCount;             // Allocated blocks
+    int freeSizeHistogram[ALLOCATOR_SIZE_CLASS_COUNT]; // FREE blocks per size class
+    AllocatorSize internalFragmentation; // Rounding waste inside allocated blocks
+    AllocatorSize unusableBytes;         // Tail bytes the engine cannot hand out
+    AllocatorSize granuleSize;           // Bitmap engine: bytes per granule; 0 for the other engines
+    AllocatorScanStats scans[ALLOCATOR_STRATEGY_COUNT];
+    long long deferredReleases; // Deferred releases applied by a drain
+    long long deferredMisses;   // Deferred releases whose handle owned no block when drained
+    long long blocksMoved;      // Allocated blocks relocated by compaction
+    long long bytesMoved;       // Bytes relocated by compaction
+    long long resizesInPlace;   // allocator_resize calls served without moving the block
+    long long resizesMoved;     // allocator_resize calls that moved the block
+    long long bytesCopied;      // Backed heaps: relocated bytes moved with memmove
+    long long bytesRemapped;    // Backed heaps: relocated bytes moved by remapping whole pages
+    long long bytesDiscarded;   // Backed heaps: free pages returned to the OS (MADV_DONTNEED)
+    long long splits;           // FREE blocks split off (list, array, bitmap) or blocks halved (buddy)
+    long long merges;           // FREE neighbours merged (list, array, bitmap) or buddy pairs joined (buddy)
+    long long nodeAllocations;  // List engine: block nodes taken from the node pool
+    long long nodeReleases;     // List engine: block nodes returned to the node pool
+    long long slabAllocations;  // List engine: node slabs malloc'd to grow the pool
+    int waitingRequests;        // Requests parked in the wait queue now
+    long long parkedRequests;   // Requests ever parked by allocator_allocate_or_wait
+    long long wokenRequests;    // Parked requests later placed
+    long long cancelledRequests; // Parked requests cancelled before they were placed
+    long long policySteps;      // Compaction steps run by the compaction policy
+    long long failureCompactions; // Full compactions run by the policy to retry a failed allocation
+} AllocatorStats;
+
+/** One item of a bulk allocation: processId and size are read, status and block are filled in. */
+typedef struct AllocatorRequest {
+    const char *processId;
+    AllocatorSize size;
+    AllocatorStatus status;
+    AllocatorBlock block; // Placement, valid when status is ALLOCATOR_OK
+} AllocatorRequest;
+
+/** A maximal run of adjacent blocks moved by compaction as one unit. The source and
+ *  destination may overlap (destination is always lower), so copy with memmove. */
+typedef struct AllocatorRelocation {
+    AllocatorSize oldStart; // First address of the run before the move
+    AllocatorSize newStart; // First address of the run after the move
+    AllocatorSize size;     // Bytes in the run
+    int blockCount;         // Allocated blocks merged into the run
+} AllocatorRelocation;
+
+/** Outcome of allocator_allocate_or_wait, owned by the caller and filled in by the allocator.
+ *  status stays ALLOCATOR_PENDING while the request is parked, then becomes ALLOCATOR_OK
+ *  (block describes the placement) or ALLOCATOR_ERR_CANCELLED. */
+typedef struct AllocatorFuture {
+    AllocatorStatus status;
+    AllocatorBlock block;
+} AllocatorFuture;
+
+/** Automatic compaction driven by external fragmentation: the share of free bytes outside
+ *  the largest FREE block. Once it reaches threshold the policy starts compacting in bounded
+ *  steps and keeps going until the heap is fully compacted, then waits for a release or
+ *  resize to open new holes before it looks again. */
+typedef struct AllocatorCompactionPolicy {
+    double threshold;      // Fragmentation (0..1) that starts a compaction; 0 disables it
+    int stepBlocks;        // Budget of one step, as for allocator_compact_step (both 0: no limit)
+    AllocatorSize stepBytes;
+    int stepInterval;      // Look at most once per this many allocate, resize and release calls
+    int compactOnFailure;  // Compact fully and retry when an allocation fails though enough bytes are free
+} AllocatorCompactionPolicy;
+
+typedef struct Allocator Allocator;
+
+/** Called once per block, in address order, by allocator_for_each_block. */
+typedef void (*AllocatorBlockVisitor)(const AllocatorBlock *block, void *context);
+
+/** Called once per relocation run, in ascending address order, before compaction returns.
+ *  On a backed heap the run's bytes have already been moved when the visitor runs. */
+typedef void (*AllocatorRelocationVisitor)(const AllocatorRelocation *relocation, void *context);
+
+/** Called when a parked request completes, after its future is filled in. The callback may
+ *  call back into the allocator, except allocator_destroy; requests that find room through
+ *  it are woken once it returns. When allocator_destroy cancels the request, the callback
+ *  must not touch the allocator. */
+typedef void (*AllocatorWaitCallback)(const char *processId, const AllocatorFuture *future, void *context);
+
+/** Creates a heap of size bytes (size >= 1, and at most ALLOCATOR_BUDDY_MAX_SIZE for the
+ *  buddy engine; the bitmap engine uses ALLOCATOR_BITMAP_GRANULE-byte granules). Returns
+ *  NULL if the size is out of range or host memory runs out. */
+Allocator *allocator_create(AllocatorSize size, AllocatorEngine engine);
+
+/** Creates a bitmap engine heap that hands out granule-byte units (a power of two up to
+ *  2^30), rounding each block up to whole granules. The bytes past the last whole granule
+ *  are unusable. Returns NULL if the heap holds no granule, the granule is out of range,
+ *  or host memory runs out. */
+Allocator *allocator_create_bitmap(AllocatorSize size, AllocatorSize granule);
+
+/** Creates a heap whose address range is a real mmap'd (VirtualAlloc on Windows) buffer:
+ *  blocks report a data pointer, compaction moves their bytes (remapping large page-aligned
+ *  runs where the OS allows), and large free page runs are returned to the OS. */
+Allocator *allocator_create_backed(AllocatorSize size, AllocatorEngine engine);
+
+/** Backed counterpart of allocator_create_bitmap. */
+Allocator *allocator_create_bitmap_backed(AllocatorSize size, AllocatorSize granule);
+
+/** Returns the backing buffer (address 0), or NULL for a simulated heap. */
+void *allocator_base(const Allocator *allocator);
+
+/** Releases a heap and all of its bookkeeping. Parked requests are cancelled first. */
+void allocator_destroy(Allocator *allocator);
+
+/** Allocates size bytes for processId. On ALLOCATOR_OK, *block (if non-NULL) describes the placement.
+ *  Every call that takes a process ID fails with ALLOCATOR_ERR_INVALID_ID if it does not fit
+ *  in ALLOCATOR_PROCESS_ID_SIZE bytes with its terminator. */
+AllocatorStatus allocator_allocate(Allocator *allocator, const char *processId, AllocatorSize size,
+                                   AllocatorStrategy strategy, AllocatorBlock *block);
+
+/** Like allocator_allocate, but places the block at a multiple of alignment (a power of two).
+ *  The list, array and bitmap engines split the skipped head bytes off as a FREE block, and
+ *  compaction keeps the block aligned; the buddy engine rounds the block up to at least
+ *  alignment bytes. Bitmap blocks are always aligned to their granule. */
+AllocatorStatus allocator_allocate_aligned(Allocator *allocator, const char *processId, AllocatorSize size,
+                                           AllocatorSize alignment, AllocatorStrategy strategy, AllocatorBlock *block);
+
+/** Allocates every request with one strategy, filling in each item's status and block.
+ *  Items are placed in ascending size order (ties in input order), so First Fit serves the
+ *  whole batch in a single pass over the block list with the same result as placing them
+ *  one by one in that order. A process ID repeated in the batch fails with
+ *  ALLOCATOR_ERR_EXISTS after its first occurrence. Items that find no room get the
+ *  policy's compactOnFailure retry after the pass, which may move blocks placed earlier
+ *  in the batch; their reported blocks are updated to match. Returns the number of items placed. */
+int allocator_allocate_many(Allocator *allocator, AllocatorRequest *requests, int count, AllocatorStrategy strategy);
+
+/** Resizes the block owned by processId to newSize bytes, keeping its alignment. Shrinking
+ *  splits the tail off as FREE; growing absorbs a large enough FREE successor (a free buddy
+ *  under the buddy engine). Otherwise the block moves: to wherever strategy finds room, else
+ *  over its own space merged with its FREE neighbours. On a backed heap the first
+ *  min(old, new) bytes move with it. On failure the block is left untouched. */
+AllocatorStatus allocator_resize(Allocator *allocator, const char *processId, AllocatorSize newSize,
+                                 AllocatorStrategy strategy, AllocatorBlock *block);
+
+/** Like allocator_allocate_aligned, but a request that finds no room is parked instead of
+ *  failing: it returns ALLOCATOR_PENDING and the request is retried whenever a release,
+ *  resize or compaction frees space. Parked requests are indexed by size class, so a
+ *  retry only looks at those that could fit the largest FREE block, taking them in the
+ *  wait policy's order; one that still does not fit is passed over without blocking the
+ *  requests behind it. A request placed at once returns ALLOCATOR_OK with *block filled
+ *  in, as allocator_allocate_aligned does, and no callback. A parked one marks future (if
+ *  non-NULL, it must stay valid while the request waits) ALLOCATOR_PENDING; on completion
+ *  future is filled in and callback (if non-NULL) runs. A request larger than an empty heap
+ *  could hold fails with ALLOCATOR_ERR_NO_SPACE. A parked process owns no block; allocating
+ *  it again fails with ALLOCATOR_ERR_EXISTS. */
+AllocatorStatus allocator_allocate_or_wait(Allocator *allocator, const char *processId, AllocatorSize size,
+                                           AllocatorSize alignment, AllocatorStrategy strategy, int priority,
+                                           AllocatorBlock *block, AllocatorWaitCallback callback, void *context,
+                                           AllocatorFuture *future);
+
+/** Cancels the request parked for processId: its future becomes ALLOCATOR_ERR_CANCELLED and
+ *  its callback runs. Returns ALLOCATOR_ERR_NOT_FOUND if the process is not waiting. */
+AllocatorStatus allocator_cancel_wait(Allocator *allocator, const char *processId);
+
+/** Sets the order parked requests are retried in (ALLOCATOR_WAIT_FIFO by default),
+ *  reordering the requests already parked. */
+void allocator_set_wait_policy(Allocator *allocator, AllocatorWaitPolicy policy);
+
+/** Releases the block owned by processId and coalesces it with free neighbours. */
+AllocatorStatus allocator_release(Allocator *allocator, const char *processId);
+
+/** Releases the blocks owned by each of count process IDs, coalescing every run of adjacent
+ *  freed blocks in one merge. statuses (if non-NULL) receives ALLOCATOR_OK,
+ *  ALLOCATOR_ERR_NOT_FOUND or ALLOCATOR_ERR_INVALID_ID per ID. Returns the number of blocks released. */
+int allocator_release_many(Allocator *allocator, const char *const *processIds, int count, AllocatorStatus *statuses);
+
+/** Enables the deferred release queue with room for capacity handles (rounded up to a power
+ *  of two). Call from the owning thread before any producer pushes. */
+AllocatorStatus allocator_enable_deferred_release(Allocator *allocator, int capacity);
+
+/** Queues the release of the block owned by handle. Lock-free and safe to call from any
+ *  number of threads concurrently with the owning thread. The release takes effect when
+ *  the owning thread next drains: explicitly, or at the start of allocate, release and
+ *  compact. A handle whose block was released by then is counted as a miss. */
+AllocatorStatus allocator_release_deferred(Allocator *allocator, AllocatorHandle handle);
+
+/** Applies every queued release and coalesces the freed blocks. Returns how many were applied. */
+int allocator_drain_releases(Allocator *allocator);
+
+/** Compacts the heap in one go: slides every allocated block down to the lowest free
+ *  address, rewriting its start and end, so all free space forms one block at the top.
+ *  Aligned blocks stop at their lowest aligned free address, so padding may stay FREE. */
+void allocator_compact(Allocator *allocator);
+
+/** Runs a bounded slice of the same sliding compaction: moves at most maxBlocks blocks
+ *  or maxBytes bytes (0 means no limit; at least one block always moves). Can be
+ *  interleaved freely with allocation and release. Returns 1 once the heap is fully compacted. */
+int allocator_compact_step(Allocator *allocator, int maxBlocks, AllocatorSize maxBytes);
+
+/** Sets the compaction policy (NULL turns it off, the default). Policy steps run at the start
+ *  of allocate and resize calls and at the end of release calls, and through allocator_idle;
+ *  they move blocks like allocator_compact_step and report them to the relocation visitor.
+ *  The buddy engine never compacts, so the policy does nothing there. */
+void allocator_set_compaction_policy(Allocator *allocator, const AllocatorCompactionPolicy *policy);
+
+/** Lets the compaction policy use idle time: runs one step if the policy is due, whatever
+ *  stepInterval says. Returns 1 if a compaction is still under way, so the owner can keep
+ *  calling it while it has nothing else to do. */
+int allocator_idle(Allocator *allocator);
+
+/** Registers visitor to hear about every run compaction moves (NULL to stop). Runs are
+ *  merged across adjacent blocks that move by the same distance, so replaying them in
+ *  order with memmove (or page remapping) reproduces the compacted layout. */
+void allocator_set_relocation_visitor(Allocator *allocator, AllocatorRelocationVisitor visitor, void *context);
+
+/** Fills *stats with the heap's current counters. Not const: on the array and bitmap engines
+ *  it may refresh the cached largest FREE size (see AllocatorStats). */
+void allocator_stats(Allocator *allocator, AllocatorStats *stats);
+
+/** Visits every block in address order. */
+void allocator_for_each_block(const Allocator *allocator, AllocatorBlockVisitor visitor, void *context);
+
+/** Called by allocator_walk_blocks for each block; returns 0 to stop the walk. */
+typedef int (*AllocatorBlockWalker)(const AllocatorBlock *block, void *context);
+
+/** Visits blocks in address order, starting with the one holding fromAddress, until walker
+ *  returns 0 or the heap ends. Returns the start of the first block not visited, or -1 if
+ *  the walk reached the end. The buddy engine finds the first block without a scan. */
+AllocatorSize allocator_walk_blocks(const Allocator *allocator, AllocatorSize fromAddress, AllocatorBlockWalker walker,
+                                    void *context);
+
+/** Returns the bytes allocator_snapshot writes: a fixed, checksummed header plus one
+ *  fixed-size record (start, size, requested bytes, state, alignment, owner ID) per block,
+ *  in address order. */
+size_t allocator_snapshot_size(const Allocator *allocator);
+
+/** Writes the block layout into buffer (allocator_snapshot_size bytes, any alignment) in the
+ *  flat, versioned, host-endian snapshot layout. Counters, handles, parked requests and
+ *  block data are not saved. */
+void allocator_snapshot(const Allocator *allocator, void *buffer);
+
+/** Rebuilds a heap from a snapshot in one pass over its records, relinking the blocks and
+ *  reindexing the FREE ones and the process IDs. The snapshot can be used straight from
+ *  a read-only mapping. Returns NULL if the snapshot is malformed, truncated, fails its
+ *  checksum, is from another version or byte order, or host memory runs out. */
+Allocator *allocator_restore(const void *snapshot, size_t length);
+
+/** Like allocator_restore, but backs the heap with a real buffer as allocator_create_backed
+ *  does. The blocks' bytes start out zeroed. */
+Allocator *allocator_restore_backed(const void *snapshot, size_t length);
+
+/** Maps an RQ letter (F, N, B, W, S) to a strategy. Returns 0 if the letter is unknown. */
+int allocator_parse_strategy(char letter, AllocatorStrategy *strategy);
+
+/** Returns a display name such as "First Fit". */
+const char *allocator_strategy_name(AllocatorStrategy strategy);
+
+/** Returns an engine's command-line name: "list", "buddy", "array" or "bitmap". */
+const char *allocator_engine_name(AllocatorEngine engine);
+
+/** Returns the instruction set the array engine scans free sizes with on this CPU: "avx512",
+ *  "avx2", "neon" or "scalar". Placement is the same whichever it is. */
+const char *allocator_scan_kernels(void);
+
+#endif /* ALLOCATOR_H */
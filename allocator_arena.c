@@ -0,0 +1,357 @@
+/**
+ * \file    allocator_arena.c
+ * \brief   Multi-arena, thread-safe wrapper around the allocator library.
+ *
+ * Lock order: a directory shard lock is never held while taking an arena
+ * lock. Allocation and release mark the directory entry PENDING, drop the
+ * shard lock, operate on the arena, then publish the result under the shard
+ * lock again, so a concurrent request for the same ID sees it as taken.
+ *
+ * Compile with -pthread.
+ */
+
+#include "allocator_arena.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIRECTORY_SHARD_COUNT 64   // Independent locks over the process directory (power of two)
+#define DIRECTORY_MIN_CAPACITY 64  // Initial slots per shard (power of two)
+#define ARENA_NONE -1              // Directory entry: the ID owns no block
+#define ARENA_PENDING -2           // Directory entry: an allocate or release is in flight
+#define CACHE_LINE_SIZE 64
+
+/** One arena: an independent heap covering [base, base + size - 1]. */
+typedef struct Arena {
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock; // Padded so neighbouring arenas do not share a line
+    Allocator *heap;
+    AllocatorSize base;
+} Arena;
+
+/** A process ID and the arena holding its block. An entry is removed once its ID owns no
+ *  block, so the directory only holds live and in-flight IDs. */
+typedef struct DirectoryEntry {
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    int arena;  // Arena index, ARENA_NONE or ARENA_PENDING
+} DirectoryEntry;
+
+/** One shard of the process directory: an open-addressing table under its own lock. */
+typedef struct DirectoryShard {
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t lock;
+    DirectoryEntry *entries;  // Linear probing; empty slots have processId[0] == '\0'
+    size_t capacity;          // Slot count, always a power of two
+    size_t count;             // Occupied slots
+} DirectoryShard;
+
+struct AllocatorArenas {
+    Arena *arenas;
+    int arenaCount;
+    AllocatorSize arenaSize;   // Bytes per arena; the last arena also takes the remainder
+    AllocatorEngine engine;
+    DirectoryShard shards[DIRECTORY_SHARD_COUNT];
+    atomic_llong localAllocations;
+    atomic_llong fallbackAllocations;
+};
+
+static atomic_int nextThreadSlot;             // Round-robin source for home arenas
+static _Thread_local int threadSlot = -1;     // This thread's slot, assigned on first use
+
+/** Returns the calling thread's home arena. */
+static int homeArena(const AllocatorArenas *arenas) {
+    if (threadSlot < 0)
+        threadSlot = atomic_fetch_add(&nextThreadSlot, 1) & 0x7fffffff;
+    return threadSlot % arenas->arenaCount;
+}
+
+/** Returns 1 if processId is non-NULL, non-empty (an empty ID marks an empty directory slot)
+ *  and fits in a directory entry with its terminator. */
+static int validProcessId(const char *processId) {
+    if (!processId || !processId[0])
+        return 0;
+    size_t length = 0;
+    while (length < ALLOCATOR_PROCESS_ID_SIZE && processId[length])
+        length++;
+    return length < ALLOCATOR_PROCESS_ID_SIZE;
+}
+
+/** FNV-1a hash of a process ID. */
+static size_t hashProcessId(const char *processId) {
+    size_t hash = 2166136261u;
+    while (*processId) {
+        hash ^= (unsigned char)*processId++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/** Returns the slot holding processId, or the empty slot where it would be inserted. */
+static DirectoryEntry *probeDirectory(DirectoryEntry *entries, size_t capacity, const char *processId, size_t hash) {
+    size_t slot = (hash / DIRECTORY_SHARD_COUNT) & (capacity - 1);
+    while (entries[slot].processId[0] && strcmp(entries[slot].processId, processId) != 0)
+        slot = (slot + 1) & (capacity - 1);
+    return &entries[slot];
+}
+
+/** Doubles a shard's table and rehashes its entries. Returns 0 if host memory ran out. */
+static int growDirectoryShard(DirectoryShard *shard) {
+    size_t newCapacity = shard->capacity ? shard->capacity * 2 : DIRECTORY_MIN_CAPACITY;
+    DirectoryEntry *newEntries = (DirectoryEntry *)calloc(newCapacity, sizeof(DirectoryEntry));
+    if (!newEntries)
+        return 0;
+    for (size_t slot = 0; slot < shard->capacity; slot++) {
+        const DirectoryEntry *entry = &shard->entries[slot];
+        if (entry->processId[0])
+            *probeDirectory(newEntries, newCapacity, entry->processId, hashProcessId(entry->processId)) = *entry;
+    }
+    free(shard->entries);
+    shard->entries = newEntries;
+    shard->capacity = newCapacity;
+    return 1;
+}
+
+/** Returns processId's entry in a locked shard, adding it (as ARENA_NONE) when create is set.
+ *  Returns NULL if the ID is absent and create is clear, or if host memory ran out. */
+static DirectoryEntry *findDirectoryEntry(DirectoryShard *shard, const char *processId, size_t hash, int create) {
+    if (!shard->capacity) {
+        if (!create || !growDirectoryShard(shard))
+            return NULL;
+    }
+    DirectoryEntry *entry = probeDirectory(shard->entries, shard->capacity, processId, hash);
+    if (entry->processId[0] || !create)
+        return entry->processId[0] ? entry : NULL;
+    if ((shard->count + 1) * 2 > shard->capacity) {
+        if (!growDirectoryShard(shard))
+            return NULL;
+        entry = probeDirectory(shard->entries, shard->capacity, processId, hash);
+    }
+    strncpy(entry->processId, processId, ALLOCATOR_PROCESS_ID_SIZE - 1);
+    entry->processId[ALLOCATOR_PROCESS_ID_SIZE - 1] = '\0';
+    entry->arena = ARENA_NONE;
+    shard->count++;
+    return entry;
+}
+
+/** Removes an entry from a locked shard, shifting later entries of its probe run back so
+ *  linear probing still finds them. */
+static void removeDirectoryEntry(DirectoryShard *shard, DirectoryEntry *entry) {
+    DirectoryEntry *entries = shard->entries;
+    size_t mask = shard->capacity - 1;
+    size_t hole = (size_t)(entry - entries);
+    for (size_t slot = (hole + 1) & mask; entries[slot].processId[0]; slot = (slot + 1) & mask) {
+        size_t home = (hashProcessId(entries[slot].processId) / DIRECTORY_SHARD_COUNT) & mask;
+        if (hole <= slot ? home > hole && home <= slot : home > hole || home <= slot)
+            continue; // Still reachable from its home slot
+        entries[hole] = entries[slot];
+        hole = slot;
+    }
+    entries[hole].processId[0] = '\0';
+    shard->count--;
+}
+
+/** Publishes the final arena of an ID whose entry is PENDING, removing the entry when the
+ *  ID ends up owning no block. */
+static void settleDirectoryEntry(DirectoryShard *shard, const char *processId, size_t hash, int arena) {
+    pthread_mutex_lock(&shard->lock);
+    DirectoryEntry *entry = findDirectoryEntry(shard, processId, hash, 0);
+    if (entry) {
+        if (arena == ARENA_NONE)
+            removeDirectoryEntry(shard, entry);
+        else
+            entry->arena = arena;
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+AllocatorArenas *allocator_arenas_create(AllocatorSize size, int arenaCount, AllocatorEngine engine) {
+    if (arenaCount < 1 || size < arenaCount)
+        return NULL;
+    AllocatorArenas *arenas = (AllocatorArenas *)aligned_alloc(CACHE_LINE_SIZE, sizeof(AllocatorArenas));
+    if (!arenas)
+        return NULL;
+    memset(arenas, 0, sizeof(*arenas));
+    arenas->arenas = (Arena *)aligned_alloc(CACHE_LINE_SIZE, sizeof(Arena) * arenaCount);
+    if (!arenas->arenas) {
+        free(arenas);
+        return NULL;
+    }
+    for (int i = 0; i < DIRECTORY_SHARD_COUNT; i++)
+        pthread_mutex_init(&arenas->shards[i].lock, NULL);
+    arenas->arenaSize = size / arenaCount;
+    arenas->engine = engine;
+    for (int i = 0; i < arenaCount; i++) {
+        Arena *arena = &arenas->arenas[i];
+        AllocatorSize arenaBytes = i == arenaCount - 1 ? size - i * arenas->arenaSize : arenas->arenaSize;
+        arena->base = i * arenas->arenaSize;
+        arena->heap = allocator_create(arenaBytes, engine);
+        pthread_mutex_init(&arena->lock, NULL);
+        arenas->arenaCount = i + 1;
+        if (!arena->heap) {
+            allocator_arenas_destroy(arenas);
+            return NULL;
+        }
+    }
+    return arenas;
+}
+
+void allocator_arenas_destroy(AllocatorArenas *arenas) {
+    if (!arenas)
+        return;
+    for (int i = 0; i < arenas->arenaCount; i++) {
+        allocator_destroy(arenas->arenas[i].heap);
+        pthread_mutex_destroy(&arenas->arenas[i].lock);
+    }
+    for (int i = 0; i < DIRECTORY_SHARD_COUNT; i++) {
+        free(arenas->shards[i].entries);
+        pthread_mutex_destroy(&arenas->shards[i].lock);
+    }
+    free(arenas->arenas);
+    free(arenas);
+}
+
+AllocatorStatus allocator_arenas_allocate(AllocatorArenas *arenas, const char *processId, AllocatorSize size,
+                                          AllocatorStrategy strategy, AllocatorBlock *block) {
+    if (!validProcessId(processId))
+        return ALLOCATOR_ERR_INVALID_ID;
+    size_t hash = hashProcessId(processId);
+    DirectoryShard *shard = &arenas->shards[hash & (DIRECTORY_SHARD_COUNT - 1)];
+    pthread_mutex_lock(&shard->lock);
+    DirectoryEntry *entry = findDirectoryEntry(shard, processId, hash, 1);
+    AllocatorStatus status = !entry ? ALLOCATOR_ERR_NO_MEMORY
+                             : entry->arena != ARENA_NONE ? ALLOCATOR_ERR_EXISTS : ALLOCATOR_OK;
+    if (status == ALLOCATOR_OK)
+        entry->arena = ARENA_PENDING;
+    pthread_mutex_unlock(&shard->lock);
+    if (status != ALLOCATOR_OK)
+        return status;
+
+    int home = homeArena(arenas);
+    int placedIn = ARENA_NONE;
+    for (int attempt = 0; attempt < arenas->arenaCount; attempt++) {
+        Arena *arena = &arenas->arenas[(home + attempt) % arenas->arenaCount];
+        pthread_mutex_lock(&arena->lock);
+        status = allocator_allocate(arena->heap, processId, size, strategy, block);
+        pthread_mutex_unlock(&arena->lock);
+        if (status == ALLOCATOR_OK) {
+            placedIn = (home + attempt) % arenas->arenaCount;
+            atomic_fetch_add_explicit(attempt ? &arenas->fallbackAllocations : &arenas->localAllocations, 1,
+                                      memory_order_relaxed);
+            if (block) {
+                block->startAddress += arena->base;
+                block->endAddress += arena->base;
+                block->owner = processId; // The arena's own copy may move once its lock is dropped
+            }
+            break;
+        }
+        if (status != ALLOCATOR_ERR_NO_SPACE)
+            break; // Invalid input fails the same way everywhere
+    }
+    settleDirectoryEntry(shard, processId, hash, placedIn);
+    return status;
+}
+
+AllocatorStatus allocator_arenas_release(AllocatorArenas *arenas, const char *processId) {
+    if (!validProcessId(processId))
+        return ALLOCATOR_ERR_INVALID_ID;
+    size_t hash = hashProcessId(processId);
+    DirectoryShard *shard = &arenas->shards[hash & (DIRECTORY_SHARD_COUNT - 1)];
+    pthread_mutex_lock(&shard->lock);
+    DirectoryEntry *entry = findDirectoryEntry(shard, processId, hash, 0);
+    int index = entry ? entry->arena : ARENA_NONE;
+    if (index >= 0)
+        entry->arena = ARENA_PENDING;
+    pthread_mutex_unlock(&shard->lock);
+    if (index < 0)
+        return ALLOCATOR_ERR_NOT_FOUND;
+
+    Arena *arena = &arenas->arenas[index];
+    pthread_mutex_lock(&arena->lock);
+    AllocatorStatus status = allocator_release(arena->heap, processId);
+    pthread_mutex_unlock(&arena->lock);
+    settleDirectoryEntry(shard, processId, hash, ARENA_NONE);
+    return status;
+}
+
+void allocator_arenas_compact(AllocatorArenas *arenas) {
+    for (int i = 0; i < arenas->arenaCount; i++) {
+        pthread_mutex_lock(&arenas->arenas[i].lock);
+        allocator_compact(arenas->arenas[i].heap);
+        pthread_mutex_unlock(&arenas->arenas[i].lock);
+    }
+}
+
+void allocator_arenas_stats(AllocatorArenas *arenas, AllocatorArenaStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->total.engine = arenas->engine;
+    stats->arenaCount = arenas->arenaCount;
+    for (int i = 0; i < arenas->arenaCount; i++) {
+        AllocatorStats arenaStats;
+        pthread_mutex_lock(&arenas->arenas[i].lock);
+        allocator_stats(arenas->arenas[i].heap, &arenaStats);
+        pthread_mutex_unlock(&arenas->arenas[i].lock);
+        stats->total.totalSize += arenaStats.totalSize;
+        stats->total.freeBytes += arenaStats.freeBytes;
+        if (arenaStats.largestFreeBlock > stats->total.largestFreeBlock)
+            stats->total.largestFreeBlock = arenaStats.largestFreeBlock;
+        stats->total.blockCount += arenaStats.blockCount;
+        stats->total.peakBlockCount += arenaStats.peakBlockCount;
+        stats->total.freeBlockCount += arenaStats.freeBlockCount;
+        stats->total.allocatedBlockCount += arenaStats.allocatedBlockCount;
+        for (int sizeClass = 0; sizeClass < ALLOCATOR_SIZE_CLASS_COUNT; sizeClass++)
+            stats->total.freeSizeHistogram[sizeClass] += arenaStats.freeSizeHistogram[sizeClass];
+        stats->total.internalFragmentation += arenaStats.internalFragmentation;
+        stats->total.unusableBytes += arenaStats.unusableBytes;
+        stats->total.granuleSize = arenaStats.granuleSize; // The same in every arena
+        stats->total.deferredReleases += arenaStats.deferredReleases;
+        stats->total.deferredMisses += arenaStats.deferredMisses;
+        stats->total.blocksMoved += arenaStats.blocksMoved;
+        stats->total.bytesMoved += arenaStats.bytesMoved;
+        stats->total.resizesInPlace += arenaStats.resizesInPlace;
+        stats->total.resizesMoved += arenaStats.resizesMoved;
+        stats->total.bytesCopied += arenaStats.bytesCopied;
+        stats->total.bytesRemapped += arenaStats.bytesRemapped;
+        stats->total.bytesDiscarded += arenaStats.bytesDiscarded;
+        stats->total.splits += arenaStats.splits;
+        stats->total.merges += arenaStats.merges;
+        stats->total.nodeAllocations += arenaStats.nodeAllocations;
+        stats->total.nodeReleases += arenaStats.nodeReleases;
+        stats->total.slabAllocations += arenaStats.slabAllocations;
+        stats->total.waitingRequests += arenaStats.waitingRequests;
+        stats->total.parkedRequests += arenaStats.parkedRequests;
+        stats->total.wokenRequests += arenaStats.wokenRequests;
+        stats->total.cancelledRequests += arenaStats.cancelledRequests;
+        stats->total.policySteps += arenaStats.policySteps;
+        stats->total.failureCompactions += arenaStats.failureCompactions;
+        for (int strategy = 0; strategy < ALLOCATOR_STRATEGY_COUNT; strategy++) {
+            stats->total.scans[strategy].requests += arenaStats.scans[strategy].requests;
+            stats->total.scans[strategy].nodesVisited += arenaStats.scans[strategy].nodesVisited;
+        }
+    }
+    stats->localAllocations = atomic_load(&arenas->localAllocations);
+    stats->fallbackAllocations = atomic_load(&arenas->fallbackAllocations);
+}
+
+/** Forwards an arena-local block to the caller's visitor with global addresses. */
+typedef struct ArenaVisit {
+    AllocatorBlockVisitor visitor;
+    void *context;
+    AllocatorSize base;
+} ArenaVisit;
+
+static void visitArenaBlock(const AllocatorBlock *block, void *context) {
+    const ArenaVisit *visit = (const ArenaVisit *)context;
+    AllocatorBlock global = *block;
+    global.startAddress += visit->base;
+    global.endAddress += visit->base;
+    visit->visitor(&global, visit->context);
+}
+
+void allocator_arenas_for_each_block(AllocatorArenas *arenas, AllocatorBlockVisitor visitor, void *context) {
+    for (int i = 0; i < arenas->arenaCount; i++) {
+        ArenaVisit visit = {visitor, context, arenas->arenas[i].base};
+        pthread_mutex_lock(&arenas->arenas[i].lock);
+        allocator_for_each_block(arenas->arenas[i].heap, visitArenaBlock, &visit);
+        pthread_mutex_unlock(&arenas->arenas[i].lock);
+    }
+}
@@ -0,0 +1,54 @@
+/**
+ * \file    allocator_arena.h
+ * \brief   Thread-safe multi-arena front end for the contiguous memory allocator.
+ *
+ * The address space [0, size - 1] is split into arenaCount equal arenas, each
+ * an independent Allocator with its own lock. A thread allocates from its home
+ * arena (assigned round-robin the first time the thread calls in) and falls
+ * back to the other arenas in order when the home arena cannot hold the
+ * request. A sharded process directory maps each process ID to the arena
+ * holding its block, so IDs stay unique across arenas and release goes straight
+ * to the right arena.
+ *
+ * Addresses reported here are global: arena-local addresses plus the arena's base.
+ */
+
+#ifndef ALLOCATOR_ARENA_H
+#define ALLOCATOR_ARENA_H
+
+#include "allocator.h"
+
+/** Counters across all arenas. */
+typedef struct AllocatorArenaStats {
+    AllocatorStats total;   // Every counter summed over arenas; largestFreeBlock is the largest in any arena
+    int arenaCount;
+    long long localAllocations;    // Allocations served by the calling thread's home arena
+    long long fallbackAllocations; // Allocations served by another arena
+} AllocatorArenaStats;
+
+typedef struct AllocatorArenas AllocatorArenas;
+
+/** Splits size bytes into arenaCount arenas (1 <= arenaCount <= size). Returns NULL on failure. */
+AllocatorArenas *allocator_arenas_create(AllocatorSize size, int arenaCount, AllocatorEngine engine);
+
+/** Releases every arena. No other thread may be using the arenas. */
+void allocator_arenas_destroy(AllocatorArenas *arenas);
+
+/** Allocates size bytes for processId (non-empty), trying the calling thread's home arena first.
+ *  On ALLOCATOR_OK, block->owner points at the caller's processId. */
+AllocatorStatus allocator_arenas_allocate(AllocatorArenas *arenas, const char *processId, AllocatorSize size,
+                                          AllocatorStrategy strategy, AllocatorBlock *block);
+
+/** Releases the block owned by processId, whichever arena holds it. */
+AllocatorStatus allocator_arenas_release(AllocatorArenas *arenas, const char *processId);
+
+/** Compacts each arena in turn; blocks never move between arenas. */
+void allocator_arenas_compact(AllocatorArenas *arenas);
+
+/** Fills *stats with counters summed over all arenas. */
+void allocator_arenas_stats(AllocatorArenas *arenas, AllocatorArenaStats *stats);
+
+/** Visits every block in global address order, holding one arena lock at a time. */
+void allocator_arenas_for_each_block(AllocatorArenas *arenas, AllocatorBlockVisitor visitor, void *context);
+
+#endif /* ALLOCATOR_ARENA_H */
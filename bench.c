@@ -0,0 +1,415 @@
+/**
+ * \file    bench.c
+ * \brief   Benchmark harness comparing allocation strategies on synthetic workloads.
+ *
+ * Links against the allocator library (allocator.c) and replays the same
+ * seeded trace against every strategy on a fresh heap, printing one CSV row per
+ * (workload, strategy) pair:
+ *   - ops/sec and p50/p99 per-operation latency
+ *   - nodes visited per allocation, peak block count
+ *   - allocation failures and external fragmentation
+ *
+ * The array_* strategies run the same placements on the array engine, so each pair of
+ * rows compares the linked list head to head with the packed arrays.
+ * The bitmap_* strategies run them on the bitmap engine with its default 16-byte granules.
+ *
+ * The dense workload (run only when named) keeps millions of small blocks live on a
+ * multi-GB heap to show how the size index and process table scale; pair it with
+ * --strategy to skip the linear-scan strategies, e.g.
+ *   ./bench --workload dense --heap 4294967296 --ops 8000000 --strategy best_fit,segregated_fit
+ *
+ * Compile: gcc -O2 -o bench bench.c allocator.c
+ * Run: ./bench [--ops <n>] [--heap <bytes>] [--seed <n>] [--workload <name>|all]
+ *              [--strategy <name>[,<name>...]|all]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include "allocator.h"
+
+#define FRAGMENTATION_SAMPLE_INTERVAL 1024 // Operations between fragmentation samples
+#define PROCESS_ID_SIZE ALLOCATOR_PROCESS_ID_SIZE
+
+/** One trace operation: allocate size bytes for id, or release id. */
+typedef struct BenchOp {
+    int isRelease;
+    int id;
+    AllocatorSize size;
+} BenchOp;
+
+/** A generated trace plus the process names it refers to. */
+typedef struct BenchTrace {
+    BenchOp *ops;
+    int opCount;
+    char (*names)[PROCESS_ID_SIZE];
+    int nameCount;
+} BenchTrace;
+
+/** A strategy under test: a placement strategy on a given engine. */
+typedef struct BenchStrategy {
+    const char *name;
+    AllocatorEngine engine;
+    AllocatorStrategy strategy;
+} BenchStrategy;
+
+/** A workload generator: fills ops for a heap of heapSize bytes. */
+typedef struct BenchWorkload {
+    const char *name;
+    void (*generate)(BenchTrace *trace, AllocatorSize heapSize, unsigned long long seed);
+    int explicitOnly; // Skipped by --workload all: sized for multi-GB heaps
+} BenchWorkload;
+
+/** xorshift64* generator state; every workload seeds its own. */
+unsigned long long benchRandomState;
+
+/** Returns the next pseudo-random 64-bit value. */
+unsigned long long benchRandom() {
+    benchRandomState ^= benchRandomState >> 12;
+    benchRandomState ^= benchRandomState << 25;
+    benchRandomState ^= benchRandomState >> 27;
+    return benchRandomState * 2685821657736338717ull;
+}
+
+/** Returns a pseudo-random integer in [low, high]. */
+AllocatorSize benchRandomRange(AllocatorSize low, AllocatorSize high) {
+    return low + (AllocatorSize)(benchRandom() % (unsigned long long)(high - low + 1));
+}
+
+/** Returns a monotonic timestamp in nanoseconds. */
+long long benchNanos() {
+    struct timespec now;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (long long)now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+/** Appends an allocation of a fresh process ID and returns that ID. */
+int traceAllocate(BenchTrace *trace, AllocatorSize size) {
+    int id = trace->nameCount++;
+    snprintf(trace->names[id], PROCESS_ID_SIZE, "p%d", id);
+    trace->ops[trace->opCount++] = (BenchOp){0, id, size};
+    return id;
+}
+
+/** Appends a release of id. */
+void traceRelease(BenchTrace *trace, int id) {
+    trace->ops[trace->opCount++] = (BenchOp){1, id, 0};
+}
+
+/** Live set used while generating: IDs and requested sizes, with O(1) random removal. */
+typedef struct LiveSet {
+    int *ids;
+    AllocatorSize *sizes;
+    int count;
+    AllocatorSize bytes;
+} LiveSet;
+
+/** Removes and returns a random live ID. */
+int liveSetTakeRandom(LiveSet *live) {
+    int index = (int)benchRandomRange(0, live->count - 1);
+    int id = live->ids[index];
+    live->bytes -= live->sizes[index];
+    live->count--;
+    live->ids[index] = live->ids[live->count];
+    live->sizes[index] = live->sizes[live->count];
+    return id;
+}
+
+/** Adds an ID to the live set. */
+void liveSetAdd(LiveSet *live, int id, AllocatorSize size) {
+    live->ids[live->count] = id;
+    live->sizes[live->count] = size;
+    live->count++;
+    live->bytes += size;
+}
+
+/** Steady-state churn keeping ~85% of the heap requested; sizes drawn by pickSize. */
+void generateSteadyState(BenchTrace *trace, AllocatorSize heapSize, AllocatorSize (*pickSize)(AllocatorSize heapSize)) {
+    LiveSet live = {(int *)malloc(trace->opCount * sizeof(int)),
+                    (AllocatorSize *)malloc(trace->opCount * sizeof(AllocatorSize)), 0, 0};
+    int target = trace->opCount;
+    trace->opCount = 0;
+    while (trace->opCount < target) {
+        if (live.count > 0 && (live.bytes > heapSize * 0.85 || (benchRandom() & 1))) {
+            traceRelease(trace, liveSetTakeRandom(&live));
+        } else {
+            AllocatorSize size = pickSize(heapSize);
+            liveSetAdd(&live, traceAllocate(trace, size), size);
+        }
+    }
+    free(live.ids);
+    free(live.sizes);
+}
+
+/** Fills ~85% of the heap (or half the op budget) with small blocks, then churns it by
+ *  replacing one random live block per pair of operations, so the live count stays high. */
+void generateFillAndChurn(BenchTrace *trace, AllocatorSize heapSize, AllocatorSize (*pickSize)(AllocatorSize heapSize)) {
+    LiveSet live = {(int *)malloc(trace->opCount * sizeof(int)),
+                    (AllocatorSize *)malloc(trace->opCount * sizeof(AllocatorSize)), 0, 0};
+    int target = trace->opCount;
+    trace->opCount = 0;
+    while (trace->opCount < target / 2 && live.bytes < heapSize * 0.85) {
+        AllocatorSize size = pickSize(heapSize);
+        liveSetAdd(&live, traceAllocate(trace, size), size);
+    }
+    while (trace->opCount < target) {
+        if (live.count > 0 && (trace->opCount & 1)) {
+            traceRelease(trace, liveSetTakeRandom(&live));
+        } else {
+            AllocatorSize size = pickSize(heapSize);
+            liveSetAdd(&live, traceAllocate(trace, size), size);
+        }
+    }
+    free(live.ids);
+    free(live.sizes);
+}
+
+/** Uniform sizes between 1 and heap/512 bytes. */
+AllocatorSize pickUniformSize(AllocatorSize heapSize) {
+    return benchRandomRange(1, heapSize / 512 > 1 ? heapSize / 512 : 1);
+}
+
+/** Mostly small requests with occasional large ones, 90/10. */
+AllocatorSize pickBimodalSize(AllocatorSize heapSize) {
+    AllocatorSize small = heapSize / 8192 > 8 ? heapSize / 8192 : 8;
+    if (benchRandomRange(1, 10) <= 9)
+        return benchRandomRange(1, small);
+    return benchRandomRange(small * 16, small * 64);
+}
+
+/** Small sizes independent of the heap size, 16 to 1024 bytes, so big heaps hold millions of blocks. */
+AllocatorSize pickDenseSize(AllocatorSize heapSize) {
+    (void)heapSize;
+    return benchRandomRange(16, 1024);
+}
+
+/** Workload: uniform sizes under steady churn. */
+void generateUniform(BenchTrace *trace, AllocatorSize heapSize, unsigned long long seed) {
+    benchRandomState = seed;
+    generateSteadyState(trace, heapSize, pickUniformSize);
+}
+
+/** Workload: bimodal sizes under steady churn. */
+void generateBimodal(BenchTrace *trace, AllocatorSize heapSize, unsigned long long seed) {
+    benchRandomState = seed;
+    generateSteadyState(trace, heapSize, pickBimodalSize);
+}
+
+/** Workload: millions of small live blocks when the heap is large; fill, then churn. */
+void generateDense(BenchTrace *trace, AllocatorSize heapSize, unsigned long long seed) {
+    benchRandomState = seed;
+    generateFillAndChurn(trace, heapSize, pickDenseSize);
+}
+
+/** Workload: 80% short-lived processes (freed within ~64 ops) mixed with 20% long-lived
+ *  ones (freed after thousands of ops), so long-lived blocks pin the heap. */
+void generateLifetimes(BenchTrace *trace, AllocatorSize heapSize, unsigned long long seed) {
+    benchRandomState = seed;
+    int target = trace->opCount;
+    int horizon = target + 1;
+    // Releases bucketed by the step they are due at, chained through nextDue.
+    int *dueHead = (int *)malloc(horizon * sizeof(int));
+    int *nextDue = (int *)malloc(target * sizeof(int));
+    for (int step = 0; step < horizon; step++)
+        dueHead[step] = -1;
+    trace->opCount = 0;
+    for (int step = 0; step < horizon && trace->opCount < target; step++) {
+        for (int id = dueHead[step]; id >= 0 && trace->opCount < target; id = nextDue[id])
+            traceRelease(trace, id);
+        if (trace->opCount >= target)
+            break;
+        int id = traceAllocate(trace, pickUniformSize(heapSize));
+        int longLived = benchRandomRange(1, 5) == 1;
+        int due = step + (longLived ? benchRandomRange(2000, 20000) : benchRandomRange(1, 64));
+        if (due < horizon) {
+            nextDue[id] = dueHead[due];
+            dueHead[due] = id;
+        }
+    }
+    free(dueHead);
+    free(nextDue);
+}
+
+/** Workload: fill to ~95% of the heap, release ~80% of it at random, repeat. */
+void generateSawtooth(BenchTrace *trace, AllocatorSize heapSize, unsigned long long seed) {
+    benchRandomState = seed;
+    LiveSet live = {(int *)malloc(trace->opCount * sizeof(int)),
+                    (AllocatorSize *)malloc(trace->opCount * sizeof(AllocatorSize)), 0, 0};
+    int target = trace->opCount;
+    trace->opCount = 0;
+    while (trace->opCount < target) {
+        while (trace->opCount < target && live.bytes < heapSize * 0.95) {
+            AllocatorSize size = pickUniformSize(heapSize);
+            liveSetAdd(&live, traceAllocate(trace, size), size);
+        }
+        while (trace->opCount < target && live.bytes > heapSize * 0.15)
+            traceRelease(trace, liveSetTakeRandom(&live));
+    }
+    free(live.ids);
+    free(live.sizes);
+}
+
+/** Returns external fragmentation: 1 - largest free block / total free space. */
+double externalFragmentation(Allocator *allocator) {
+    AllocatorStats stats;
+    allocator_stats(allocator, &stats);
+    return stats.freeBytes > 0 ? 1.0 - (double)stats.largestFreeBlock / stats.freeBytes : 0.0;
+}
+
+/** Orders latency samples for percentile lookup. */
+int compareLatency(const void *a, const void *b) {
+    int left = *(const int *)a, right = *(const int *)b;
+    return (left > right) - (left < right);
+}
+
+/** Replays trace against one strategy and prints its CSV row. */
+void runStrategy(const BenchTrace *trace, const char *workloadName, const BenchStrategy *strategy,
+                 AllocatorSize heapSize, unsigned long long seed, int *latencies) {
+    Allocator *allocator = allocator_create(heapSize, strategy->engine);
+    if (!allocator) {
+        fprintf(stderr, "Error: Cannot create a %lld-byte heap for %s.\n", heapSize, strategy->name);
+        exit(EXIT_FAILURE);
+    }
+
+    long long allocationFailures = 0, releaseMisses = 0;
+    double fragmentationSum = 0;
+    long long fragmentationSamples = 0;
+    long long startTime = benchNanos();
+    for (int i = 0; i < trace->opCount; i++) {
+        const BenchOp *op = &trace->ops[i];
+        long long opStart = benchNanos();
+        if (op->isRelease) {
+            releaseMisses += allocator_release(allocator, trace->names[op->id]) != ALLOCATOR_OK;
+        } else {
+            allocationFailures += allocator_allocate(allocator, trace->names[op->id], op->size,
+                                                     strategy->strategy, NULL) != ALLOCATOR_OK;
+        }
+        long long elapsed = benchNanos() - opStart;
+        latencies[i] = elapsed > INT_MAX ? INT_MAX : (int)elapsed;
+
+        if (i % FRAGMENTATION_SAMPLE_INTERVAL == 0) {
+            fragmentationSum += externalFragmentation(allocator);
+            fragmentationSamples++;
+        }
+    }
+    double totalSeconds = (benchNanos() - startTime) / 1e9;
+    AllocatorStats stats;
+    allocator_stats(allocator, &stats);
+    const AllocatorScanStats *scan = &stats.scans[strategy->strategy];
+    double finalFragmentation = externalFragmentation(allocator);
+    double nodesPerAllocation = scan->requests ? (double)scan->nodesVisited / scan->requests : 0.0;
+
+    qsort(latencies, trace->opCount, sizeof(int), compareLatency);
+    printf("%s,%s,%llu,%d,%.0f,%d,%d,%.2f,%d,%lld,%lld,%.4f,%.4f\n",
+           workloadName, strategy->name, seed, trace->opCount,
+           totalSeconds > 0 ? trace->opCount / totalSeconds : 0.0,
+           latencies[trace->opCount / 2], latencies[(int)(trace->opCount * 0.99)],
+           nodesPerAllocation, stats.peakBlockCount, allocationFailures, releaseMisses,
+           fragmentationSamples ? fragmentationSum / fragmentationSamples : 0.0, finalFragmentation);
+    fflush(stdout);
+    allocator_destroy(allocator);
+}
+
+/** Returns 1 if filter is "all" or lists name among its comma-separated entries. */
+int filterIncludes(const char *filter, const char *name) {
+    if (strcmp(filter, "all") == 0)
+        return 1;
+    size_t length = strlen(name);
+    for (const char *entry = filter; entry; entry = strchr(entry, ',') ? strchr(entry, ',') + 1 : NULL) {
+        if (strncmp(entry, name, length) == 0 && (entry[length] == ',' || entry[length] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+/** Main function: parses options, generates each workload once and runs every strategy on it. */
+int main(int argc, char *argv[]) {
+    int opCount = 200000;
+    AllocatorSize heapSize = 1 << 24;
+    unsigned long long seed = 42;
+    const char *workloadFilter = "all";
+    const char *strategyFilter = "all";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+            opCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--heap") == 0 && i + 1 < argc) {
+            heapSize = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+            workloadFilter = argv[++i];
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            strategyFilter = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--ops <n>] [--heap <bytes>] [--seed <n>] [--workload <name>|all]"
+                            " [--strategy <name>[,<name>...]|all]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (opCount <= 0 || heapSize <= 1) {
+        fprintf(stderr, "Error: --ops and --heap must be positive.\n");
+        return EXIT_FAILURE;
+    }
+
+    const BenchWorkload workloads[] = {
+        {"uniform", generateUniform, 0},
+        {"bimodal", generateBimodal, 0},
+        {"lifetimes", generateLifetimes, 0},
+        {"sawtooth", generateSawtooth, 0},
+        {"dense", generateDense, 1},
+    };
+    const BenchStrategy strategies[] = {
+        {"first_fit", ALLOCATOR_ENGINE_LIST, ALLOCATOR_FIRST_FIT},
+        {"next_fit", ALLOCATOR_ENGINE_LIST, ALLOCATOR_NEXT_FIT},
+        {"best_fit", ALLOCATOR_ENGINE_LIST, ALLOCATOR_BEST_FIT},
+        {"worst_fit", ALLOCATOR_ENGINE_LIST, ALLOCATOR_WORST_FIT},
+        {"segregated_fit", ALLOCATOR_ENGINE_LIST, ALLOCATOR_SEGREGATED_FIT},
+        {"buddy", ALLOCATOR_ENGINE_BUDDY, ALLOCATOR_FIRST_FIT},
+        {"array_first_fit", ALLOCATOR_ENGINE_ARRAY, ALLOCATOR_FIRST_FIT},
+        {"array_next_fit", ALLOCATOR_ENGINE_ARRAY, ALLOCATOR_NEXT_FIT},
+        {"array_best_fit", ALLOCATOR_ENGINE_ARRAY, ALLOCATOR_BEST_FIT},
+        {"array_worst_fit", ALLOCATOR_ENGINE_ARRAY, ALLOCATOR_WORST_FIT},
+        {"array_segregated_fit", ALLOCATOR_ENGINE_ARRAY, ALLOCATOR_SEGREGATED_FIT},
+        {"bitmap_first_fit", ALLOCATOR_ENGINE_BITMAP, ALLOCATOR_FIRST_FIT},
+        {"bitmap_next_fit", ALLOCATOR_ENGINE_BITMAP, ALLOCATOR_NEXT_FIT},
+        {"bitmap_best_fit", ALLOCATOR_ENGINE_BITMAP, ALLOCATOR_BEST_FIT},
+        {"bitmap_worst_fit", ALLOCATOR_ENGINE_BITMAP, ALLOCATOR_WORST_FIT},
+        {"bitmap_segregated_fit", ALLOCATOR_ENGINE_BITMAP, ALLOCATOR_SEGREGATED_FIT},
+    };
+
+    BenchTrace trace;
+    trace.ops = (BenchOp *)malloc(opCount * sizeof(BenchOp));
+    trace.names = (char (*)[PROCESS_ID_SIZE])malloc(opCount * sizeof(*trace.names));
+    int *latencies = (int *)malloc(opCount * sizeof(int));
+    if (!trace.ops || !trace.names || !latencies) {
+        fprintf(stderr, "Error: Memory allocation failed for %d operations.\n", opCount);
+        return EXIT_FAILURE;
+    }
+
+    printf("workload,strategy,seed,ops,ops_per_sec,p50_ns,p99_ns,nodes_per_alloc,peak_blocks,"
+           "alloc_failures,release_misses,ext_frag_mean,ext_frag_final\n");
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        if (strcmp(workloadFilter, "all") == 0 ? workloads[w].explicitOnly
+                                               : !filterIncludes(workloadFilter, workloads[w].name))
+            continue;
+        trace.opCount = opCount;
+        trace.nameCount = 0;
+        workloads[w].generate(&trace, heapSize, seed);
+        for (size_t s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++)
+            if (filterIncludes(strategyFilter, strategies[s].name))
+                runStrategy(&trace, workloads[w].name, &strategies[s], heapSize, seed, latencies);
+    }
+
+    free(trace.ops);
+    free(trace.names);
+    free(latencies);
+    return EXIT_SUCCESS;
+}
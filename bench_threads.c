@@ -0,0 +1,317 @@
+/**
+ * \file    bench_threads.c
+ * \brief   Multi-threaded scaling benchmark for the multi-arena allocator.
+ *
+ * For each thread count (1, 2, 4, ... up to --threads-max) every thread churns
+ * its own pool of process IDs: pick a random slot, allocate it if empty,
+ * release it otherwise. Each count runs twice, against a single arena (one lock
+ * shared by every thread) and against one arena per thread, and prints a CSV
+ * row per run with aggregate ops/sec and how often allocation fell back to a
+ * foreign arena.
+ *
+ * With --release-bench it instead measures the release path: one owner thread
+ * allocates batches and producer threads release them, either through the
+ * lock-free deferred release queue or by calling allocator_release under a
+ * mutex shared with the owner.
+ *
+ * Compile: gcc -O2 -pthread -o bench_threads bench_threads.c allocator_arena.c allocator.c
+ * Run: ./bench_threads [--threads-max <n>] [--ops <n per thread>] [--heap <bytes>]
+ *                      [--slots <n per thread>] [--strategy F|N|B|W|S] [--seed <n>]
+ *      ./bench_threads --release-bench [--threads-max <n>] [--ops <n per thread>] [--slots <batch>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "allocator_arena.h"
+
+#define MAX_THREADS 256
+
+/** Per-thread workload parameters and results. */
+typedef struct WorkerState {
+    AllocatorArenas *arenas;
+    AllocatorStrategy strategy;
+    int threadIndex;
+    int opCount;
+    int slotCount;
+    int maxSize;
+    unsigned long long randomState;  // xorshift64* state, seeded per thread
+    long long allocationFailures;
+} WorkerState;
+
+/** Returns the next pseudo-random 64-bit value for one worker. */
+unsigned long long workerRandom(WorkerState *worker) {
+    worker->randomState ^= worker->randomState >> 12;
+    worker->randomState ^= worker->randomState << 25;
+    worker->randomState ^= worker->randomState >> 27;
+    return worker->randomState * 2685821657736338717ull;
+}
+
+/** Returns a monotonic timestamp in nanoseconds. */
+long long benchNanos() {
+    struct timespec now;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (long long)now.tv_sec * 1000000000ll + now.tv_nsec;
+}
+
+/** Thread body: churns the worker's slots, then releases whatever is still live. */
+void *runWorker(void *argument) {
+    WorkerState *worker = (WorkerState *)argument;
+    char *live = (char *)calloc(worker->slotCount, 1);
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    if (!live)
+        return NULL;
+    for (int i = 0; i < worker->opCount; i++) {
+        int slot = (int)(workerRandom(worker) % (unsigned long long)worker->slotCount);
+        snprintf(processId, sizeof(processId), "t%ds%d", worker->threadIndex, slot);
+        if (live[slot]) {
+            allocator_arenas_release(worker->arenas, processId);
+            live[slot] = 0;
+        } else {
+            int size = 1 + (int)(workerRandom(worker) % (unsigned long long)worker->maxSize);
+            if (allocator_arenas_allocate(worker->arenas, processId, size, worker->strategy, NULL) == ALLOCATOR_OK)
+                live[slot] = 1;
+            else
+                worker->allocationFailures++;
+        }
+    }
+    for (int slot = 0; slot < worker->slotCount; slot++) {
+        if (live[slot]) {
+            snprintf(processId, sizeof(processId), "t%ds%d", worker->threadIndex, slot);
+            allocator_arenas_release(worker->arenas, processId);
+        }
+    }
+    free(live);
+    return NULL;
+}
+
+/** Runs one configuration and prints its CSV row. Returns 0 if setup failed. */
+int runConfiguration(const char *mode, int threadCount, int arenaCount, AllocatorSize heapSize, int opCount,
+                     int slotCount, int maxSize, AllocatorStrategy strategy, unsigned long long seed) {
+    AllocatorArenas *arenas = allocator_arenas_create(heapSize, arenaCount, ALLOCATOR_ENGINE_LIST);
+    if (!arenas) {
+        fprintf(stderr, "Error: Cannot create %d arenas over %lld bytes.\n", arenaCount, heapSize);
+        return 0;
+    }
+    WorkerState workers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    for (int t = 0; t < threadCount; t++) {
+        workers[t] = (WorkerState){arenas, strategy, t, opCount, slotCount, maxSize,
+                                   seed * 0x9E3779B97F4A7C15ull + t + 1, 0};
+    }
+
+    long long startTime = benchNanos();
+    int started = 0;
+    for (; started < threadCount; started++) {
+        if (pthread_create(&threads[started], NULL, runWorker, &workers[started]) != 0)
+            break;
+    }
+    for (int t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+    double seconds = (benchNanos() - startTime) / 1e9;
+
+    AllocatorArenaStats stats;
+    allocator_arenas_stats(arenas, &stats);
+    long long failures = 0;
+    for (int t = 0; t < started; t++)
+        failures += workers[t].allocationFailures;
+    long long totalOps = (long long)opCount * started;
+    printf("%s,%d,%d,%lld,%.3f,%.0f,%lld,%lld\n", mode, started, arenaCount, totalOps, seconds,
+           seconds > 0 ? totalOps / seconds : 0.0, failures, stats.fallbackAllocations);
+    fflush(stdout);
+    allocator_arenas_destroy(arenas);
+    return started == threadCount;
+}
+
+/** Shared state for the release benchmark. */
+typedef struct ReleaseBench {
+    Allocator *heap;
+    pthread_mutex_t lock;       // Serialises heap access in locked mode
+    int deferred;               // 1: producers push handles; 0: producers call allocator_release
+    int producerCount;
+    int batch;                  // Handles released per producer per round
+    AllocatorHandle *handles;   // producerCount * batch handles for the current round
+    char (*names)[ALLOCATOR_PROCESS_ID_SIZE]; // Process ID behind each handle slot
+    atomic_int round;           // Published by the owner; producers start when it advances
+    atomic_int finished;        // Producers done with the current round
+    int rounds;
+    atomic_llong releaseNanos;  // Producer time spent releasing, summed
+} ReleaseBench;
+
+/** One producer of the release benchmark. */
+typedef struct ReleaseProducer {
+    ReleaseBench *bench;
+    int index;
+} ReleaseProducer;
+
+/** Producer body: waits for each round, then releases its slice of the round's handles. */
+void *runReleaseProducer(void *argument) {
+    ReleaseProducer *producer = (ReleaseProducer *)argument;
+    ReleaseBench *bench = producer->bench;
+    for (int round = 1; round <= bench->rounds; round++) {
+        while (atomic_load(&bench->round) < round)
+            sched_yield();
+        int first = producer->index * bench->batch;
+        long long start = benchNanos();
+        for (int i = first; i < first + bench->batch; i++) {
+            if (bench->deferred) {
+                while (allocator_release_deferred(bench->heap, bench->handles[i]) != ALLOCATOR_OK)
+                    sched_yield(); // Ring full: wait for the owner to drain
+            } else {
+                pthread_mutex_lock(&bench->lock);
+                allocator_release(bench->heap, bench->names[i]);
+                pthread_mutex_unlock(&bench->lock);
+            }
+        }
+        atomic_fetch_add(&bench->releaseNanos, benchNanos() - start);
+        atomic_fetch_add(&bench->finished, 1);
+    }
+    return NULL;
+}
+
+/** Runs the release benchmark for one mode and producer count and prints its CSV row. */
+int runReleaseBench(const char *mode, int deferred, int producerCount, int batch, int rounds, AllocatorSize heapSize) {
+    ReleaseBench bench;
+    bench.heap = allocator_create(heapSize, ALLOCATOR_ENGINE_LIST);
+    bench.handles = (AllocatorHandle *)malloc((size_t)producerCount * batch * sizeof(AllocatorHandle));
+    bench.names = (char (*)[ALLOCATOR_PROCESS_ID_SIZE])malloc((size_t)producerCount * batch * sizeof(*bench.names));
+    if (!bench.heap || !bench.handles || !bench.names ||
+        (deferred && allocator_enable_deferred_release(bench.heap, producerCount * batch) != ALLOCATOR_OK)) {
+        fprintf(stderr, "Error: Cannot set up the release benchmark.\n");
+        return 0;
+    }
+    for (int i = 0; i < producerCount * batch; i++)
+        snprintf(bench.names[i], sizeof(bench.names[i]), "r%d", i);
+    pthread_mutex_init(&bench.lock, NULL);
+    bench.deferred = deferred;
+    bench.producerCount = producerCount;
+    bench.batch = batch;
+    bench.rounds = rounds;
+    atomic_init(&bench.round, 0);
+    atomic_init(&bench.finished, 0);
+    atomic_init(&bench.releaseNanos, 0);
+
+    ReleaseProducer producers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    for (int t = 0; t < producerCount; t++) {
+        producers[t] = (ReleaseProducer){&bench, t};
+        if (pthread_create(&threads[t], NULL, runReleaseProducer, &producers[t]) != 0) {
+            fprintf(stderr, "Error: Cannot start %d producer threads.\n", producerCount);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    long long drainNanos = 0;
+    for (int round = 1; round <= rounds; round++) {
+        if (deferred) {
+            long long start = benchNanos();
+            allocator_drain_releases(bench.heap);
+            drainNanos += benchNanos() - start;
+        }
+        for (int i = 0; i < producerCount * batch; i++) {
+            AllocatorBlock block;
+            pthread_mutex_lock(&bench.lock);
+            AllocatorStatus status = allocator_allocate(bench.heap, bench.names[i], 64, ALLOCATOR_BEST_FIT, &block);
+            pthread_mutex_unlock(&bench.lock);
+            bench.handles[i] = status == ALLOCATOR_OK ? block.handle : -1;
+        }
+        atomic_store(&bench.round, round);
+        while (atomic_load(&bench.finished) < round * producerCount)
+            sched_yield();
+    }
+    for (int t = 0; t < producerCount; t++)
+        pthread_join(threads[t], NULL);
+    if (deferred) {
+        long long start = benchNanos();
+        allocator_drain_releases(bench.heap);
+        drainNanos += benchNanos() - start;
+    }
+
+    long long releases = (long long)rounds * producerCount * batch;
+    printf("%s,%d,%lld,%.1f,%.1f\n", mode, producerCount, releases,
+           (double)atomic_load(&bench.releaseNanos) / releases, deferred ? (double)drainNanos / releases : 0.0);
+    fflush(stdout);
+    pthread_mutex_destroy(&bench.lock);
+    free(bench.handles);
+    free(bench.names);
+    allocator_destroy(bench.heap);
+    return 1;
+}
+
+/** Main function: parses options and sweeps thread counts for both modes. */
+int main(int argc, char *argv[]) {
+    int threadsMax = 32;
+    int opCount = 200000;
+    AllocatorSize heapSize = 1 << 26;
+    int slotCount = 512;
+    int maxSize = 1024;
+    unsigned long long seed = 42;
+    AllocatorStrategy strategy = ALLOCATOR_BEST_FIT;
+    int releaseBench = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads-max") == 0 && i + 1 < argc) {
+            threadsMax = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+            opCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--heap") == 0 && i + 1 < argc) {
+            heapSize = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--slots") == 0 && i + 1 < argc) {
+            slotCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--release-bench") == 0) {
+            releaseBench = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc &&
+                   strlen(argv[i + 1]) == 1 && allocator_parse_strategy(argv[i + 1][0], &strategy)) {
+            i++;
+        } else {
+            fprintf(stderr, "Usage: %s [--threads-max <n>] [--ops <n>] [--heap <bytes>] [--slots <n>] "
+                            "[--strategy F|N|B|W|S] [--seed <n>]\n"
+                            "       %s --release-bench [--threads-max <n>] [--ops <n>] [--slots <batch>]\n",
+                    argv[0], argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (threadsMax < 1 || threadsMax > MAX_THREADS || opCount <= 0 || slotCount <= 0 || heapSize < threadsMax) {
+        fprintf(stderr, "Error: Need 1 <= --threads-max <= %d, positive --ops/--slots and --heap >= threads.\n",
+                MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+
+    if (releaseBench) {
+        int rounds = opCount / slotCount > 0 ? opCount / slotCount : 1;
+        printf("mode,producers,releases,release_ns_mean,drain_ns_per_release\n");
+        for (int threads = 1;; threads *= 2) {
+            if (threads > threadsMax)
+                threads = threadsMax;
+            if (!runReleaseBench("locked", 0, threads, slotCount, rounds, heapSize) ||
+                !runReleaseBench("deferred", 1, threads, slotCount, rounds, heapSize))
+                return EXIT_FAILURE;
+            if (threads == threadsMax)
+                break;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    printf("mode,threads,arenas,ops,seconds,ops_per_sec,alloc_failures,fallbacks\n");
+    for (int threads = 1;; threads *= 2) {
+        if (threads > threadsMax)
+            threads = threadsMax; // Always finish on the requested maximum
+        if (!runConfiguration("single_lock", threads, 1, heapSize, opCount, slotCount, maxSize, strategy, seed) ||
+            !runConfiguration("arenas", threads, threads, heapSize, opCount, slotCount, maxSize, strategy, seed))
+            return EXIT_FAILURE;
+        if (threads == threadsMax)
+            break;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,285 +1,1596 @@
 /**
  * \file    contiguous_memory_allocator.c
- * \brief   Simulates a contiguous memory allocator with allocation strategies.
+ * \brief   Command-line front end for the contiguous memory allocator.
  *
  * Supports:
- *   - Memory allocation (First Fit, Best Fit, Worst Fit)
+ *   - Memory allocation (First Fit, Next Fit, Best Fit, Worst Fit, Segregated Fit)
  *   - Memory release
- *   - Memory compaction
+ *   - Bulk allocation and release of many processes in one pass
+ *   - Resizing in place, or by moving the block when it cannot grow where it is
+ *   - Waiting for space: a request that does not fit parks until a release makes room
+ *   - Memory compaction, on demand or automatically once free space fragments (--auto-compact)
  *   - Status reporting
+ *   - Saving the block layout to a snapshot file and loading it back (SAVE/LOAD)
+ *   - Optional per-command latency histograms and engine counters (PERF)
+ *   - Recording commands to a compact binary trace and replaying it at full speed
  *
- * Compile: gcc -o allocator contiguous_memory_allocator.c
- * Run: ./allocator <initial_memory_size>
+ * The allocator itself lives in allocator.c behind allocator.h; this file only
+ * parses commands and turns AllocatorStatus codes into messages.
+ *
+ * Compile: gcc -o allocator contiguous_memory_allocator.c allocator.c
+ * Run: ./allocator <initial_memory_size> [--engine list|buddy|array|bitmap] [--granule <bytes>] [--backed]
+ *                  [--wait-policy fifo|priority] [--auto-compact <percent> [--compact-interval <ops>]
+ *                  [--compact-budget <blocks>]] [--perf <json_file>]
+ *      ./allocator <initial_memory_size> --batch <command_file> [--stat-every <n>] [--perf <json_file>]
+ *      ./allocator [<initial_memory_size>] --replay <trace_file> [--strategy F|N|B|W|S] [--perf <json_file>]
+ *      Any mode also takes --record <trace_file> to capture the commands it runs.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdarg.h>
+#include <time.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "allocator.h"
 
 #define FREE_LABEL "FREE"   // Label for free memory blocks
+#define PROCESS_ID_SIZE ALLOCATOR_PROCESS_ID_SIZE
+#define LATENCY_SUB_BUCKET_BITS 4 // 16 linear buckets per power of two: values within 1/16
+#define LATENCY_BUCKET_COUNT ((64 - LATENCY_SUB_BUCKET_BITS) << LATENCY_SUB_BUCKET_BITS)
+#define TRACE_MAGIC "CMAT"        // First bytes of a --record trace
+#define TRACE_VERSION 1
 
-typedef struct Node {
-    int availableSpace;   // Size of the block
-    int startAddress;     // Start address of the block
-    int endAddress;       // End address of the block
-    struct Node *next;    // Next block in the list
-    char processId[100];  // Process ID or FREE if unallocated
-} Node;
-
-// Global memory management variables
-Node *dummyHead;      // Tracks total free space
-Node *initialBlock;   // Initial free memory block
-Node *current;        // Temporary pointer for traversal
-int lastAddressSpace; // Maximum address (initial memory size - 1)
-
-/** Creates a new free block for leftover space after allocation. */
-void createFreeBlock(int spaceAllocated, int leftoverSpace) {
-    Node *newFreeBlock = (Node *)malloc(sizeof(Node));
-    if (!newFreeBlock) {
-        fprintf(stderr, "Error: Memory allocation failed.\n");
-        exit(EXIT_FAILURE);
-    }
-    strcpy(newFreeBlock->processId, FREE_LABEL);
-    newFreeBlock->availableSpace = leftoverSpace;
-    newFreeBlock->startAddress = current->next->endAddress + 1;
-    newFreeBlock->endAddress = newFreeBlock->startAddress + leftoverSpace - 1;
-    if (newFreeBlock->endAddress > lastAddressSpace)
-        newFreeBlock->endAddress = lastAddressSpace;
-    newFreeBlock->next = current->next->next;
-    current->next->next = newFreeBlock;
-}
-
-/** Merges adjacent free blocks into a single larger block. */
-void mergeFreeBlocks() {
-    current = dummyHead;
-    while (current && current->next) {
-        if (strcmp(current->processId, FREE_LABEL) == 0 &&
-            strcmp(current->next->processId, FREE_LABEL) == 0) {
-            current->endAddress = current->next->endAddress;
-            current->availableSpace += current->next->availableSpace;
-            Node *tempNode = current->next;
-            current->next = current->next->next;
-            free(tempNode);
-        } else {
-            current = current->next;
+Allocator *heap;              // The heap driven by this session
+AllocatorEngine activeEngine = ALLOCATOR_ENGINE_LIST;
+int verboseOutput = 1;        // Per-operation messages; cleared in batch mode
+int perfEnabled = 0;          // Time every allocator call (--perf)
+int backedHeap = 0;           // Heap (and any LOADed one) backed by a real buffer (--backed)
+AllocatorWaitPolicy waitPolicy = ALLOCATOR_WAIT_FIFO; // Order RQW requests are woken in (--wait-policy)
+AllocatorCompactionPolicy compactionPolicy = {0, 8, 0, 16, 0}; // Off unless --auto-compact is given
+
+/** Commands whose allocator calls PERF times. */
+typedef enum PerfCommand {
+    PERF_RQ,
+    PERF_RQB,
+    PERF_RS,
+    PERF_RL,
+    PERF_RLB,
+    PERF_C,
+    PERF_COMMAND_COUNT
+} PerfCommand;
+
+const char *const perfCommandNames[PERF_COMMAND_COUNT] = {"RQ", "RQB", "RS", "RL", "RLB", "C"};
+
+/** Log-linear (HDR-style) latency histogram: exact below 16 ns, then 16 buckets per
+ *  power of two, so every recorded value is within 6.25% of its bucket. */
+typedef struct LatencyHistogram {
+    long long count;
+    long long totalNs;
+    long long maxNs;
+    long long buckets[LATENCY_BUCKET_COUNT];
+} LatencyHistogram;
+
+LatencyHistogram latencies[PERF_COMMAND_COUNT];
+
+/** Prints a per-operation message unless running quietly. */
+void logMessage(const char *format, ...) {
+    if (!verboseOutput)
+        return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+/** Returns a monotonic clock in nanoseconds, which NTP steps and slews cannot move backwards;
+ *  the wall clock only where CLOCK_MONOTONIC is missing. */
+long long monotonicNs() {
+    struct timespec now;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Returns the current time in nanoseconds, or 0 without a clock read when PERF is off. */
+long long perfClock() {
+    return perfEnabled ? monotonicNs() : 0;
+}
+
+/** Returns the histogram bucket holding value. */
+int latencyBucket(long long value) {
+    if (value < (1 << LATENCY_SUB_BUCKET_BITS))
+        return value < 0 ? 0 : (int)value;
+    int exponent = 63;
+    while (!(value >> exponent))
+        exponent--;
+    int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    int subBucket = (int)(value >> shift) - (1 << LATENCY_SUB_BUCKET_BITS);
+    return ((shift + 1) << LATENCY_SUB_BUCKET_BITS) + subBucket;
+}
+
+/** Returns the smallest value that falls in bucket. */
+long long latencyBucketFloor(int bucket) {
+    int block = bucket >> LATENCY_SUB_BUCKET_BITS;
+    long long subBucket = bucket & ((1 << LATENCY_SUB_BUCKET_BITS) - 1);
+    if (block == 0)
+        return subBucket;
+    return ((1LL << LATENCY_SUB_BUCKET_BITS) + subBucket) << (block - 1);
+}
+
+/** Records the time since startNs (from perfClock) against command. */
+void perfRecord(PerfCommand command, long long startNs) {
+    if (!perfEnabled)
+        return;
+    long long elapsed = perfClock() - startNs;
+    LatencyHistogram *histogram = &latencies[command];
+    histogram->count++;
+    histogram->totalNs += elapsed;
+    if (elapsed > histogram->maxNs)
+        histogram->maxNs = elapsed;
+    histogram->buckets[latencyBucket(elapsed)]++;
+}
+
+/** Returns the highest value of the bucket holding the given quantile (0..1), capped at the maximum. */
+long long latencyQuantile(const LatencyHistogram *histogram, double quantile) {
+    long long rank = (long long)(quantile * histogram->count + 0.5), seen = 0;
+    if (rank < 1)
+        rank = 1;
+    for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank) {
+            long long highest = bucket + 1 < LATENCY_BUCKET_COUNT ? latencyBucketFloor(bucket + 1) - 1 : LLONG_MAX;
+            return highest < histogram->maxNs ? highest : histogram->maxNs;
         }
     }
+    return histogram->maxNs;
 }
-/** Merges "all" FREE blocks (even if non‑contiguous) into one big FREE block at the end. */
-void mergeAllFreeMemory() {
-    int totalFree = 0;
-    Node *prev = dummyHead;
-    Node *curr = dummyHead->next;
-    Node *toRemove;
-    while (curr) {
-        if (strcmp(curr->processId, FREE_LABEL) == 0) {
-            totalFree += curr->availableSpace;
-            toRemove = curr;
-            curr = curr->next;
-            free(toRemove);
-            prev->next = curr;
-        } else {
-            prev = curr;
-            curr = curr->next;
+
+/* ---------------------------------------------------------------------------
+ * Binary traces. A trace is TRACE_MAGIC, a version byte and the heap size, then one
+ * record per command: an opcode byte, the nanoseconds since the previous record and the
+ * operands. Integers are LEB128 varints (signed ones zigzag-encoded first). A process ID
+ * is its dictionary number; a number one past the last defines a new ID, followed by its
+ * length byte and characters.
+ * ------------------------------------------------------------------------- */
+
+/** Record opcodes. */
+typedef enum TraceOp {
+    TRACE_RQ = 1, // id, size, algorithm byte, alignment
+    TRACE_RL,     // id
+    TRACE_C,      // maxBlocks, maxBytes
+    TRACE_RS,     // id, size, algorithm byte
+    TRACE_RQB,    // algorithm byte, count, count x (id, size)
+    TRACE_RLB,    // count, count x id
+    TRACE_RQW,    // id, size, algorithm byte, priority
+    TRACE_CANCEL  // id
+} TraceOp;
+
+/** State of --record: the output and the process ID dictionary. */
+typedef struct TraceRecorder {
+    FILE *file;                   // NULL when not recording
+    long long lastNs;             // Timestamp of the previous record
+    char (*processIds)[PROCESS_ID_SIZE]; // Dictionary, indexed by ID number
+    int idCount;
+    int idCapacity;
+    int *slots;                   // Open-addressing table of ID number + 1, 0 if empty
+    size_t slotCapacity;          // Always a power of two
+} TraceRecorder;
+
+TraceRecorder recorder;
+
+/** Appends an unsigned LEB128 varint to the trace. */
+void traceVarint(unsigned long long value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7f) | 0x80, recorder.file);
+        value >>= 7;
+    }
+    putc((int)value, recorder.file);
+}
+
+/** Appends a zigzag-encoded signed varint, so small negative sizes stay one byte. */
+void traceSigned(long long value) {
+    traceVarint(((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+/** Returns the FNV-1a hash of a process ID. */
+size_t hashTraceId(const char *processId) {
+    size_t hash = 2166136261u;
+    for (; *processId; processId++)
+        hash = (hash ^ (unsigned char)*processId) * 16777619u;
+    return hash;
+}
+
+/** Returns the dictionary slot for processId: the matching entry or the empty slot where it belongs. */
+int *traceIdSlot(int *slots, size_t capacity, const char *processId) {
+    size_t index = hashTraceId(processId) & (capacity - 1);
+    while (slots[index] && strcmp(recorder.processIds[slots[index] - 1], processId) != 0)
+        index = (index + 1) & (capacity - 1);
+    return &slots[index];
+}
+
+/** Appends a process ID, defining it in the dictionary the first time it appears. */
+void traceId(const char *processId) {
+    if ((size_t)recorder.idCount * 2 >= recorder.slotCapacity) {
+        size_t capacity = recorder.slotCapacity ? recorder.slotCapacity * 2 : 1024;
+        int *slots = (int *)calloc(capacity, sizeof(int));
+        if (!slots) {
+            fprintf(stderr, "Error: Memory allocation failed in traceId.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int id = 0; id < recorder.idCount; id++)
+            *traceIdSlot(slots, capacity, recorder.processIds[id]) = id + 1;
+        free(recorder.slots);
+        recorder.slots = slots;
+        recorder.slotCapacity = capacity;
+    }
+    int *slot = traceIdSlot(recorder.slots, recorder.slotCapacity, processId);
+    if (*slot) {
+        traceVarint((unsigned long long)(*slot - 1));
+        return;
+    }
+    if (recorder.idCount == recorder.idCapacity) {
+        int capacity = recorder.idCapacity ? recorder.idCapacity * 2 : 1024;
+        char (*processIds)[PROCESS_ID_SIZE] = realloc(recorder.processIds, (size_t)capacity * PROCESS_ID_SIZE);
+        if (!processIds) {
+            fprintf(stderr, "Error: Memory allocation failed in traceId.\n");
+            exit(EXIT_FAILURE);
         }
+        recorder.processIds = processIds;
+        recorder.idCapacity = capacity;
+    }
+    size_t length = strlen(processId);
+    memcpy(recorder.processIds[recorder.idCount], processId, length + 1);
+    *slot = ++recorder.idCount;
+    traceVarint((unsigned long long)(recorder.idCount - 1));
+    putc((int)length, recorder.file);
+    fwrite(processId, 1, length, recorder.file);
+}
+
+/** Starts a record: its opcode and the time since the previous one. Returns 0 when not recording. */
+int traceBegin(TraceOp op) {
+    if (!recorder.file)
+        return 0;
+    long long now = monotonicNs();
+    putc(op, recorder.file);
+    traceVarint((unsigned long long)(now > recorder.lastNs ? now - recorder.lastNs : 0));
+    recorder.lastNs = now;
+    return 1;
+}
+
+/** Opens path for --record and writes the trace header. Returns 0 if it cannot be created. */
+int startRecording(const char *path, AllocatorSize heapSize) {
+    recorder.file = fopen(path, "wb");
+    if (!recorder.file)
+        return 0;
+    fwrite(TRACE_MAGIC, 1, 4, recorder.file);
+    putc(TRACE_VERSION, recorder.file);
+    traceVarint((unsigned long long)heapSize);
+    recorder.lastNs = monotonicNs();
+    return 1;
+}
+
+/** Flushes and closes the trace being recorded. */
+void stopRecording() {
+    if (!recorder.file)
+        return;
+    if (fclose(recorder.file) != 0)
+        fprintf(stderr, "Error: Writing the trace failed.\n");
+    free(recorder.processIds);
+    free(recorder.slots);
+    memset(&recorder, 0, sizeof(recorder)); // A later recording starts with an empty dictionary
+}
+
+/** Maps an algorithm argument to a strategy; anything but one known letter becomes
+ *  ALLOCATOR_STRATEGY_COUNT, which the allocator rejects after its exists check. */
+AllocatorStrategy parseAlgorithm(const char algo[2]) {
+    AllocatorStrategy strategy = ALLOCATOR_STRATEGY_COUNT;
+    if (strlen(algo) == 1)
+        allocator_parse_strategy(algo[0], &strategy);
+    return strategy;
+}
+
+/** Returns the name printed for placements made with strategy. */
+const char *placementName(AllocatorStrategy strategy) {
+    return activeEngine == ALLOCATOR_ENGINE_BUDDY ? "Buddy System" : allocator_strategy_name(strategy);
+}
+
+/** Prints the outcome of one allocation. Returns 1 on success, 0 otherwise. */
+int reportRequest(const char *processId, AllocatorSize spaceRequested, AllocatorSize alignment,
+                  const char *strategyName, AllocatorStatus status, const AllocatorBlock *block) {
+    switch (status) {
+    case ALLOCATOR_OK:
+        logMessage("Allocation Successful! Process %s allocated using %s. Block: [%lld : %lld]\n",
+                   processId, strategyName, block->startAddress, block->endAddress);
+        return 1;
+    case ALLOCATOR_ERR_EXISTS:
+        logMessage("Process %s already exists. Choose a different ID.\n", processId);
+        break;
+    case ALLOCATOR_ERR_INVALID_STRATEGY:
+        logMessage("Invalid algorithm. Use 'F' (First Fit), 'N' (Next Fit), 'B' (Best Fit), 'W' (Worst Fit), or 'S' (Segregated Fit).\n");
+        break;
+    case ALLOCATOR_ERR_INVALID_SIZE:
+        logMessage("Invalid size %lld for process %s.\n", spaceRequested, processId);
+        break;
+    case ALLOCATOR_ERR_INVALID_ALIGNMENT:
+        logMessage("Invalid alignment %lld for process %s. Use a power of two.\n", alignment, processId);
+        break;
+    case ALLOCATOR_ERR_INVALID_ID:
+        logMessage("Invalid process ID %s. Use at most %d characters.\n", processId, PROCESS_ID_SIZE - 1);
+        break;
+    case ALLOCATOR_ERR_NO_MEMORY:
+        fprintf(stderr, "Error: Memory allocation failed in requestMemory.\n");
+        exit(EXIT_FAILURE);
+    default:
+        logMessage("Not enough space to allocate %lld bytes for process %s using %s.\n", spaceRequested, processId, strategyName);
+        break;
+    }
+    return 0;
+}
+
+/** Requests memory based on the chosen algorithm (F, N, B, W, S), starting at a multiple
+ *  of alignment (1 for none). The buddy engine accepts the same letters but always places
+ *  with the buddy system. Returns 1 on success, 0 if the request was rejected or did not fit. */
+int requestMemory(const char *processId, AllocatorSize spaceRequested, const char algo[2], AllocatorSize alignment) {
+    if (traceBegin(TRACE_RQ)) {
+        traceId(processId);
+        traceSigned(spaceRequested);
+        putc(algo[0], recorder.file);
+        traceSigned(alignment);
     }
+    AllocatorStrategy strategy = parseAlgorithm(algo);
+    AllocatorBlock block;
+    long long started = perfClock();
+    AllocatorStatus status = allocator_allocate_aligned(heap, processId, spaceRequested, alignment, strategy, &block);
+    perfRecord(PERF_RQ, started);
+    return reportRequest(processId, spaceRequested, alignment, placementName(strategy), status, &block);
+}
+
+/** A parked request that finished during a command: placed once space freed up, or cancelled. */
+typedef struct WakeReport {
+    char processId[PROCESS_ID_SIZE];
+    AllocatorStatus status;
+    AllocatorSize startAddress;
+    AllocatorSize endAddress;
+} WakeReport;
 
-    if (totalFree > 0) {
-        Node *freeBlock = malloc(sizeof(Node));
-        if (!freeBlock) {
-            fprintf(stderr, "Error: Memory allocation failed in mergeAllFreeMemory.\n");
+WakeReport *wakeReports;      // Printed after the message of the command that woke them
+int wakeReportCount;
+int wakeReportCapacity;
+
+/** Wait callback: notes a finished parked request for printWakeReports. */
+void reportWake(const char *processId, const AllocatorFuture *future, void *context) {
+    (void)context;
+    if (!verboseOutput)
+        return;
+    if (wakeReportCount == wakeReportCapacity) {
+        int capacity = wakeReportCapacity ? wakeReportCapacity * 2 : 16;
+        WakeReport *reports = (WakeReport *)realloc(wakeReports, (size_t)capacity * sizeof(WakeReport));
+        if (!reports) {
+            fprintf(stderr, "Error: Memory allocation failed in reportWake.\n");
             exit(EXIT_FAILURE);
         }
-        strcpy(freeBlock->processId, FREE_LABEL);
-        freeBlock->availableSpace = totalFree;
-        freeBlock->startAddress = lastAddressSpace + 1 - totalFree;
-        freeBlock->endAddress   = lastAddressSpace;
-        freeBlock->next         = NULL;
-        prev->next              = freeBlock;
+        wakeReports = reports;
+        wakeReportCapacity = capacity;
+    }
+    WakeReport *report = &wakeReports[wakeReportCount++];
+    strcpy(report->processId, processId);
+    report->status = future->status;
+    report->startAddress = future->block.startAddress;
+    report->endAddress = future->block.endAddress;
+}
+
+/** Prints the parked requests that finished since the last call. */
+void printWakeReports() {
+    for (int i = 0; i < wakeReportCount; i++) {
+        const WakeReport *report = &wakeReports[i];
+        if (report->status == ALLOCATOR_OK)
+            logMessage("Allocation Successful! Waiting process %s allocated. Block: [%lld : %lld]\n",
+                       report->processId, report->startAddress, report->endAddress);
+        else
+            logMessage("Waiting request of process %s cancelled.\n", report->processId);
+    }
+    wakeReportCount = 0;
+}
+
+/** Requests memory like requestMemory, but parks the request if it does not fit; it is then
+ *  placed, and noted by reportWake, once a release, resize or compaction makes room.
+ *  Higher priorities are served first under --wait-policy priority. Returns the status. */
+AllocatorStatus requestMemoryOrWait(const char *processId, AllocatorSize spaceRequested, const char algo[2],
+                                    int priority) {
+    if (traceBegin(TRACE_RQW)) {
+        traceId(processId);
+        traceSigned(spaceRequested);
+        putc(algo[0], recorder.file);
+        traceSigned(priority);
+    }
+    AllocatorStrategy strategy = parseAlgorithm(algo);
+    AllocatorBlock block;
+    AllocatorStatus status = allocator_allocate_or_wait(heap, processId, spaceRequested, 1, strategy, priority,
+                                                        &block, reportWake, NULL, NULL);
+    if (status == ALLOCATOR_PENDING)
+        logMessage("Not enough space for process %s now; waiting for %lld bytes (priority %d).\n", processId,
+                   spaceRequested, priority);
+    else
+        reportRequest(processId, spaceRequested, 1, placementName(strategy), status, &block);
+    return status;
+}
+
+/** Cancels the parked request of a process. Returns 1 on success, 0 if it was not waiting. */
+int cancelWait(const char *processId) {
+    if (traceBegin(TRACE_CANCEL))
+        traceId(processId);
+    if (allocator_cancel_wait(heap, processId) != ALLOCATOR_OK) {
+        logMessage("Process %s is not waiting.\n", processId);
+        return 0;
+    }
+    return 1;
+}
+
+/** Prints the outcome of one release. Returns 1 on success, 0 if the process was not found. */
+int reportRelease(const char *processId, AllocatorStatus status) {
+    if (status != ALLOCATOR_OK) {
+        logMessage("Process %s not found.\n", processId);
+        return 0;
+    }
+    logMessage("Memory released for process %s.\n", processId);
+    return 1;
+}
+
+/** Releases memory allocated to a process. Returns 1 on success, 0 if the process was not found. */
+int releaseMemory(const char *processId) {
+    if (traceBegin(TRACE_RL))
+        traceId(processId);
+    long long started = perfClock();
+    AllocatorStatus status = allocator_release(heap, processId);
+    perfRecord(PERF_RL, started);
+    return reportRelease(processId, status);
+}
+
+/** Process IDs (and sizes, for RQB) parsed from one bulk command. */
+typedef struct BulkItems {
+    char (*processIds)[PROCESS_ID_SIZE];
+    AllocatorSize *sizes;
+    int count;
+    int capacity;
+} BulkItems;
+
+/** Places every item of an RQB command with one bulk call and prints each outcome in
+ *  command order. Returns the number of items that failed. */
+int requestMemoryBulk(const BulkItems *items, const char algo[2]) {
+    if (traceBegin(TRACE_RQB)) {
+        putc(algo[0], recorder.file);
+        traceVarint((unsigned long long)items->count);
+        for (int i = 0; i < items->count; i++) {
+            traceId(items->processIds[i]);
+            traceSigned(items->sizes[i]);
+        }
+    }
+    AllocatorStrategy strategy = parseAlgorithm(algo);
+    AllocatorRequest *requests = (AllocatorRequest *)malloc((size_t)items->count * sizeof(AllocatorRequest));
+    if (!requests) {
+        fprintf(stderr, "Error: Memory allocation failed in requestMemoryBulk.\n");
+        exit(EXIT_FAILURE);
     }
+    for (int i = 0; i < items->count; i++) {
+        requests[i].processId = items->processIds[i];
+        requests[i].size = items->sizes[i];
+    }
+    long long started = perfClock();
+    int placed = allocator_allocate_many(heap, requests, items->count, strategy);
+    perfRecord(PERF_RQB, started);
+    for (int i = 0; i < items->count; i++)
+        reportRequest(requests[i].processId, requests[i].size, 1, placementName(strategy), requests[i].status,
+                      &requests[i].block);
+    free(requests);
+    return items->count - placed;
+}
 
-    dummyHead->availableSpace = totalFree;
+/** Releases every process of an RLB command with one bulk call and prints each outcome in
+ *  command order. Returns the number of processes that were not found. */
+int releaseMemoryBulk(const BulkItems *items) {
+    if (traceBegin(TRACE_RLB)) {
+        traceVarint((unsigned long long)items->count);
+        for (int i = 0; i < items->count; i++)
+            traceId(items->processIds[i]);
+    }
+    const char **processIds = (const char **)malloc((size_t)items->count * sizeof(const char *));
+    AllocatorStatus *statuses = (AllocatorStatus *)malloc((size_t)items->count * sizeof(AllocatorStatus));
+    if (!processIds || !statuses) {
+        fprintf(stderr, "Error: Memory allocation failed in releaseMemoryBulk.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < items->count; i++)
+        processIds[i] = items->processIds[i];
+    long long started = perfClock();
+    int released = allocator_release_many(heap, processIds, items->count, statuses);
+    perfRecord(PERF_RLB, started);
+    for (int i = 0; i < items->count; i++)
+        reportRelease(processIds[i], statuses[i]);
+    free(processIds);
+    free(statuses);
+    return items->count - released;
 }
-/** Checks if a process ID is already allocated. Returns 1 if exists, 0 otherwise. */
-int processExists(const char processId[3]) {
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, processId) == 0)
-            return 1;
-        current = current->next;
+
+/** Resizes a process's block to newSize bytes, growing or shrinking it in place when
+ *  possible and otherwise moving it with the chosen algorithm. Returns 1 on success. */
+int resizeMemory(const char *processId, AllocatorSize newSize, const char algo[2]) {
+    if (traceBegin(TRACE_RS)) {
+        traceId(processId);
+        traceSigned(newSize);
+        putc(algo[0], recorder.file);
+    }
+    AllocatorStrategy strategy = parseAlgorithm(algo);
+    const char *strategyName = placementName(strategy);
+
+    AllocatorStats before, after;
+    AllocatorBlock block;
+    allocator_stats(heap, &before);
+    long long started = perfClock();
+    AllocatorStatus status = allocator_resize(heap, processId, newSize, strategy, &block);
+    perfRecord(PERF_RS, started);
+    switch (status) {
+    case ALLOCATOR_OK:
+        allocator_stats(heap, &after);
+        if (after.resizesInPlace > before.resizesInPlace)
+            logMessage("Resized process %s in place to %lld bytes. Block: [%lld : %lld]\n",
+                       processId, newSize, block.startAddress, block.endAddress);
+        else
+            logMessage("Resized process %s to %lld bytes by moving it using %s. Block: [%lld : %lld]\n",
+                       processId, newSize, strategyName, block.startAddress, block.endAddress);
+        return 1;
+    case ALLOCATOR_ERR_NOT_FOUND:
+        logMessage("Process %s not found.\n", processId);
+        break;
+    case ALLOCATOR_ERR_INVALID_STRATEGY:
+        logMessage("Invalid algorithm. Use 'F' (First Fit), 'N' (Next Fit), 'B' (Best Fit), 'W' (Worst Fit), or 'S' (Segregated Fit).\n");
+        break;
+    case ALLOCATOR_ERR_INVALID_SIZE:
+        logMessage("Invalid size %lld for process %s.\n", newSize, processId);
+        break;
+    case ALLOCATOR_ERR_NO_MEMORY:
+        fprintf(stderr, "Error: Memory allocation failed in resizeMemory.\n");
+        exit(EXIT_FAILURE);
+    default:
+        logMessage("Not enough space to resize process %s to %lld bytes using %s.\n", processId, newSize, strategyName);
+        break;
     }
     return 0;
 }
 
-/** Allocates memory using First Fit: uses the first suitable free block. */
-void allocateFirstFit(const char processId[3], int spaceRequested) {
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, FREE_LABEL) == 0 &&
-            current->next->availableSpace >= spaceRequested) {
-            dummyHead->availableSpace -= spaceRequested;
-            strcpy(current->next->processId, processId);
-            current->next->endAddress = current->next->startAddress + spaceRequested - 1;
-            int allocatedStart = current->next->startAddress;
-            int allocatedEnd = current->next->endAddress;
-            int leftoverSpace = current->next->availableSpace - spaceRequested;
-            current->next->availableSpace = spaceRequested;
-            if (leftoverSpace > 0)
-                createFreeBlock(spaceRequested, leftoverSpace);
-            printf("Allocation Successful! Process %s allocated using First Fit. Block: [%d : %d]\n", processId, allocatedStart, allocatedEnd);
-            return;
+/** Reports one relocation run produced by compaction. */
+void printRelocation(const AllocatorRelocation *relocation, void *context) {
+    (void)context;
+    logMessage("Relocated [%lld : %lld] -> [%lld : %lld] (%lld bytes, %d block%s)\n",
+               relocation->oldStart, relocation->oldStart + relocation->size - 1,
+               relocation->newStart, relocation->newStart + relocation->size - 1,
+               relocation->size, relocation->blockCount, relocation->blockCount == 1 ? "" : "s");
+}
+
+/** Compacts memory by sliding allocated blocks down so all free space forms one block.
+ *  With a positive maxBlocks or maxBytes budget, runs only one bounded step. */
+void compactMemory(int maxBlocks, AllocatorSize maxBytes) {
+    if (traceBegin(TRACE_C)) {
+        traceSigned(maxBlocks);
+        traceSigned(maxBytes);
+    }
+    AllocatorStats before, after;
+    allocator_stats(heap, &before);
+    long long started = perfClock();
+    int finished = allocator_compact_step(heap, maxBlocks, maxBytes);
+    perfRecord(PERF_C, started);
+    if (finished) {
+        logMessage("Memory compacted successfully.\n");
+        return;
+    }
+    allocator_stats(heap, &after);
+    logMessage("Compaction step moved %lld blocks (%lld bytes); run C again to continue.\n",
+               after.blocksMoved - before.blocksMoved, after.bytesMoved - before.bytesMoved);
+}
+
+/** Returns 1 if the active engine rounds blocks up (to a power of two or whole granules). */
+int engineRoundsUp() {
+    return activeEngine == ALLOCATOR_ENGINE_BUDDY || activeEngine == ALLOCATOR_ENGINE_BITMAP;
+}
+
+/** Prints one block of the STAT listing. */
+void printBlock(const AllocatorBlock *block, void *context) {
+    (void)context;
+    if (block->isFree)
+        printf("Addresses [%lld : %lld] -> %s\n", block->startAddress, block->endAddress, FREE_LABEL);
+    else if (engineRoundsUp())
+        printf("Addresses [%lld : %lld] -> %s (requested %lld)\n", block->startAddress, block->endAddress,
+               block->owner, block->requested);
+    else
+        printf("Addresses [%lld : %lld] -> %s\n", block->startAddress, block->endAddress, block->owner);
+}
+
+/** Prints how many requests each strategy placed and, in builds that count them, the blocks
+ *  its scans visited per request. */
+void printScanStats(const AllocatorStats *stats) {
+    for (int strategy = 0; strategy < ALLOCATOR_STRATEGY_COUNT; strategy++) {
+        const AllocatorScanStats *scan = &stats->scans[strategy];
+        if (!scan->requests)
+            continue;
+#if ALLOCATOR_SCAN_STATS
+        printf("%s: %.1f nodes visited per request (%lld requests)\n", allocator_strategy_name((AllocatorStrategy)strategy),
+               (double)scan->nodesVisited / scan->requests, scan->requests);
+#else
+        printf("%s: %lld requests\n", allocator_strategy_name((AllocatorStrategy)strategy), scan->requests);
+#endif
+    }
+}
+
+/** Reports current memory allocation status. Under the buddy and bitmap engines this
+ *  includes internal fragmentation from rounding and the tail below their granularity. */
+void reportStatus() {
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    printf("\n----- Memory Status -----\n");
+    printf("Total available space: %lld bytes\n", stats.freeBytes);
+    if (engineRoundsUp()) {
+        AllocatorSize allocatedBytes = stats.totalSize - stats.unusableBytes - stats.freeBytes;
+        printf("Internal fragmentation: %lld bytes (%.1f%% of allocated)\n", stats.internalFragmentation,
+               allocatedBytes ? 100.0 * stats.internalFragmentation / allocatedBytes : 0.0);
+    }
+    allocator_for_each_block(heap, printBlock, NULL);
+    if (stats.unusableBytes > 0)
+        printf("Addresses [%lld : %lld] -> UNUSABLE (%s)\n", stats.totalSize - stats.unusableBytes, stats.totalSize - 1,
+               activeEngine == ALLOCATOR_ENGINE_BUDDY ? "below buddy granularity" : "less than one granule");
+    if (activeEngine != ALLOCATOR_ENGINE_BUDDY)
+        printScanStats(&stats);
+    if (stats.resizesInPlace || stats.resizesMoved)
+        printf("Resizes: %lld in place, %lld moved\n", stats.resizesInPlace, stats.resizesMoved);
+    if (stats.parkedRequests)
+        printf("Waiting requests: %d (%lld woken, %lld cancelled)\n", stats.waitingRequests, stats.wokenRequests,
+               stats.cancelledRequests);
+    if (stats.policySteps || stats.failureCompactions)
+        printf("Auto compaction: %lld steps, %lld full compactions after failed allocations\n", stats.policySteps,
+               stats.failureCompactions);
+    printf("-------------------------\n\n");
+}
+
+/** Prints the heap's running counters and free-size histogram without walking the blocks. */
+void reportSummary() {
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    AllocatorSize allocatedBytes = stats.totalSize - stats.unusableBytes - stats.freeBytes;
+    printf("\n----- Memory Summary -----\n");
+    printf("Total size: %lld bytes\n", stats.totalSize);
+    printf("Free: %lld bytes in %d blocks (largest %lld bytes)\n", stats.freeBytes, stats.freeBlockCount,
+           stats.largestFreeBlock);
+    printf("Allocated: %lld bytes in %d blocks\n", allocatedBytes, stats.allocatedBlockCount);
+    printf("External fragmentation: %.1f%% of free space outside the largest block\n",
+           stats.freeBytes ? 100.0 * (stats.freeBytes - stats.largestFreeBlock) / stats.freeBytes : 0.0);
+    if (engineRoundsUp())
+        printf("Internal fragmentation: %lld bytes (%.1f%% of allocated)\n", stats.internalFragmentation,
+               allocatedBytes ? 100.0 * stats.internalFragmentation / allocatedBytes : 0.0);
+    printf("Free block sizes:\n");
+    for (int sizeClass = 0; sizeClass < ALLOCATOR_SIZE_CLASS_COUNT; sizeClass++) {
+        unsigned long long lowest = 1ULL << sizeClass; // Unsigned: the top class reaches 2^64 - 1
+        if (stats.freeSizeHistogram[sizeClass])
+            printf("  [%llu : %llu] bytes: %d\n", lowest, lowest + (lowest - 1), stats.freeSizeHistogram[sizeClass]);
+    }
+    printf("-------------------------\n\n");
+}
+
+/** Which blocks a filtered STAT lists. */
+typedef enum BlockFilter {
+    LIST_ALL_BLOCKS,
+    LIST_FREE_BLOCKS,
+    LIST_USED_BLOCKS
+} BlockFilter;
+
+/** Progress of one paged STAT listing. */
+typedef struct BlockPage {
+    BlockFilter filter;
+    int printed;
+    int limit; // Blocks to print, 0 for no limit
+} BlockPage;
+
+/** Prints a block if it passes the page's filter. Returns 0 once the page is full. */
+int printPageBlock(const AllocatorBlock *block, void *context) {
+    BlockPage *page = (BlockPage *)context;
+    if (page->filter == LIST_ALL_BLOCKS || (page->filter == LIST_FREE_BLOCKS) == (block->isFree != 0)) {
+        printBlock(block, NULL);
+        page->printed++;
+    }
+    return page->limit == 0 || page->printed < page->limit;
+}
+
+/** Lists up to limit blocks (0 for all) passing filter, starting with the block holding
+ *  fromAddress, and says where the next page starts. */
+void reportBlocks(BlockFilter filter, AllocatorSize fromAddress, int limit) {
+    static const char *const filterWords[] = {"", " FREE", " USED"};
+    BlockPage page = {filter, 0, limit};
+    printf("\n----- Memory Blocks -----\n");
+    AllocatorSize next = allocator_walk_blocks(heap, fromAddress, printPageBlock, &page);
+    if (next >= 0)
+        printf("Next page: STAT%s %lld %d\n", filterWords[filter], next, limit);
+    printf("-------------------------\n\n");
+}
+
+/** Prints the engine's split, merge and node-pool counters, the blocks each strategy visited
+ *  and, when --perf is on, each command type's latency percentiles. */
+void reportPerf() {
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    printf("\n----- Performance -----\n");
+    printf("Splits: %lld  Merges: %lld\n", stats.splits, stats.merges);
+    if (activeEngine == ALLOCATOR_ENGINE_LIST)
+        printf("Nodes: %lld taken from the pool, %lld returned, %lld slabs allocated\n", stats.nodeAllocations,
+               stats.nodeReleases, stats.slabAllocations);
+    if (activeEngine != ALLOCATOR_ENGINE_BUDDY)
+        printScanStats(&stats);
+    if (!perfEnabled) {
+        printf("Latency: not recorded (run with --perf <json_file>)\n");
+    } else {
+        printf("Latency (ns)     count       mean        p50        p90        p99      p99.9        max\n");
+        for (int command = 0; command < PERF_COMMAND_COUNT; command++) {
+            const LatencyHistogram *histogram = &latencies[command];
+            if (histogram->count)
+                printf("%-8s %13lld %10lld %10lld %10lld %10lld %10lld %10lld\n", perfCommandNames[command],
+                       histogram->count, histogram->totalNs / histogram->count, latencyQuantile(histogram, 0.5),
+                       latencyQuantile(histogram, 0.9), latencyQuantile(histogram, 0.99),
+                       latencyQuantile(histogram, 0.999), histogram->maxNs);
         }
-        current = current->next;
     }
-    printf("Not enough space to allocate %d bytes for process %s using First Fit.\n", spaceRequested, processId);
+    printf("-------------------------\n\n");
 }
 
-/** Allocates memory using Best Fit: uses the smallest suitable free block. */
-void allocateBestFit(const char processId[3], int spaceRequested) {
-    int smallestFit = INT_MAX;
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, FREE_LABEL) == 0 &&
-            current->next->availableSpace >= spaceRequested &&
-            current->next->availableSpace < smallestFit) {
-            smallestFit = current->next->availableSpace;
+/** Writes the PERF counters and every non-empty latency bucket to path as JSON. */
+void writePerfJson(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot write PERF report '%s'.\n", path);
+        return;
+    }
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    fprintf(file, "{\n  \"engine\": \"%s\",\n", allocator_engine_name(activeEngine));
+    fprintf(file, "  \"counters\": {\"splits\": %lld, \"merges\": %lld, \"nodeAllocations\": %lld, "
+                  "\"nodeReleases\": %lld, \"slabAllocations\": %lld},\n",
+            stats.splits, stats.merges, stats.nodeAllocations, stats.nodeReleases, stats.slabAllocations);
+    fprintf(file, "  \"scans\": {");
+    for (int strategy = 0; strategy < ALLOCATOR_STRATEGY_COUNT; strategy++)
+        fprintf(file, "%s\"%s\": {\"requests\": %lld, \"nodesVisited\": %lld}", strategy ? ", " : "",
+                allocator_strategy_name((AllocatorStrategy)strategy), stats.scans[strategy].requests,
+                stats.scans[strategy].nodesVisited);
+    fprintf(file, "},\n  \"latencyNs\": {");
+    for (int command = 0; command < PERF_COMMAND_COUNT; command++) {
+        const LatencyHistogram *histogram = &latencies[command];
+        fprintf(file, "%s\n    \"%s\": {\"count\": %lld, \"total\": %lld, \"max\": %lld, \"p50\": %lld, \"p90\": %lld, "
+                      "\"p99\": %lld, \"p999\": %lld, \"buckets\": [",
+                command ? "," : "", perfCommandNames[command], histogram->count, histogram->totalNs, histogram->maxNs,
+                latencyQuantile(histogram, 0.5), latencyQuantile(histogram, 0.9), latencyQuantile(histogram, 0.99),
+                latencyQuantile(histogram, 0.999));
+        int first = 1;
+        for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++) {
+            if (!histogram->buckets[bucket])
+                continue;
+            fprintf(file, "%s[%lld, %lld]", first ? "" : ", ", latencyBucketFloor(bucket), histogram->buckets[bucket]);
+            first = 0;
         }
-        current = current->next;
-    }
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, FREE_LABEL) == 0 &&
-            current->next->availableSpace == smallestFit) {
-            dummyHead->availableSpace -= spaceRequested;
-            strcpy(current->next->processId, processId);
-            current->next->endAddress = current->next->startAddress + spaceRequested - 1;
-            int allocatedStart = current->next->startAddress;
-            int allocatedEnd = current->next->endAddress;
-            int leftoverSpace = current->next->availableSpace - spaceRequested;
-            current->next->availableSpace = spaceRequested;
-            if (leftoverSpace > 0)
-                createFreeBlock(spaceRequested, leftoverSpace);
-            printf("Allocation Successful! Process %s allocated using Best Fit. Block: [%d : %d]\n", processId, allocatedStart, allocatedEnd);
-            return;
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n  }\n}\n");
+    fclose(file);
+}
+
+/** Tallies printed at the end of a batch run. */
+typedef struct BatchSummary {
+    long long commands;
+    long long requests;
+    long long requestFailures;
+    long long releases;
+    long long releaseFailures;
+    long long resizes;
+    long long resizeFailures;
+    long long compactions;
+    long long statusCommands;
+    long long snapshots;        // SAVE and LOAD
+    long long snapshotFailures;
+    long long waitRequests;     // RQW
+    long long waitsParked;      // RQW requests that had to wait
+    long long waitFailures;     // RQW requests rejected outright
+    long long cancels;
+    long long cancelFailures;
+    long long invalidCommands;
+} BatchSummary;
+
+/** Reads a whole file into a NUL-terminated heap buffer. Returns NULL on failure. */
+char *readWholeFile(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    char *buffer = NULL;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long size = ftell(file);
+        if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+            buffer = (char *)malloc((size_t)size + 1);
+            if (buffer && fread(buffer, 1, (size_t)size, file) == (size_t)size) {
+                buffer[size] = '\0';
+                *length = (size_t)size;
+            } else {
+                free(buffer);
+                buffer = NULL;
+            }
         }
-        current = current->next;
     }
-    printf("Not enough space to allocate %d bytes for process %s using Best Fit.\n", spaceRequested, processId);
+    fclose(file);
+    return buffer;
+}
+
+/** Maps a whole file read-only, or reads it into memory where mmap is unavailable.
+ *  Returns NULL if the file cannot be read or is empty. */
+const unsigned char *mapReadOnlyFile(const char *path, size_t *length) {
+#if defined(_WIN32)
+    char *buffer = readWholeFile(path, length);
+    if (buffer && *length == 0) {
+        free(buffer);
+        buffer = NULL;
+    }
+    return (const unsigned char *)buffer;
+#else
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+        return NULL;
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(descriptor, &info) == 0 && info.st_size > 0) {
+        *length = (size_t)info.st_size;
+        data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    close(descriptor);
+    if (data == MAP_FAILED)
+        return NULL;
+    return (const unsigned char *)data;
+#endif
+}
+
+/** Releases a file mapped by mapReadOnlyFile. */
+void unmapReadOnlyFile(const unsigned char *data, size_t length) {
+#if defined(_WIN32)
+    (void)length;
+    free((void *)data);
+#else
+    munmap((void *)data, length);
+#endif
+}
+
+/** Writes the heap's block layout to path as a snapshot LOAD can restore. */
+int saveHeap(const char *path) {
+    size_t length = allocator_snapshot_size(heap);
+    void *snapshot = malloc(length);
+    if (!snapshot) {
+        fprintf(stderr, "Error: Memory allocation failed in saveHeap.\n");
+        return 0;
+    }
+    allocator_snapshot(heap, snapshot);
+    FILE *file = fopen(path, "wb");
+    int written = file && fwrite(snapshot, 1, length, file) == length;
+    if (file && fclose(file) != 0)
+        written = 0;
+    free(snapshot);
+    if (!written) {
+        fprintf(stderr, "Error: Cannot write snapshot '%s'.\n", path);
+        return 0;
+    }
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    logMessage("Saved %d blocks to %s.\n", stats.blockCount, path);
+    return 1;
+}
+
+/** Replaces the heap with the snapshot at path. The current heap is kept if the file
+ *  cannot be read or is not a valid snapshot. */
+int loadHeap(const char *path) {
+    if (recorder.file) {
+        fprintf(stderr, "Error: LOAD cannot be recorded; the trace would not replay.\n");
+        return 0;
+    }
+    size_t length;
+    const unsigned char *data = mapReadOnlyFile(path, &length);
+    if (!data) {
+        fprintf(stderr, "Error: Cannot read snapshot '%s'.\n", path);
+        return 0;
+    }
+    Allocator *loaded = backedHeap ? allocator_restore_backed(data, length) : allocator_restore(data, length);
+    unmapReadOnlyFile(data, length);
+    if (!loaded) {
+        fprintf(stderr, "Error: '%s' is not a valid snapshot.\n", path);
+        return 0;
+    }
+    allocator_destroy(heap);
+    heap = loaded;
+    allocator_set_relocation_visitor(heap, printRelocation, NULL);
+    allocator_set_wait_policy(heap, waitPolicy);
+    allocator_set_compaction_policy(heap, &compactionPolicy);
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    activeEngine = stats.engine;
+    logMessage("Loaded %d blocks (%lld bytes, %s engine) from %s.\n", stats.blockCount, stats.totalSize,
+               allocator_engine_name(activeEngine), path);
+    return 1;
+}
+
+/** Returns the next whitespace-delimited token before lineEnd and advances *cursor,
+ *  or NULL when the line has no more tokens. */
+const char *nextToken(const char **cursor, const char *lineEnd, size_t *length) {
+    const char *pos = *cursor;
+    while (pos < lineEnd && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+        pos++;
+    if (pos == lineEnd)
+        return NULL;
+    const char *token = pos;
+    while (pos < lineEnd && *pos != ' ' && *pos != '\t' && *pos != '\r')
+        pos++;
+    *cursor = pos;
+    *length = (size_t)(pos - token);
+    return token;
+}
+
+/** Returns 1 if the token spells word exactly. */
+int tokenIs(const char *token, size_t length, const char *word) {
+    return token && strlen(word) == length && memcmp(token, word, length) == 0;
+}
+
+/** Parses a decimal 64-bit size token. Returns 1 on success, 0 if malformed or out of range. */
+int parseSizeToken(const char *token, size_t length, AllocatorSize *value) {
+    if (!token || length == 0)
+        return 0;
+    size_t i = 0;
+    int negative = token[0] == '-';
+    if (negative && length == 1)
+        return 0;
+    i += negative;
+    AllocatorSize result = 0;
+    for (; i < length; i++) {
+        if (token[i] < '0' || token[i] > '9' || result > (LLONG_MAX - (token[i] - '0')) / 10)
+            return 0;
+        result = result * 10 + (token[i] - '0');
+    }
+    *value = negative ? -result : result;
+    return 1;
+}
+
+/** Parses a decimal integer token. Returns 1 on success. */
+int parseIntToken(const char *token, size_t length, int *value) {
+    AllocatorSize result;
+    if (!parseSizeToken(token, length, &result) || result > INT_MAX || result < -INT_MAX)
+        return 0;
+    *value = (int)result;
+    return 1;
+}
+
+/** Copies a process ID token into a NUL-terminated buffer. Returns 0 if it is too long. */
+int copyProcessIdToken(const char *token, size_t length, char processId[PROCESS_ID_SIZE]) {
+    if (!token || length >= PROCESS_ID_SIZE)
+        return 0;
+    memcpy(processId, token, length);
+    processId[length] = '\0';
+    return 1;
 }
 
-/** Allocates memory using Worst Fit: uses the largest suitable free block. */
-void allocateWorstFit(const char processId[3], int spaceRequested) {
-    int largestFit = INT_MIN;
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, FREE_LABEL) == 0 &&
-            current->next->availableSpace >= spaceRequested &&
-            current->next->availableSpace > largestFit) {
-            largestFit = current->next->availableSpace;
+/** Parses the rest of a bulk command into items: <ProcessID> <Space> pairs when withSizes,
+ *  otherwise bare process IDs. Returns 0 if the list is empty or malformed. */
+int parseBulkItems(const char *cursor, const char *lineEnd, int withSizes, BulkItems *items) {
+    size_t idLength, sizeLength;
+    const char *id;
+    items->count = 0;
+    while ((id = nextToken(&cursor, lineEnd, &idLength))) {
+        if (items->count == items->capacity) {
+            int capacity = items->capacity ? items->capacity * 2 : 16;
+            char (*processIds)[PROCESS_ID_SIZE] = realloc(items->processIds, (size_t)capacity * PROCESS_ID_SIZE);
+            AllocatorSize *sizes = (AllocatorSize *)realloc(items->sizes, (size_t)capacity * sizeof(AllocatorSize));
+            if (processIds)
+                items->processIds = processIds;
+            if (sizes)
+                items->sizes = sizes;
+            if (!processIds || !sizes) {
+                fprintf(stderr, "Error: Memory allocation failed in parseBulkItems.\n");
+                exit(EXIT_FAILURE);
+            }
+            items->capacity = capacity;
         }
-        current = current->next;
-    }
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, FREE_LABEL) == 0 &&
-            current->next->availableSpace == largestFit) {
-            dummyHead->availableSpace -= spaceRequested;
-            strcpy(current->next->processId, processId);
-            current->next->endAddress = current->next->startAddress + spaceRequested - 1;
-            int allocatedStart = current->next->startAddress;
-            int allocatedEnd = current->next->endAddress;
-            int leftoverSpace = current->next->availableSpace - spaceRequested;
-            current->next->availableSpace = spaceRequested;
-            if (leftoverSpace > 0)
-                createFreeBlock(spaceRequested, leftoverSpace);
-            printf("Allocation Successful! Process %s allocated using Worst Fit. Block: [%d : %d]\n", processId, allocatedStart, allocatedEnd);
-            return;
+        if (!copyProcessIdToken(id, idLength, items->processIds[items->count]))
+            return 0;
+        items->sizes[items->count] = 0;
+        if (withSizes) {
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            if (!parseSizeToken(size, sizeLength, &items->sizes[items->count]))
+                return 0;
         }
-        current = current->next;
+        items->count++;
     }
-    printf("Not enough space to allocate %d bytes for process %s using Worst Fit.\n", spaceRequested, processId);
+    return items->count > 0;
 }
 
-/** Requests memory based on the chosen algorithm (F, B, W). */
-void requestMemory(const char processId[3], int spaceRequested, const char algo[2]) {
-    if (processExists(processId)) {
-        printf("Process %s already exists. Choose a different ID.\n", processId);
-        return;
+/** Returns the monotonic clock in seconds. */
+double clockSeconds() {
+    return monotonicNs() / 1e9;
+}
+
+/** Prints the tallies of a batch or replay run and the heap's free space. */
+void printBatchSummary(const char *title, const BatchSummary *summary, double elapsed) {
+    printf("----- %s -----\n", title);
+    printf("Commands: %lld (invalid: %lld)\n", summary->commands, summary->invalidCommands);
+    printf("RQ: %lld (failed: %lld)\n", summary->requests, summary->requestFailures);
+    printf("RL: %lld (failed: %lld)\n", summary->releases, summary->releaseFailures);
+    printf("RS: %lld (failed: %lld)\n", summary->resizes, summary->resizeFailures);
+    printf("C: %lld  STAT: %lld\n", summary->compactions, summary->statusCommands);
+    if (summary->snapshots)
+        printf("SAVE/LOAD: %lld (failed: %lld)\n", summary->snapshots, summary->snapshotFailures);
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    if (summary->waitRequests || summary->cancels) {
+        printf("RQW: %lld (waited: %lld, failed: %lld)  CANCEL: %lld (failed: %lld)\n", summary->waitRequests,
+               summary->waitsParked, summary->waitFailures, summary->cancels, summary->cancelFailures);
+        printf("Still waiting: %d\n", stats.waitingRequests);
     }
-    if (strcmp(algo, "W") == 0)
-        allocateWorstFit(processId, spaceRequested);
-    else if (strcmp(algo, "B") == 0)
-        allocateBestFit(processId, spaceRequested);
-    else if (strcmp(algo, "F") == 0)
-        allocateFirstFit(processId, spaceRequested);
-    else
-        printf("Invalid algorithm. Use 'F' (First Fit), 'B' (Best Fit), or 'W' (Worst Fit).\n");
-}
-
-/** Releases memory allocated to a process and merges free blocks. */
-void releaseMemory(const char processId[3]) {
-    current = dummyHead;
-    while (current->next) {
-        if (strcmp(current->next->processId, processId) == 0) {
-            dummyHead->availableSpace += current->next->availableSpace;
-            strcpy(current->next->processId, FREE_LABEL);
-            mergeFreeBlocks();
-            printf("Memory released for process %s.\n", processId);
-            return;
+    printf("Elapsed: %.3f s (%.0f commands/s)\n", elapsed, elapsed > 0 ? summary->commands / elapsed : 0.0);
+    printf("Free space: %lld bytes\n", stats.freeBytes);
+    printf("-------------------------\n");
+}
+
+/** Replays a command file without prompts or per-command messages. Prints a STAT snapshot
+ *  every statEvery commands (0 disables) and a summary at the end. */
+int runBatch(const char *path, long long statEvery) {
+    size_t length;
+    char *buffer = readWholeFile(path, &length);
+    if (!buffer) {
+        fprintf(stderr, "Error: Cannot read batch file '%s'.\n", path);
+        return EXIT_FAILURE;
+    }
+
+    BatchSummary summary = {0};
+    BulkItems bulk = {0};
+    char processId[PROCESS_ID_SIZE], algoType[2], snapshotPath[4096];
+    AllocatorSize spaceRequested;
+    int previousVerbose = verboseOutput;
+    verboseOutput = 0;
+    double startTime = clockSeconds();
+
+    const char *lineStart = buffer;
+    const char *bufferEnd = buffer + length;
+    while (lineStart < bufferEnd) {
+        const char *lineEnd = (const char *)memchr(lineStart, '\n', (size_t)(bufferEnd - lineStart));
+        if (!lineEnd)
+            lineEnd = bufferEnd;
+        const char *cursor = lineStart;
+        lineStart = lineEnd + 1;
+
+        size_t verbLength, idLength, sizeLength, algoLength, alignLength;
+        const char *verb = nextToken(&cursor, lineEnd, &verbLength);
+        if (!verb)
+            continue;
+        summary.commands++;
+
+        if (tokenIs(verb, verbLength, "X"))
+            break;
+        if (tokenIs(verb, verbLength, "RQ")) {
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            const char *align = nextToken(&cursor, lineEnd, &alignLength);
+            AllocatorSize alignment = 1;
+            if (!copyProcessIdToken(id, idLength, processId) || !parseSizeToken(size, sizeLength, &spaceRequested) ||
+                !algo || algoLength != 1 || (align && !parseSizeToken(align, alignLength, &alignment))) {
+                summary.invalidCommands++;
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                summary.requests++;
+                summary.requestFailures += !requestMemory(processId, spaceRequested, algoType, alignment);
+            }
+        } else if (tokenIs(verb, verbLength, "RQW")) {
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            size_t priorityLength;
+            const char *priorityToken = nextToken(&cursor, lineEnd, &priorityLength);
+            int priority = 0;
+            if (!copyProcessIdToken(id, idLength, processId) || !parseSizeToken(size, sizeLength, &spaceRequested) ||
+                !algo || algoLength != 1 ||
+                (priorityToken && !parseIntToken(priorityToken, priorityLength, &priority))) {
+                summary.invalidCommands++;
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                summary.waitRequests++;
+                AllocatorStatus status = requestMemoryOrWait(processId, spaceRequested, algoType, priority);
+                summary.waitsParked += status == ALLOCATOR_PENDING;
+                summary.waitFailures += status != ALLOCATOR_OK && status != ALLOCATOR_PENDING;
+            }
+        } else if (tokenIs(verb, verbLength, "CANCEL")) {
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            if (!copyProcessIdToken(id, idLength, processId)) {
+                summary.invalidCommands++;
+            } else {
+                summary.cancels++;
+                summary.cancelFailures += !cancelWait(processId);
+            }
+        } else if (tokenIs(verb, verbLength, "RQB")) {
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            if (!algo || algoLength != 1 || !parseBulkItems(cursor, lineEnd, 1, &bulk)) {
+                summary.invalidCommands++;
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                summary.requests += bulk.count;
+                summary.requestFailures += requestMemoryBulk(&bulk, algoType);
+            }
+        } else if (tokenIs(verb, verbLength, "RS")) {
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            if (!copyProcessIdToken(id, idLength, processId) || !parseSizeToken(size, sizeLength, &spaceRequested) ||
+                !algo || algoLength != 1) {
+                summary.invalidCommands++;
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                summary.resizes++;
+                summary.resizeFailures += !resizeMemory(processId, spaceRequested, algoType);
+            }
+        } else if (tokenIs(verb, verbLength, "RL")) {
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            if (!copyProcessIdToken(id, idLength, processId)) {
+                summary.invalidCommands++;
+            } else {
+                summary.releases++;
+                summary.releaseFailures += !releaseMemory(processId);
+            }
+        } else if (tokenIs(verb, verbLength, "RLB")) {
+            if (!parseBulkItems(cursor, lineEnd, 0, &bulk)) {
+                summary.invalidCommands++;
+            } else {
+                summary.releases += bulk.count;
+                summary.releaseFailures += releaseMemoryBulk(&bulk);
+            }
+        } else if (tokenIs(verb, verbLength, "C")) {
+            size_t blocksLength, bytesLength;
+            const char *blocks = nextToken(&cursor, lineEnd, &blocksLength);
+            const char *bytes = nextToken(&cursor, lineEnd, &bytesLength);
+            int maxBlocks = 0;
+            AllocatorSize maxBytes = 0;
+            if ((blocks && !parseIntToken(blocks, blocksLength, &maxBlocks)) ||
+                (bytes && !parseSizeToken(bytes, bytesLength, &maxBytes)) || maxBlocks < 0 || maxBytes < 0) {
+                summary.invalidCommands++;
+            } else {
+                summary.compactions++;
+                compactMemory(maxBlocks, maxBytes);
+            }
+        } else if (tokenIs(verb, verbLength, "SAVE") || tokenIs(verb, verbLength, "LOAD")) {
+            const char *file = nextToken(&cursor, lineEnd, &idLength);
+            if (!file || idLength >= sizeof(snapshotPath)) {
+                summary.invalidCommands++;
+            } else {
+                memcpy(snapshotPath, file, idLength);
+                snapshotPath[idLength] = '\0';
+                summary.snapshots++;
+                summary.snapshotFailures += !(verb[0] == 'S' ? saveHeap(snapshotPath) : loadHeap(snapshotPath));
+            }
+        } else if (tokenIs(verb, verbLength, "STAT") || tokenIs(verb, verbLength, "PERF")) {
+            summary.statusCommands++;
+        } else {
+            summary.invalidCommands++;
+        }
+
+        if (statEvery > 0 && summary.commands % statEvery == 0) {
+            printf("After %lld commands:", summary.commands);
+            reportStatus();
         }
-        current = current->next;
     }
-    printf("Process %s not found.\n", processId);
+
+    double elapsed = clockSeconds() - startTime;
+    verboseOutput = previousVerbose;
+    free(buffer);
+    free(bulk.processIds);
+    free(bulk.sizes);
+
+    printBatchSummary("Batch Summary", &summary, elapsed);
+    return EXIT_SUCCESS;
 }
 
-/** Compacts memory by merging adjacent free blocks. */
-void compactMemory() {
-    mergeFreeBlocks();
-    mergeAllFreeMemory();
-    printf("Memory compacted successfully.\n");
+/** Read position in a mapped trace. Reads past the end clear ok instead of faulting. */
+typedef struct TraceReader {
+    const unsigned char *position;
+    const unsigned char *end;
+    int ok;
+} TraceReader;
+
+/** Reads one byte. */
+int readTraceByte(TraceReader *reader) {
+    if (reader->position == reader->end) {
+        reader->ok = 0;
+        return 0;
+    }
+    return *reader->position++;
 }
 
-/** Reports current memory allocation status. */
-void reportStatus() {
-    printf("\n----- Memory Status -----\n");
-    printf("Total available space: %d bytes\n", dummyHead->availableSpace);
-    current = dummyHead;
-    while (current->next) {
-        printf("Addresses [%d : %d] -> %s\n",
-               current->next->startAddress,
-               current->next->endAddress,
-               current->next->processId);
-        current = current->next;
+/** Reads an unsigned LEB128 varint. */
+unsigned long long readTraceVarint(TraceReader *reader) {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = readTraceByte(reader);
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
     }
-    printf("-------------------------\n\n");
+    reader->ok = 0; // Longer than any 64-bit value
+    return 0;
+}
+
+/** Reads a zigzag-encoded signed varint. */
+long long readTraceSigned(TraceReader *reader) {
+    unsigned long long value = readTraceVarint(reader);
+    return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+/** Reads the trace header. Returns 0 if the magic or version is wrong. */
+int readTraceHeader(TraceReader *reader, AllocatorSize *heapSize) {
+    if (reader->end - reader->position < 5 || memcmp(reader->position, TRACE_MAGIC, 4) != 0 ||
+        reader->position[4] != TRACE_VERSION)
+        return 0;
+    reader->position += 5;
+    *heapSize = (AllocatorSize)readTraceVarint(reader);
+    return reader->ok;
+}
+
+/** Returns the heap size recorded in a trace's header, or 0 if it cannot be read. */
+AllocatorSize traceHeapSize(const char *path) {
+    size_t length;
+    const unsigned char *data = mapReadOnlyFile(path, &length);
+    if (!data)
+        return 0;
+    TraceReader reader = {data, data + length, 1};
+    AllocatorSize heapSize = 0;
+    if (!readTraceHeader(&reader, &heapSize))
+        heapSize = 0;
+    unmapReadOnlyFile(data, length);
+    return heapSize;
+}
+
+/** Process ID dictionary rebuilt while replaying. */
+typedef struct ReplayIds {
+    char (*processIds)[PROCESS_ID_SIZE];
+    int count;
+    int capacity;
+} ReplayIds;
+
+/** Reads a process ID, adding it to the dictionary when the record defines it.
+ *  Returns NULL if the reference is malformed. */
+const char *readTraceId(TraceReader *reader, ReplayIds *ids) {
+    unsigned long long number = readTraceVarint(reader);
+    if (!reader->ok || number > (unsigned long long)ids->count)
+        return NULL;
+    if (number < (unsigned long long)ids->count)
+        return ids->processIds[number];
+    size_t length = (size_t)readTraceByte(reader);
+    if (!reader->ok || length >= PROCESS_ID_SIZE || (size_t)(reader->end - reader->position) < length)
+        return NULL;
+    if (ids->count == ids->capacity) {
+        int capacity = ids->capacity ? ids->capacity * 2 : 1024;
+        char (*processIds)[PROCESS_ID_SIZE] = realloc(ids->processIds, (size_t)capacity * PROCESS_ID_SIZE);
+        if (!processIds) {
+            fprintf(stderr, "Error: Memory allocation failed in readTraceId.\n");
+            exit(EXIT_FAILURE);
+        }
+        ids->processIds = processIds;
+        ids->capacity = capacity;
+    }
+    memcpy(ids->processIds[ids->count], reader->position, length);
+    ids->processIds[ids->count][length] = '\0';
+    reader->position += length;
+    return ids->processIds[ids->count++];
+}
+
+/** Reads the ID and size pairs (or bare IDs) of a bulk record into items. Returns 0 if malformed. */
+int readTraceBulk(TraceReader *reader, ReplayIds *ids, int withSizes, BulkItems *items) {
+    unsigned long long count = readTraceVarint(reader);
+    if (!reader->ok || count == 0 || count > (unsigned long long)(reader->end - reader->position))
+        return 0; // Every item takes at least one byte
+    if ((int)count > items->capacity) {
+        char (*processIds)[PROCESS_ID_SIZE] = realloc(items->processIds, (size_t)count * PROCESS_ID_SIZE);
+        AllocatorSize *sizes = (AllocatorSize *)realloc(items->sizes, (size_t)count * sizeof(AllocatorSize));
+        if (processIds)
+            items->processIds = processIds;
+        if (sizes)
+            items->sizes = sizes;
+        if (!processIds || !sizes) {
+            fprintf(stderr, "Error: Memory allocation failed in readTraceBulk.\n");
+            exit(EXIT_FAILURE);
+        }
+        items->capacity = (int)count;
+    }
+    items->count = (int)count;
+    for (int i = 0; i < items->count; i++) {
+        const char *processId = readTraceId(reader, ids);
+        if (!processId)
+            return 0;
+        strcpy(items->processIds[i], processId);
+        items->sizes[i] = withSizes ? readTraceSigned(reader) : 0;
+    }
+    return reader->ok;
 }
 
-/** Frees all memory blocks before program exit. */
-void cleanupMemory() {
-    Node *tempNode;
-    while (dummyHead) {
-        tempNode = dummyHead;
-        dummyHead = dummyHead->next;
-        free(tempNode);
+/** Replays a --record trace straight into the command handlers, quietly and as fast as
+ *  possible. A strategy letter other than '\0' overrides the recorded one, so one trace
+ *  can be compared across strategies. Prints the same summary as batch mode. */
+int runReplay(const char *path, char strategyOverride) {
+    size_t length;
+    const unsigned char *data = mapReadOnlyFile(path, &length);
+    if (!data) {
+        fprintf(stderr, "Error: Cannot read trace file '%s'.\n", path);
+        return EXIT_FAILURE;
+    }
+    TraceReader reader = {data, data + length, 1};
+    AllocatorSize recordedSize;
+    if (!readTraceHeader(&reader, &recordedSize)) {
+        fprintf(stderr, "Error: '%s' is not a version %d allocator trace.\n", path, TRACE_VERSION);
+        unmapReadOnlyFile(data, length);
+        return EXIT_FAILURE;
     }
+
+    BatchSummary summary = {0};
+    ReplayIds ids = {0};
+    BulkItems bulk = {0};
+    char algoType[2] = {0, 0};
+    long long tracedNs = 0;
+    int corrupt = 0;
+    int previousVerbose = verboseOutput;
+    verboseOutput = 0;
+    double startTime = clockSeconds();
+
+    while (reader.ok && reader.position < reader.end) {
+        const unsigned char *recordStart = reader.position;
+        int op = readTraceByte(&reader);
+        tracedNs += (long long)readTraceVarint(&reader);
+        const char *processId = NULL;
+        AllocatorSize size = 0, alignment = 1;
+        switch (op) {
+        case TRACE_RQ:
+            processId = readTraceId(&reader, &ids);
+            size = readTraceSigned(&reader);
+            algoType[0] = (char)readTraceByte(&reader);
+            alignment = readTraceSigned(&reader);
+            if (!processId || !reader.ok)
+                break;
+            if (strategyOverride)
+                algoType[0] = strategyOverride;
+            summary.requests++;
+            summary.requestFailures += !requestMemory(processId, size, algoType, alignment);
+            break;
+        case TRACE_RL:
+            processId = readTraceId(&reader, &ids);
+            if (!processId)
+                break;
+            summary.releases++;
+            summary.releaseFailures += !releaseMemory(processId);
+            break;
+        case TRACE_C: {
+            long long maxBlocks = readTraceSigned(&reader);
+            size = readTraceSigned(&reader);
+            if (!reader.ok || maxBlocks > INT_MAX || maxBlocks < -INT_MAX)
+                break;
+            summary.compactions++;
+            compactMemory((int)maxBlocks, size);
+            processId = "";
+            break;
+        }
+        case TRACE_RS:
+            processId = readTraceId(&reader, &ids);
+            size = readTraceSigned(&reader);
+            algoType[0] = (char)readTraceByte(&reader);
+            if (!processId || !reader.ok)
+                break;
+            if (strategyOverride)
+                algoType[0] = strategyOverride;
+            summary.resizes++;
+            summary.resizeFailures += !resizeMemory(processId, size, algoType);
+            break;
+        case TRACE_RQB:
+            algoType[0] = (char)readTraceByte(&reader);
+            if (!readTraceBulk(&reader, &ids, 1, &bulk))
+                break;
+            if (strategyOverride)
+                algoType[0] = strategyOverride;
+            summary.requests += bulk.count;
+            summary.requestFailures += requestMemoryBulk(&bulk, algoType);
+            processId = "";
+            break;
+        case TRACE_RLB:
+            if (!readTraceBulk(&reader, &ids, 0, &bulk))
+                break;
+            summary.releases += bulk.count;
+            summary.releaseFailures += releaseMemoryBulk(&bulk);
+            processId = "";
+            break;
+        case TRACE_RQW: {
+            processId = readTraceId(&reader, &ids);
+            size = readTraceSigned(&reader);
+            algoType[0] = (char)readTraceByte(&reader);
+            long long priority = readTraceSigned(&reader);
+            if (!processId || !reader.ok || priority > INT_MAX || priority < -INT_MAX) {
+                processId = NULL;
+                break;
+            }
+            if (strategyOverride)
+                algoType[0] = strategyOverride;
+            summary.waitRequests++;
+            AllocatorStatus status = requestMemoryOrWait(processId, size, algoType, (int)priority);
+            summary.waitsParked += status == ALLOCATOR_PENDING;
+            summary.waitFailures += status != ALLOCATOR_OK && status != ALLOCATOR_PENDING;
+            break;
+        }
+        case TRACE_CANCEL:
+            processId = readTraceId(&reader, &ids);
+            if (!processId)
+                break;
+            summary.cancels++;
+            summary.cancelFailures += !cancelWait(processId);
+            break;
+        default:
+            break;
+        }
+        if (!processId || !reader.ok) {
+            fprintf(stderr, "Error: Trace '%s' is corrupt at byte %zu; stopping the replay there.\n", path,
+                    (size_t)(recordStart - data));
+            corrupt = 1;
+            break;
+        }
+        summary.commands++;
+    }
+
+    double elapsed = clockSeconds() - startTime;
+    verboseOutput = previousVerbose;
+    unmapReadOnlyFile(data, length);
+    free(ids.processIds);
+    free(bulk.processIds);
+    free(bulk.sizes);
+
+    printBatchSummary("Replay Summary", &summary, elapsed);
+    printf("Traced time: %.3f s (recorded on a %lld-byte heap)\n", tracedNs / 1e9, recordedSize);
+    return corrupt ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 /** Main function: initializes memory and processes user commands. */
 int main(int argc, char *argv[]) {
-    int initialMemory;
-    printf("=== Welcome to the Contiguous Memory Allocator ===\n");
+    AllocatorSize initialMemory;
+    const char *memoryArg = NULL;
+    const char *batchPath = NULL;
+    long long statEvery = 0;
+    const char *perfPath = NULL;
+    const char *recordPath = NULL;
+    const char *replayPath = NULL;
+    char strategyOverride = '\0';
+    AllocatorSize granule = ALLOCATOR_BITMAP_GRANULE;
+
+    // Parse the optional engine selection, batch mode and memory size
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            const char *engineName = argv[++i];
+            int engine = 0;
+            while (engine < ALLOCATOR_ENGINE_COUNT && strcmp(engineName, allocator_engine_name((AllocatorEngine)engine)) != 0)
+                engine++;
+            if (engine == ALLOCATOR_ENGINE_COUNT) {
+                fprintf(stderr, "Error: Unknown engine '%s'. Use 'list', 'buddy', 'array' or 'bitmap'.\n", engineName);
+                return EXIT_FAILURE;
+            }
+            activeEngine = (AllocatorEngine)engine;
+        } else if (strcmp(argv[i], "--granule") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            if (!parseSizeToken(value, strlen(value), &granule)) {
+                fprintf(stderr, "Error: Invalid granule size '%s'.\n", value);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--wait-policy") == 0 && i + 1 < argc) {
+            const char *policyName = argv[++i];
+            if (strcmp(policyName, "fifo") == 0) {
+                waitPolicy = ALLOCATOR_WAIT_FIFO;
+            } else if (strcmp(policyName, "priority") == 0) {
+                waitPolicy = ALLOCATOR_WAIT_PRIORITY;
+            } else {
+                fprintf(stderr, "Error: Unknown wait policy '%s'. Use 'fifo' or 'priority'.\n", policyName);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--auto-compact") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            int percent;
+            if (!parseIntToken(value, strlen(value), &percent) || percent < 1 || percent > 100) {
+                fprintf(stderr, "Error: The auto-compact threshold must be a whole percentage from 1 to 100.\n");
+                return EXIT_FAILURE;
+            }
+            compactionPolicy.threshold = percent / 100.0;
+            compactionPolicy.compactOnFailure = 1;
+        } else if (strcmp(argv[i], "--compact-interval") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            if (!parseIntToken(value, strlen(value), &compactionPolicy.stepInterval) ||
+                compactionPolicy.stepInterval < 1) {
+                fprintf(stderr, "Error: The compaction interval must be a whole number of operations, at least 1.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--compact-budget") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            if (!parseIntToken(value, strlen(value), &compactionPolicy.stepBlocks) || compactionPolicy.stepBlocks < 0) {
+                fprintf(stderr, "Error: The compaction budget must be a whole number of blocks, 0 or more.\n");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--backed") == 0) {
+            backedHeap = 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (strcmp(argv[i], "--stat-every") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            if (!parseSizeToken(value, strlen(value), &statEvery) || statEvery < 1) {
+                fprintf(stderr, "Error: The STAT interval must be a whole number of commands, at least 1.\n"
+                                "Usage: %s <initial_memory_size> --batch <command_file> [--stat-every <n>]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--perf") == 0 && i + 1 < argc) {
+            perfPath = argv[++i];
+            perfEnabled = 1;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            AllocatorStrategy strategy;
+            const char *letter = argv[++i];
+            if (strlen(letter) != 1 || !allocator_parse_strategy(letter[0], &strategy)) {
+                fprintf(stderr, "Error: Unknown strategy '%s'. Use F, N, B, W or S.\n", letter);
+                return EXIT_FAILURE;
+            }
+            strategyOverride = letter[0];
+        } else {
+            memoryArg = argv[i];
+        }
+    }
+
+    if (!batchPath && !replayPath)
+        printf("=== Welcome to the Contiguous Memory Allocator ===\n");
 
     // Get initial memory size
-    if (argc < 2) {
+    if (!memoryArg && replayPath) {
+        initialMemory = traceHeapSize(replayPath);
+        if (initialMemory <= 0) {
+            fprintf(stderr, "Error: Cannot read the heap size from trace '%s'.\n", replayPath);
+            return EXIT_FAILURE;
+        }
+    } else if (!memoryArg) {
+        if (batchPath) {
+            fprintf(stderr, "Error: Batch mode needs the memory size on the command line.\n");
+            return EXIT_FAILURE;
+        }
         printf("Enter initial memory size: ");
-        if (scanf("%d", &initialMemory) != 1) {
+        char line[256];
+        const char *token = NULL;
+        size_t length = 0, extraLength;
+        if (fgets(line, sizeof(line), stdin)) {
+            const char *cursor = line, *lineEnd = line + strcspn(line, "\n");
+            token = nextToken(&cursor, lineEnd, &length);
+            if (nextToken(&cursor, lineEnd, &extraLength))
+                token = NULL; // Trailing input after the size
+        }
+        if (!parseSizeToken(token, length, &initialMemory)) {
             fprintf(stderr, "Error reading memory size.\n");
             return EXIT_FAILURE;
         }
-        getchar(); // Clear input buffer
-    } else {
-        initialMemory = atoi(argv[1]);
+    } else if (!parseSizeToken(memoryArg, strlen(memoryArg), &initialMemory)) {
+        fprintf(stderr, "Error: Invalid memory size '%s'.\n", memoryArg);
+        return EXIT_FAILURE;
     }
 
     // Validate and adjust memory size
@@ -288,35 +1599,84 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Error: Invalid memory size.\n");
         return EXIT_FAILURE;
     }
+    if (activeEngine == ALLOCATOR_ENGINE_BUDDY && initialMemory + 1 > ALLOCATOR_BUDDY_MAX_SIZE) {
+        fprintf(stderr, "Error: The buddy engine supports at most %lld bytes.\n", ALLOCATOR_BUDDY_MAX_SIZE);
+        return EXIT_FAILURE;
+    }
 
-    // Initialize memory list
-    dummyHead = (Node *)malloc(sizeof(Node));
-    initialBlock = (Node *)malloc(sizeof(Node));
-    if (!dummyHead || !initialBlock) {
-        fprintf(stderr, "Memory allocation error.\n");
+    if (activeEngine == ALLOCATOR_ENGINE_BITMAP) {
+        if (granule <= 0 || (granule & (granule - 1)) != 0 || granule > (1LL << 30)) {
+            fprintf(stderr, "Error: The granule must be a power of two from 1 to %lld bytes.\n", 1LL << 30);
+            return EXIT_FAILURE;
+        }
+        if (initialMemory + 1 < granule) {
+            fprintf(stderr, "Error: The bitmap engine needs at least one %lld-byte granule.\n", granule);
+            return EXIT_FAILURE;
+        }
+        heap = backedHeap ? allocator_create_bitmap_backed(initialMemory + 1, granule)
+                          : allocator_create_bitmap(initialMemory + 1, granule);
+    } else {
+        heap = backedHeap ? allocator_create_backed(initialMemory + 1, activeEngine)
+                          : allocator_create(initialMemory + 1, activeEngine);
+    }
+    if (!heap) {
+        fprintf(stderr, "Error: Memory allocation failed in allocator_create.\n");
         return EXIT_FAILURE;
     }
-    dummyHead->availableSpace = initialMemory + 1;
-    dummyHead->next = initialBlock;
-    strcpy(initialBlock->processId, FREE_LABEL);
-    initialBlock->startAddress = 0;
-    initialBlock->endAddress = initialMemory;
-    initialBlock->availableSpace = initialMemory + 1;
-    initialBlock->next = NULL;
-    lastAddressSpace = initialMemory;
+    allocator_set_relocation_visitor(heap, printRelocation, NULL);
+    allocator_set_wait_policy(heap, waitPolicy);
+    allocator_set_compaction_policy(heap, &compactionPolicy);
+    if (recordPath && !startRecording(recordPath, initialMemory + 1)) {
+        fprintf(stderr, "Error: Cannot create trace file '%s'.\n", recordPath);
+        allocator_destroy(heap);
+        return EXIT_FAILURE;
+    }
+
+    if (batchPath || replayPath) {
+        int status = replayPath ? runReplay(replayPath, strategyOverride) : runBatch(batchPath, statEvery);
+        if (perfPath)
+            writePerfJson(perfPath);
+        stopRecording();
+        allocator_destroy(heap);
+        free(wakeReports);
+        return status;
+    }
 
-    printf("\nMemory initialized with %d free bytes.\n", dummyHead->availableSpace);
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    if (activeEngine == ALLOCATOR_ENGINE_BUDDY)
+        printf("\nBuddy engine initialized with %lld free bytes.\n", stats.freeBytes);
+    else if (activeEngine == ALLOCATOR_ENGINE_ARRAY)
+        printf("\nArray engine initialized with %lld free bytes (%s scans).\n", stats.freeBytes,
+               allocator_scan_kernels());
+    else if (activeEngine == ALLOCATOR_ENGINE_BITMAP)
+        printf("\nBitmap engine initialized with %lld free bytes in %lld-byte granules.\n", stats.freeBytes,
+               stats.granuleSize);
+    else
+        printf("\nMemory initialized with %lld free bytes.\n", stats.freeBytes);
+    if (backedHeap)
+        printf("Backed by a real buffer at %p.\n", allocator_base(heap));
 
     // Display commands
     printf("Commands:\n");
-    printf("  RQ <ProcessID> <Space> <Algorithm>  (e.g., RQ p1 100 B)\n");
-    printf("  RL <ProcessID>                      (Release memory)\n");
-    printf("  C                                   (Compact memory)\n");
-    printf("  STAT                                (Display memory status)\n");
-    printf("  X                                   (Exit)\n\n");
+    printf("  RQ <ProcessID> <Space> <Algorithm> [<Align>]  (e.g., RQ p1 100 B, RQ p1 64 B 64)\n");
+    printf("  RQW <ProcessID> <Space> <Algorithm> [<Prio>]  (Request, waiting for space if it does not fit)\n");
+    printf("  CANCEL <ProcessID>                            (Cancel a waiting request)\n");
+    printf("  RQB <Algorithm> <ProcessID> <Space> [...]     (Request many blocks in one pass)\n");
+    printf("  RS <ProcessID> <NewSize> <Algorithm>          (Resize, moving with <Algorithm> only if needed)\n");
+    printf("  RL <ProcessID>                                (Release memory)\n");
+    printf("  RLB <ProcessID> [<ProcessID> ...]             (Release many blocks, merging them in one pass)\n");
+    printf("  C [<MaxBlocks> [<MaxBytes>]]                  (Compact memory, optionally one bounded step)\n");
+    printf("  STAT [SUMMARY]                                (Display memory status, or only its counters)\n");
+    printf("  STAT [FREE|USED] <From> [<Count>]             (List blocks from an address, optionally one page)\n");
+    printf("  PERF                                          (Display engine counters and command latencies)\n");
+    printf("  SAVE <File>                                   (Write the block layout to a snapshot file)\n");
+    printf("  LOAD <File>                                   (Replace the heap with a saved snapshot)\n");
+    printf("  X                                             (Exit)\n\n");
 
-    char command[128], requestType[5], processId[3], algoType[2];
-    int spaceRequested;
+    char command[4096], processId[PROCESS_ID_SIZE], algoType[2];
+    AllocatorSize spaceRequested;
+    BulkItems bulk = {0};
 
     while (1) {
         printf("Command > ");
@@ -324,36 +1684,155 @@ int main(int argc, char *argv[]) {
             break;
         command[strcspn(command, "\n")] = '\0';
 
-        if (sscanf(command, "%s", requestType) < 1) {
+        const char *cursor = command, *lineEnd = command + strlen(command);
+        size_t verbLength, length;
+        const char *verb = nextToken(&cursor, lineEnd, &verbLength);
+        if (!verb) {
             printf("Invalid command. Try again.\n");
             continue;
         }
 
-        if (strcmp("X", requestType) == 0)
+        if (tokenIs(verb, verbLength, "X"))
             break;
 
-        if (strcmp("RQ", requestType) == 0) {
-            if (sscanf(command, "%s %2s %d %1s", requestType, processId, &spaceRequested, algoType) != 4) {
-                printf("Usage: RQ <ProcessID> <Space> <Algorithm>\n");
+        if (tokenIs(verb, verbLength, "RQ")) {
+            size_t idLength, sizeLength, algoLength, alignLength;
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            const char *align = nextToken(&cursor, lineEnd, &alignLength);
+            AllocatorSize alignment = 1;
+            if (!copyProcessIdToken(id, idLength, processId) || !parseSizeToken(size, sizeLength, &spaceRequested) ||
+                !algo || algoLength != 1 || (align && !parseSizeToken(align, alignLength, &alignment))) {
+                printf("Usage: RQ <ProcessID> <Space> <Algorithm> [<Alignment>]\n");
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                requestMemory(processId, spaceRequested, algoType, alignment);
+            }
+        } else if (tokenIs(verb, verbLength, "RQW")) {
+            size_t idLength, sizeLength, algoLength, priorityLength;
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            const char *priorityToken = nextToken(&cursor, lineEnd, &priorityLength);
+            int priority = 0;
+            if (!copyProcessIdToken(id, idLength, processId) || !parseSizeToken(size, sizeLength, &spaceRequested) ||
+                !algo || algoLength != 1 ||
+                (priorityToken && !parseIntToken(priorityToken, priorityLength, &priority))) {
+                printf("Usage: RQW <ProcessID> <Space> <Algorithm> [<Priority>]\n");
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                requestMemoryOrWait(processId, spaceRequested, algoType, priority);
+            }
+        } else if (tokenIs(verb, verbLength, "CANCEL")) {
+            size_t idLength;
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            if (!copyProcessIdToken(id, idLength, processId)) {
+                printf("Usage: CANCEL <ProcessID>\n");
             } else {
-                requestMemory(processId, spaceRequested, algoType);
+                cancelWait(processId);
             }
-        } else if (strcmp("RL", requestType) == 0) {
-            if (sscanf(command, "%s %2s", requestType, processId) != 2) {
+        } else if (tokenIs(verb, verbLength, "RQB")) {
+            const char *algo = nextToken(&cursor, lineEnd, &length);
+            if (!algo || length != 1 || !parseBulkItems(cursor, lineEnd, 1, &bulk)) {
+                printf("Usage: RQB <Algorithm> <ProcessID> <Space> [<ProcessID> <Space> ...]\n");
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                requestMemoryBulk(&bulk, algoType);
+            }
+        } else if (tokenIs(verb, verbLength, "RS")) {
+            size_t idLength, sizeLength, algoLength;
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            const char *size = nextToken(&cursor, lineEnd, &sizeLength);
+            const char *algo = nextToken(&cursor, lineEnd, &algoLength);
+            if (!copyProcessIdToken(id, idLength, processId) || !parseSizeToken(size, sizeLength, &spaceRequested) ||
+                !algo || algoLength != 1) {
+                printf("Usage: RS <ProcessID> <NewSize> <Algorithm>\n");
+            } else {
+                algoType[0] = algo[0];
+                algoType[1] = '\0';
+                resizeMemory(processId, spaceRequested, algoType);
+            }
+        } else if (tokenIs(verb, verbLength, "RL")) {
+            size_t idLength;
+            const char *id = nextToken(&cursor, lineEnd, &idLength);
+            if (!copyProcessIdToken(id, idLength, processId)) {
                 printf("Usage: RL <ProcessID>\n");
             } else {
                 releaseMemory(processId);
             }
-        } else if (strcmp("C", requestType) == 0) {
-            compactMemory();
-        } else if (strcmp("STAT", requestType) == 0) {
-            reportStatus();
+        } else if (tokenIs(verb, verbLength, "RLB")) {
+            if (!parseBulkItems(cursor, lineEnd, 0, &bulk)) {
+                printf("Usage: RLB <ProcessID> [<ProcessID> ...]\n");
+            } else {
+                releaseMemoryBulk(&bulk);
+            }
+        } else if (tokenIs(verb, verbLength, "C")) {
+            size_t blocksLength, bytesLength;
+            const char *blocks = nextToken(&cursor, lineEnd, &blocksLength);
+            const char *bytes = nextToken(&cursor, lineEnd, &bytesLength);
+            int maxBlocks = 0;
+            AllocatorSize maxBytes = 0;
+            if ((blocks && !parseIntToken(blocks, blocksLength, &maxBlocks)) ||
+                (bytes && !parseSizeToken(bytes, bytesLength, &maxBytes)) || maxBlocks < 0 || maxBytes < 0) {
+                printf("Usage: C [<MaxBlocks> [<MaxBytes>]]\n");
+            } else {
+                compactMemory(maxBlocks, maxBytes);
+            }
+        } else if (tokenIs(verb, verbLength, "STAT")) {
+            size_t countLength;
+            const char *from = nextToken(&cursor, lineEnd, &length);
+            BlockFilter filter = tokenIs(from, length, "FREE")   ? LIST_FREE_BLOCKS
+                                 : tokenIs(from, length, "USED") ? LIST_USED_BLOCKS
+                                                                 : LIST_ALL_BLOCKS;
+            if (filter != LIST_ALL_BLOCKS)
+                from = nextToken(&cursor, lineEnd, &length);
+            const char *count = nextToken(&cursor, lineEnd, &countLength);
+            AllocatorSize fromAddress = 0;
+            int limit = 0;
+            if (!from && filter == LIST_ALL_BLOCKS) {
+                reportStatus();
+            } else if (tokenIs(from, length, "SUMMARY") && filter == LIST_ALL_BLOCKS && !count) {
+                reportSummary();
+            } else if ((from && !parseSizeToken(from, length, &fromAddress)) ||
+                       (count && !parseIntToken(count, countLength, &limit)) || limit < 0 ||
+                       nextToken(&cursor, lineEnd, &length)) {
+                printf("Usage: STAT [SUMMARY] or STAT [FREE|USED] [<From> [<Count>]]\n");
+            } else {
+                reportBlocks(filter, fromAddress, limit);
+            }
+        } else if (tokenIs(verb, verbLength, "PERF")) {
+            reportPerf();
+        } else if (tokenIs(verb, verbLength, "SAVE") || tokenIs(verb, verbLength, "LOAD")) {
+            const char *file = nextToken(&cursor, lineEnd, &length);
+            if (!file) {
+                printf("Usage: %.*s <File>\n", (int)verbLength, verb);
+            } else {
+                command[file - command + length] = '\0';
+                if (verb[0] == 'S')
+                    saveHeap(file);
+                else
+                    loadHeap(file);
+            }
         } else {
-            printf("Unrecognized command. Valid commands: RQ, RL, C, STAT, X\n");
+            printf("Unrecognized command. Valid commands: RQ, RQW, CANCEL, RQB, RS, RL, RLB, C, STAT, PERF, SAVE, LOAD, X\n");
         }
+        // Use the gap before the next prompt for one bounded step of any compaction the policy
+        // started; the rest runs over later prompts and commands, so no prompt waits on all of it
+        allocator_idle(heap);
+        printWakeReports();
     }
 
     printf("Exiting allocator. Goodbye!\n");
-    cleanupMemory();
+    if (perfPath)
+        writePerfJson(perfPath);
+    stopRecording();
+    free(bulk.processIds);
+    free(bulk.sizes);
+    allocator_destroy(heap);
+    free(wakeReports);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
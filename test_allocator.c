@@ -0,0 +1,1291 @@
+/**
+ * \file    test_allocator.c
+ * \brief   Regression checks for the allocator library.
+ *
+ * Runs each check on every engine and prints one line per failed expectation.
+ * Exits 0 when every check passes, 1 otherwise.
+ *
+ * Compile: gcc -pthread -o test_allocator test_allocator.c allocator.c allocator_arena.c
+ * Run: ./test_allocator
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "allocator_arena.h"
+
+static int failures;
+
+/** Records a failed expectation. */
+static void expect(int condition, const char *engineName, const char *what) {
+    if (!condition) {
+        printf("FAIL [%s] %s\n", engineName, what);
+        failures++;
+    }
+}
+
+#define MAX_LAYOUT_BLOCKS 4096
+
+/** One block of a recorded layout, with its owner copied out of the allocator. */
+typedef struct LayoutBlock {
+    AllocatorSize startAddress;
+    AllocatorSize endAddress;
+    int isFree;
+    char owner[ALLOCATOR_PROCESS_ID_SIZE];
+} LayoutBlock;
+
+/** A heap's blocks in address order, as allocator_for_each_block reports them. */
+typedef struct Layout {
+    int count;
+    LayoutBlock blocks[MAX_LAYOUT_BLOCKS];
+} Layout;
+
+static void recordBlock(const AllocatorBlock *block, void *context) {
+    Layout *layout = (Layout *)context;
+    if (layout->count == MAX_LAYOUT_BLOCKS)
+        return;
+    LayoutBlock *entry = &layout->blocks[layout->count++];
+    entry->startAddress = block->startAddress;
+    entry->endAddress = block->endAddress;
+    entry->isFree = block->isFree;
+    snprintf(entry->owner, sizeof(entry->owner), "%s", block->isFree ? "" : block->owner);
+}
+
+/** Records the heap's current layout into *layout. */
+static void recordLayout(const Allocator *heap, Layout *layout) {
+    layout->count = 0;
+    allocator_for_each_block(heap, recordBlock, layout);
+}
+
+/** Returns 1 if both layouts hold the same blocks with the same owners. */
+static int sameLayout(const Layout *a, const Layout *b) {
+    if (a->count != b->count)
+        return 0;
+    for (int i = 0; i < a->count; i++) {
+        const LayoutBlock *x = &a->blocks[i], *y = &b->blocks[i];
+        if (x->startAddress != y->startAddress || x->endAddress != y->endAddress || x->isFree != y->isFree ||
+            strcmp(x->owner, y->owner) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/** Returns the recorded block owned by processId, or NULL. */
+static const LayoutBlock *findOwner(const Layout *layout, const char *processId) {
+    for (int i = 0; i < layout->count; i++)
+        if (!layout->blocks[i].isFree && strcmp(layout->blocks[i].owner, processId) == 0)
+            return &layout->blocks[i];
+    return NULL;
+}
+
+/** Process IDs that do not fit ALLOCATOR_PROCESS_ID_SIZE are rejected by every entry point
+ *  instead of being stored cut short, where no lookup could find them again. */
+static void testLongProcessIds(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    char longest[ALLOCATOR_PROCESS_ID_SIZE], tooLong[ALLOCATOR_PROCESS_ID_SIZE + 1];
+    memset(longest, 'p', sizeof(longest) - 1);
+    longest[sizeof(longest) - 1] = '\0';
+    memset(tooLong, 'p', sizeof(tooLong) - 1);
+    tooLong[sizeof(tooLong) - 1] = '\0';
+
+    Allocator *heap = allocator_create(4096, engine);
+    AllocatorBlock block;
+    expect(allocator_allocate(heap, tooLong, 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_INVALID_ID, name,
+           "allocate rejects a long ID");
+    expect(allocator_allocate_aligned(heap, tooLong, 64, 16, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_INVALID_ID,
+           name, "allocate_aligned rejects a long ID");
+    expect(allocator_allocate(heap, NULL, 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_INVALID_ID, name,
+           "allocate rejects a NULL ID");
+    expect(allocator_release(heap, tooLong) == ALLOCATOR_ERR_INVALID_ID, name, "release rejects a long ID");
+    expect(allocator_resize(heap, tooLong, 32, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_INVALID_ID, name,
+           "resize rejects a long ID");
+    expect(allocator_cancel_wait(heap, tooLong) == ALLOCATOR_ERR_INVALID_ID, name, "cancel_wait rejects a long ID");
+    expect(allocator_allocate_or_wait(heap, tooLong, 64, 1, ALLOCATOR_FIRST_FIT, 0, &block, NULL, NULL, NULL) ==
+               ALLOCATOR_ERR_INVALID_ID,
+           name, "allocate_or_wait rejects a long ID");
+
+    AllocatorRequest requests[2] = {{.processId = tooLong, .size = 64}, {.processId = longest, .size = 64}};
+    expect(allocator_allocate_many(heap, requests, 2, ALLOCATOR_FIRST_FIT) == 1, name, "allocate_many places one");
+    expect(requests[0].status == ALLOCATOR_ERR_INVALID_ID, name, "allocate_many rejects a long ID");
+    expect(requests[1].status == ALLOCATOR_OK, name, "allocate_many places the longest valid ID");
+    expect(allocator_allocate(heap, longest, 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_EXISTS, name,
+           "the longest valid ID is found again");
+
+    const char *processIds[2] = {tooLong, longest};
+    AllocatorStatus statuses[2];
+    expect(allocator_release_many(heap, processIds, 2, statuses) == 1, name, "release_many releases one");
+    expect(statuses[0] == ALLOCATOR_ERR_INVALID_ID, name, "release_many rejects a long ID");
+    expect(statuses[1] == ALLOCATOR_OK, name, "release_many releases the longest valid ID");
+
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    expect(stats.allocatedBlockCount == 0, name, "no block is left behind");
+    allocator_destroy(heap);
+}
+
+/** The arena directory marks empty slots with an empty ID, so an empty process ID is
+ *  rejected up front, and IDs that own no block (released, or never placed) leave no entry. */
+static void testArenaProcessIds(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    AllocatorArenas *arenas = allocator_arenas_create(4096, 4, engine);
+    AllocatorBlock block;
+    expect(allocator_arenas_allocate(arenas, "", 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_INVALID_ID, name,
+           "arenas_allocate rejects an empty ID");
+    expect(allocator_arenas_release(arenas, "") == ALLOCATOR_ERR_INVALID_ID, name,
+           "arenas_release rejects an empty ID");
+
+    expect(allocator_arenas_allocate(arenas, "big", 8192, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_NO_SPACE,
+           name, "arenas_allocate fails a request no arena holds");
+    expect(allocator_arenas_release(arenas, "big") == ALLOCATOR_ERR_NOT_FOUND, name,
+           "a failed allocation leaves no owner behind");
+    expect(allocator_arenas_allocate(arenas, "big", 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_OK, name,
+           "the failed ID can allocate later");
+
+    // Churn through far more unique IDs than one shard's first table holds.
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    int churned = 1;
+    for (int i = 0; i < 20000 && churned; i++) {
+        snprintf(processId, sizeof(processId), "c%d", i);
+        churned = allocator_arenas_allocate(arenas, processId, 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_OK &&
+                  allocator_arenas_release(arenas, processId) == ALLOCATOR_OK;
+    }
+    expect(churned, name, "unique IDs allocate and release under churn");
+    expect(allocator_arenas_allocate(arenas, "big", 64, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_EXISTS, name,
+           "a live ID is still found after churn");
+    expect(allocator_arenas_release(arenas, "big") == ALLOCATOR_OK, name, "the live ID releases after churn");
+    expect(allocator_arenas_release(arenas, "c0") == ALLOCATOR_ERR_NOT_FOUND, name,
+           "a released ID is gone from the directory");
+
+    // The totals add up every arena's block counts and free-size histogram.
+    allocator_arenas_allocate(arenas, "x", 64, ALLOCATOR_FIRST_FIT, &block);
+    allocator_arenas_allocate(arenas, "y", 64, ALLOCATOR_FIRST_FIT, &block);
+    AllocatorArenaStats stats;
+    allocator_arenas_stats(arenas, &stats);
+    int histogramBlocks = 0;
+    for (int sizeClass = 0; sizeClass < ALLOCATOR_SIZE_CLASS_COUNT; sizeClass++)
+        histogramBlocks += stats.total.freeSizeHistogram[sizeClass];
+    expect(stats.total.allocatedBlockCount == 2, name, "arena totals count allocated blocks");
+    expect(stats.total.freeBlockCount == stats.total.blockCount - 2 && stats.total.freeBlockCount >= 4, name,
+           "arena totals count FREE blocks");
+    expect(histogramBlocks == stats.total.freeBlockCount, name, "arena totals sum the free-size histogram");
+    allocator_arenas_destroy(arenas);
+}
+
+/** A bulk item that finds no room gets the policy's compact-and-retry like a single
+ *  allocation, and items placed before the compaction report where they ended up. */
+static void testBulkCompactOnFailure(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    if (engine == ALLOCATOR_ENGINE_BUDDY)
+        return; // Never compacts
+    Allocator *heap = allocator_create(1024, engine);
+    AllocatorCompactionPolicy policy = {1.0, 8, 0, 1000, 1};
+    allocator_set_compaction_policy(heap, &policy);
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    for (int i = 0; i < 16; i++) {
+        snprintf(processId, sizeof(processId), "p%d", i);
+        allocator_allocate(heap, processId, 64, ALLOCATOR_FIRST_FIT, &block);
+    }
+    for (int i = 0; i < 16; i += 2) {
+        snprintf(processId, sizeof(processId), "p%d", i);
+        allocator_release(heap, processId);
+    }
+
+    AllocatorRequest requests[2] = {{.processId = "big", .size = 256}, {.processId = "small", .size = 64}};
+    expect(allocator_allocate_many(heap, requests, 2, ALLOCATOR_FIRST_FIT) == 2, name,
+           "allocate_many compacts to place an item that found no room");
+    static Layout layout;
+    recordLayout(heap, &layout);
+    for (int i = 0; i < 2; i++) {
+        const LayoutBlock *placed = findOwner(&layout, requests[i].processId);
+        expect(requests[i].status == ALLOCATOR_OK && placed && placed->startAddress == requests[i].block.startAddress &&
+                   placed->endAddress == requests[i].block.endAddress,
+               name, "allocate_many reports blocks where they are after compacting");
+    }
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    expect(stats.failureCompactions == 1, name, "allocate_many compacts once for the batch");
+    allocator_destroy(heap);
+}
+
+/** Deterministic xorshift generator, so a failing seed replays exactly. */
+static unsigned nextRandom(unsigned *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+#define MAX_RELOCATIONS 4096
+
+/** Relocation runs reported by one compaction call. */
+typedef struct RelocationLog {
+    int count;
+    AllocatorRelocation runs[MAX_RELOCATIONS];
+} RelocationLog;
+
+static void recordRelocation(const AllocatorRelocation *relocation, void *context) {
+    RelocationLog *log = (RelocationLog *)context;
+    if (log->count < MAX_RELOCATIONS)
+        log->runs[log->count] = *relocation;
+    log->count++;
+}
+
+/** Returns 1 if both logs hold the same runs. */
+static int sameRelocations(const RelocationLog *a, const RelocationLog *b) {
+    if (a->count != b->count)
+        return 0;
+    for (int i = 0; i < a->count && i < MAX_RELOCATIONS; i++) {
+        const AllocatorRelocation *x = &a->runs[i], *y = &b->runs[i];
+        if (x->oldStart != y->oldStart || x->newStart != y->newStart || x->size != y->size ||
+            x->blockCount != y->blockCount)
+            return 0;
+    }
+    return 1;
+}
+
+/** Returns 1 if both heaps report the same counters that do not depend on the engine. */
+static int sameStats(Allocator *a, Allocator *b) {
+    AllocatorStats x, y;
+    allocator_stats(a, &x);
+    allocator_stats(b, &y);
+    return x.freeBytes == y.freeBytes && x.largestFreeBlock == y.largestFreeBlock && x.blockCount == y.blockCount &&
+           x.freeBlockCount == y.freeBlockCount && x.allocatedBlockCount == y.allocatedBlockCount &&
+           memcmp(x.freeSizeHistogram, y.freeSizeHistogram, sizeof(x.freeSizeHistogram)) == 0 &&
+           x.splits == y.splits && x.merges == y.merges && x.blocksMoved == y.blocksMoved &&
+           x.bytesMoved == y.bytesMoved && x.resizesInPlace == y.resizesInPlace && x.resizesMoved == y.resizesMoved;
+}
+
+/** Returns 1 if two reported blocks cover the same range for the same owner. */
+static int sameBlock(const AllocatorBlock *a, const AllocatorBlock *b) {
+    return a->startAddress == b->startAddress && a->endAddress == b->endAddress && a->size == b->size;
+}
+
+/** Shapes of the random operation sequences the differential test runs. */
+typedef struct DifferentialWorkload {
+    AllocatorSize heapSize;
+    AllocatorSize maxRequest;  // Request sizes are drawn from [1, maxRequest]
+    int operations;
+} DifferentialWorkload;
+
+/** Heap shapes a differential run passed through, to show which scan paths it reached. */
+typedef struct DifferentialCoverage {
+    int maxFreeBlocks;  // Most FREE blocks at once
+    int raggedScans;    // Calls made with more than 16 FREE blocks and a block count that is not a multiple of 16
+} DifferentialCoverage;
+
+/** Runs one seeded sequence of allocate, aligned allocate, bulk allocate, release, resize,
+ *  compact and compact-step calls on the list and array engines side by side, and checks
+ *  after every call that both return the same status and blocks, report the same
+ *  relocation runs and counters, and hold the same layout. Stops at the first mismatch. */
+static void runDifferential(AllocatorStrategy strategy, unsigned seed, const DifferentialWorkload *workload,
+                            DifferentialCoverage *coverage) {
+    char name[80];
+    snprintf(name, sizeof(name), "list/array %s seed %u (%s scans)", allocator_strategy_name(strategy), seed,
+             allocator_scan_kernels());
+    Allocator *heaps[2] = {allocator_create(workload->heapSize, ALLOCATOR_ENGINE_LIST),
+                           allocator_create(workload->heapSize, ALLOCATOR_ENGINE_ARRAY)};
+    static RelocationLog logs[2];
+    static Layout layouts[2];
+    for (int engine = 0; engine < 2; engine++)
+        allocator_set_relocation_visitor(heaps[engine], recordRelocation, &logs[engine]);
+
+    enum { MAX_LIVE = 1024, BULK_SIZE = 8 };
+    static char live[MAX_LIVE][ALLOCATOR_PROCESS_ID_SIZE];
+    int liveCount = 0, nextId = 0, matched = 1;
+    for (int op = 0; op < workload->operations && matched; op++) {
+        unsigned choice = nextRandom(&seed) % 100;
+        AllocatorStats before;
+        allocator_stats(heaps[1], &before);
+        if (before.freeBlockCount > coverage->maxFreeBlocks)
+            coverage->maxFreeBlocks = before.freeBlockCount;
+        if (before.freeBlockCount > 16 && before.blockCount % 16 != 0)
+            coverage->raggedScans++;
+        AllocatorStatus statuses[2];
+        AllocatorBlock blocks[2];
+        memset(blocks, 0, sizeof(blocks));
+        logs[0].count = logs[1].count = 0;
+        if (choice < 45 || liveCount == 0) {
+            char processId[ALLOCATOR_PROCESS_ID_SIZE];
+            snprintf(processId, sizeof(processId), "d%d", nextId++);
+            AllocatorSize size = 1 + nextRandom(&seed) % workload->maxRequest;
+            AllocatorSize alignment = choice < 10 ? (AllocatorSize)1 << (nextRandom(&seed) % 7) : 1;
+            for (int engine = 0; engine < 2; engine++)
+                statuses[engine] =
+                    allocator_allocate_aligned(heaps[engine], processId, size, alignment, strategy, &blocks[engine]);
+            if (statuses[0] == ALLOCATOR_OK && liveCount < MAX_LIVE)
+                strcpy(live[liveCount++], processId);
+            else if (statuses[0] == ALLOCATOR_OK)
+                allocator_release(heaps[0], processId), allocator_release(heaps[1], processId);
+        } else if (choice < 50) {
+            AllocatorRequest requests[2][BULK_SIZE];
+            char processIds[BULK_SIZE][ALLOCATOR_PROCESS_ID_SIZE];
+            int count = 1 + nextRandom(&seed) % BULK_SIZE;
+            for (int i = 0; i < count; i++) {
+                snprintf(processIds[i], sizeof(processIds[i]), "d%d", nextId++);
+                requests[0][i].processId = requests[1][i].processId = processIds[i];
+                requests[0][i].size = requests[1][i].size = 1 + nextRandom(&seed) % workload->maxRequest;
+            }
+            for (int engine = 0; engine < 2; engine++)
+                statuses[engine] = (AllocatorStatus)allocator_allocate_many(heaps[engine], requests[engine], count,
+                                                                            strategy);
+            for (int i = 0; i < count && matched; i++) {
+                matched = requests[0][i].status == requests[1][i].status &&
+                          (requests[0][i].status != ALLOCATOR_OK || sameBlock(&requests[0][i].block, &requests[1][i].block));
+                if (requests[0][i].status != ALLOCATOR_OK)
+                    continue;
+                if (liveCount < MAX_LIVE)
+                    strcpy(live[liveCount++], processIds[i]);
+                else
+                    allocator_release(heaps[0], processIds[i]), allocator_release(heaps[1], processIds[i]);
+            }
+        } else if (choice < 80) {
+            int victim = nextRandom(&seed) % liveCount;
+            for (int engine = 0; engine < 2; engine++)
+                statuses[engine] = allocator_release(heaps[engine], live[victim]);
+            memcpy(live[victim], live[--liveCount], sizeof(live[victim]));
+        } else if (choice < 93) {
+            int victim = nextRandom(&seed) % liveCount;
+            AllocatorSize size = 1 + nextRandom(&seed) % (workload->maxRequest * 2);
+            for (int engine = 0; engine < 2; engine++)
+                statuses[engine] = allocator_resize(heaps[engine], live[victim], size, strategy, &blocks[engine]);
+        } else if (choice < 97) {
+            int maxBlocks = nextRandom(&seed) % 4;
+            AllocatorSize maxBytes = nextRandom(&seed) % 2 ? 0 : 1 + nextRandom(&seed) % workload->maxRequest;
+            for (int engine = 0; engine < 2; engine++)
+                statuses[engine] = (AllocatorStatus)allocator_compact_step(heaps[engine], maxBlocks, maxBytes);
+        } else {
+            for (int engine = 0; engine < 2; engine++)
+                allocator_compact(heaps[engine]);
+            statuses[0] = statuses[1] = ALLOCATOR_OK;
+        }
+
+        recordLayout(heaps[0], &layouts[0]);
+        recordLayout(heaps[1], &layouts[1]);
+        matched = matched && statuses[0] == statuses[1] &&
+                  (statuses[0] != ALLOCATOR_OK || sameBlock(&blocks[0], &blocks[1])) &&
+                  sameRelocations(&logs[0], &logs[1]) && sameStats(heaps[0], heaps[1]) &&
+                  sameLayout(&layouts[0], &layouts[1]);
+        if (!matched)
+            printf("  diverged at operation %d\n", op);
+    }
+    expect(matched, name, "list and array engines agree");
+    allocator_destroy(heaps[0]);
+    allocator_destroy(heaps[1]);
+}
+
+/** The array engine places exactly like the list engine under First, Best and Worst Fit,
+ *  whatever mix of calls drives them. */
+static void testArrayMatchesList(void) {
+    const DifferentialWorkload workload = {4096, 200, 3000};
+    const AllocatorStrategy strategies[] = {ALLOCATOR_FIRST_FIT, ALLOCATOR_BEST_FIT, ALLOCATOR_WORST_FIT};
+    DifferentialCoverage coverage = {0, 0};
+    for (int i = 0; i < 3; i++)
+        for (unsigned seed = 1; seed <= 8; seed++)
+            runDifferential(strategies[i], seed * 2654435761u, &workload, &coverage);
+}
+
+/** The array engine's vector First and Best Fit kernels return the block the scalar loop
+ *  (and so the list engine) would. Many small blocks keep well over 16 FREE blocks in the
+ *  heap, and block counts that are not a multiple of 16 leave ragged tails for the kernels'
+ *  remainder handling. Build with -DALLOCATOR_NO_SIMD to check the scalar loops the same way. */
+static void testVectorScansMatchList(void) {
+    const DifferentialWorkload workload = {32768, 48, 4000};
+    const AllocatorStrategy strategies[] = {ALLOCATOR_FIRST_FIT, ALLOCATOR_BEST_FIT};
+    for (int i = 0; i < 2; i++) {
+        DifferentialCoverage coverage = {0, 0};
+        for (unsigned seed = 1; seed <= 4; seed++)
+            runDifferential(strategies[i], seed * 40503u, &workload, &coverage);
+        expect(coverage.maxFreeBlocks > 64, allocator_strategy_name(strategies[i]),
+               "the vector scan workload keeps many FREE blocks");
+        expect(coverage.raggedScans > 1000, allocator_strategy_name(strategies[i]),
+               "the vector scan workload leaves ragged tails");
+    }
+}
+
+/** A snapshot restores to the same blocks and counters, and any truncated or altered
+ *  snapshot is rejected instead of rebuilding a different heap. */
+static void testSnapshotRoundTrip(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    Allocator *heap = allocator_create(4096, engine);
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    unsigned seed = 12345;
+    for (int i = 0; i < 40; i++) {
+        snprintf(processId, sizeof(processId), "s%d", i);
+        allocator_allocate_aligned(heap, processId, 1 + nextRandom(&seed) % 150, (AllocatorSize)1 << (i % 4),
+                                   ALLOCATOR_BEST_FIT, &block);
+    }
+    for (int i = 0; i < 40; i += 3) {
+        snprintf(processId, sizeof(processId), "s%d", i);
+        allocator_release(heap, processId);
+    }
+    allocator_resize(heap, "s1", 200, ALLOCATOR_FIRST_FIT, &block);
+
+    size_t size = allocator_snapshot_size(heap);
+    unsigned char *snapshot = (unsigned char *)malloc(size);
+    allocator_snapshot(heap, snapshot);
+    Allocator *restored = allocator_restore(snapshot, size);
+    expect(restored != NULL, name, "a snapshot restores");
+    if (restored) {
+        static Layout before, after;
+        recordLayout(heap, &before);
+        recordLayout(restored, &after);
+        expect(sameLayout(&before, &after), name, "a restored heap has the saved blocks");
+        AllocatorStats x, y;
+        allocator_stats(heap, &x);
+        allocator_stats(restored, &y);
+        expect(x.engine == y.engine && x.totalSize == y.totalSize && x.freeBytes == y.freeBytes &&
+                   x.largestFreeBlock == y.largestFreeBlock && x.blockCount == y.blockCount &&
+                   x.freeBlockCount == y.freeBlockCount && x.allocatedBlockCount == y.allocatedBlockCount &&
+                   memcmp(x.freeSizeHistogram, y.freeSizeHistogram, sizeof(x.freeSizeHistogram)) == 0 &&
+                   x.internalFragmentation == y.internalFragmentation && x.unusableBytes == y.unusableBytes &&
+                   x.granuleSize == y.granuleSize,
+               name, "a restored heap has the saved counters");
+        expect(allocator_allocate(restored, "s2", 16, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_EXISTS, name,
+               "a restored heap finds the saved owners");
+        allocator_destroy(restored);
+    }
+
+    int truncatedRejected = 1, flippedRejected = 1;
+    for (size_t length = 0; length < size; length++) {
+        Allocator *bad = allocator_restore(snapshot, length);
+        truncatedRejected &= bad == NULL;
+        allocator_destroy(bad);
+    }
+    for (size_t i = 0; i < size; i++) {
+        for (int bit = 0; bit < 8; bit += 7) {
+            snapshot[i] ^= (unsigned char)(1u << bit);
+            Allocator *bad = allocator_restore(snapshot, size);
+            flippedRejected &= bad == NULL;
+            allocator_destroy(bad);
+            snapshot[i] ^= (unsigned char)(1u << bit);
+        }
+    }
+    expect(truncatedRejected, name, "truncated snapshots are rejected");
+    expect(flippedRejected, name, "snapshots with a flipped bit are rejected");
+    free(snapshot);
+    allocator_destroy(heap);
+}
+
+/** Fills a heap with unaligned blocks named prefix0, prefix1, ... and releases about a third
+ *  of them at random, leaving holes for compaction to close. */
+static void fragmentHeap(Allocator *heap, const char *prefix, int blocks, unsigned seed) {
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    for (int i = 0; i < blocks; i++) {
+        snprintf(processId, sizeof(processId), "%s%d", prefix, i);
+        allocator_allocate(heap, processId, 1 + nextRandom(&seed) % 120, ALLOCATOR_FIRST_FIT, &block);
+    }
+    for (int i = 0; i < blocks; i++) {
+        snprintf(processId, sizeof(processId), "%s%d", prefix, i);
+        if (nextRandom(&seed) % 3 == 0)
+            allocator_release(heap, processId);
+    }
+}
+
+/** Each compaction step stays within its block and byte budget (a step that moves a single
+ *  block may exceed the byte budget), and stepping to the end reaches the layout a single
+ *  allocator_compact does, even with allocations and releases between the steps. */
+static void testCompactStepBudget(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    if (engine == ALLOCATOR_ENGINE_BUDDY)
+        return; // Never compacts
+    const struct { int maxBlocks; AllocatorSize maxBytes; } budgets[] = {{1, 0}, {3, 0}, {0, 100}, {4, 150}};
+    for (int b = 0; b < 4; b++) {
+        Allocator *stepped = allocator_create(8192, engine), *whole = allocator_create(8192, engine);
+        fragmentHeap(stepped, "k", 80, 777 + b);
+        fragmentHeap(whole, "k", 80, 777 + b);
+        allocator_compact(whole);
+
+        int withinBudget = 1, steps = 0, done = 0;
+        AllocatorStats before, after;
+        while (!done && steps < 1000) {
+            allocator_stats(stepped, &before);
+            done = allocator_compact_step(stepped, budgets[b].maxBlocks, budgets[b].maxBytes);
+            allocator_stats(stepped, &after);
+            long long blocks = after.blocksMoved - before.blocksMoved, bytes = after.bytesMoved - before.bytesMoved;
+            withinBudget &= (budgets[b].maxBlocks == 0 || blocks <= budgets[b].maxBlocks) &&
+                            (budgets[b].maxBytes == 0 || blocks <= 1 || bytes <= budgets[b].maxBytes);
+            steps++;
+        }
+        static Layout steppedLayout, wholeLayout;
+        recordLayout(stepped, &steppedLayout);
+        recordLayout(whole, &wholeLayout);
+        expect(withinBudget, name, "compaction steps stay within their budget");
+        expect(done && steps > 1, name, "bounded steps finish the compaction over several calls");
+        expect(sameLayout(&steppedLayout, &wholeLayout), name, "stepping reaches the layout allocator_compact does");
+        allocator_destroy(stepped);
+        allocator_destroy(whole);
+    }
+
+    // Allocate and release between steps; the heap still ends fully compacted.
+    Allocator *heap = allocator_create(8192, engine);
+    fragmentHeap(heap, "k", 80, 4242);
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    unsigned seed = 99;
+    int steps = 0, done = 0;
+    while (!done && steps < 1000) {
+        done = allocator_compact_step(heap, 2, 0);
+        steps++;
+        if (steps > 20)
+            continue; // Stop disturbing the heap so the compaction can finish
+        snprintf(processId, sizeof(processId), "k%u", nextRandom(&seed) % 80);
+        allocator_release(heap, processId);
+        snprintf(processId, sizeof(processId), "n%d", steps);
+        allocator_allocate(heap, processId, 1 + nextRandom(&seed) % 120, ALLOCATOR_FIRST_FIT, &block);
+        done = 0;
+    }
+    AllocatorStats before, after;
+    allocator_stats(heap, &before);
+    allocator_compact(heap);
+    allocator_stats(heap, &after);
+    expect(done, name, "interleaved compaction steps finish");
+    expect(before.freeBlockCount <= 1, name, "interleaved steps leave one FREE block");
+    expect(after.blocksMoved == before.blocksMoved, name, "allocator_compact has nothing left after the steps");
+    allocator_destroy(heap);
+}
+
+/** Compaction reports adjacent blocks that slide by the same distance as one relocation
+ *  run: behind three holes, runs of 3, 4 and 8 blocks arrive as three callbacks. */
+static void testRelocationRunsMerge(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    if (engine == ALLOCATOR_ENGINE_BUDDY)
+        return; // Never compacts
+    Allocator *heap = allocator_create(4096, engine);
+    const int runLengths[3] = {3, 4, 8};
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    for (int run = 0; run < 3; run++) {
+        snprintf(processId, sizeof(processId), "hole%d", run);
+        allocator_allocate(heap, processId, 32, ALLOCATOR_FIRST_FIT, &block);
+        for (int i = 0; i < runLengths[run]; i++) {
+            snprintf(processId, sizeof(processId), "r%d", run * 10 + i);
+            allocator_allocate(heap, processId, 32, ALLOCATOR_FIRST_FIT, &block);
+        }
+    }
+    for (int run = 0; run < 3; run++) {
+        snprintf(processId, sizeof(processId), "hole%d", run);
+        allocator_release(heap, processId);
+    }
+
+    static RelocationLog log;
+    log.count = 0;
+    allocator_set_relocation_visitor(heap, recordRelocation, &log);
+    allocator_compact(heap);
+    int merged = log.count == 3;
+    AllocatorSize oldStart = 32;
+    for (int run = 0; run < 3 && merged; run++) {
+        const AllocatorRelocation *relocation = &log.runs[run];
+        merged = relocation->blockCount == runLengths[run] && relocation->size == 32 * runLengths[run] &&
+                 relocation->oldStart == oldStart && relocation->newStart == oldStart - 32 * (run + 1);
+        oldStart += 32 * (runLengths[run] + 1);
+    }
+    expect(merged, name, "adjacent moves arrive as one relocation run per hole");
+    allocator_destroy(heap);
+}
+
+/** A resize grows into the FREE block after it or shrinks where it is, and moves only when
+ *  there is no room to grow; the block reported is where it ends up. */
+static void testResize(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    Allocator *heap = allocator_create(4096, engine);
+    AllocatorBlock a, b;
+    AllocatorStats stats;
+    allocator_allocate(heap, "a", 64, ALLOCATOR_FIRST_FIT, &a);
+    expect(allocator_resize(heap, "a", 128, ALLOCATOR_FIRST_FIT, &a) == ALLOCATOR_OK && a.startAddress == 0 &&
+               a.size >= 128,
+           name, "resize grows into the FREE block after it");
+    allocator_allocate(heap, "b", 128, ALLOCATOR_FIRST_FIT, &b);
+    expect(allocator_resize(heap, "a", 32, ALLOCATOR_FIRST_FIT, &a) == ALLOCATOR_OK && a.startAddress == 0 &&
+               a.size < 128,
+           name, "resize shrinks in place");
+    allocator_stats(heap, &stats);
+    expect(stats.resizesInPlace == 2 && stats.resizesMoved == 0, name, "growing and shrinking do not move the block");
+
+    expect(allocator_resize(heap, "a", 512, ALLOCATOR_FIRST_FIT, &a) == ALLOCATOR_OK && a.startAddress > b.endAddress &&
+               a.size >= 512,
+           name, "resize moves the block when the next one is taken");
+    allocator_stats(heap, &stats);
+    expect(stats.resizesMoved == 1 && stats.allocatedBlockCount == 2, name, "a moving resize leaves one block");
+    static Layout layout;
+    recordLayout(heap, &layout);
+    const LayoutBlock *moved = findOwner(&layout, "a");
+    expect(moved && moved->startAddress == a.startAddress, name, "the reported block is where the owner is");
+    expect(allocator_resize(heap, "a", 8192, ALLOCATOR_FIRST_FIT, &a) == ALLOCATOR_ERR_NO_SPACE, name,
+           "resize fails when no block can hold the new size");
+    expect(allocator_resize(heap, "missing", 64, ALLOCATOR_FIRST_FIT, &a) == ALLOCATOR_ERR_NOT_FOUND, name,
+           "resize of an unknown ID fails");
+    allocator_destroy(heap);
+}
+
+#define MAX_WAKES 8
+
+/** Completions seen by waitCallback, in order. A callback for wakeTrigger cancels cancelOnWake. */
+typedef struct WaitLog {
+    Allocator *heap;
+    int count;
+    char processIds[MAX_WAKES][ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorStatus statuses[MAX_WAKES];
+    const char *wakeTrigger;
+    const char *cancelOnWake;
+} WaitLog;
+
+static void waitCallback(const char *processId, const AllocatorFuture *future, void *context) {
+    WaitLog *log = (WaitLog *)context;
+    if (log->count < MAX_WAKES) {
+        snprintf(log->processIds[log->count], ALLOCATOR_PROCESS_ID_SIZE, "%s", processId);
+        log->statuses[log->count] = future->status;
+    }
+    log->count++;
+    if (log->wakeTrigger && strcmp(processId, log->wakeTrigger) == 0 && future->status == ALLOCATOR_OK)
+        allocator_cancel_wait(log->heap, log->cancelOnWake);
+}
+
+/** Fills a 1024-byte heap with four 256-byte blocks q0..q3. */
+static Allocator *createFullHeap(AllocatorEngine engine) {
+    Allocator *heap = allocator_create(1024, engine);
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    for (int i = 0; i < 4; i++) {
+        snprintf(processId, sizeof(processId), "q%d", i);
+        allocator_allocate(heap, processId, 256, ALLOCATOR_FIRST_FIT, &block);
+    }
+    return heap;
+}
+
+/** Parks processId for size bytes at priority, reporting to log and future. */
+static AllocatorStatus park(Allocator *heap, const char *processId, AllocatorSize size, int priority, WaitLog *log,
+                            AllocatorFuture *future) {
+    AllocatorBlock block;
+    return allocator_allocate_or_wait(heap, processId, size, 1, ALLOCATOR_FIRST_FIT, priority, &block, waitCallback,
+                                      log, future);
+}
+
+/** A parked request is woken by a release, a compaction or a shrinking resize, and its
+ *  future and the wait counters say so. */
+static void testWaitWakes(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    AllocatorStats stats;
+    AllocatorFuture future;
+    WaitLog log = {.heap = NULL};
+    static Layout layout;
+
+    // Woken by a release, into the block that was released.
+    Allocator *heap = createFullHeap(engine);
+    log.heap = heap;
+    AllocatorBlock block;
+    expect(allocator_allocate_or_wait(heap, "w", 1024 + 1, 1, ALLOCATOR_FIRST_FIT, 0, &block, waitCallback, &log,
+                                      &future) == ALLOCATOR_ERR_NO_SPACE,
+           name, "a request no empty heap holds fails instead of waiting");
+    expect(park(heap, "w", 256, 0, &log, &future) == ALLOCATOR_PENDING && future.status == ALLOCATOR_PENDING, name,
+           "a request that does not fit is parked");
+    expect(allocator_allocate(heap, "w", 16, ALLOCATOR_FIRST_FIT, &block) == ALLOCATOR_ERR_EXISTS, name,
+           "a parked ID cannot allocate again");
+    allocator_stats(heap, &stats);
+    expect(stats.waitingRequests == 1 && stats.parkedRequests == 1 && log.count == 0, name,
+           "a parked request is counted as waiting");
+    allocator_release(heap, "q2");
+    recordLayout(heap, &layout);
+    const LayoutBlock *placed = findOwner(&layout, "w");
+    expect(log.count == 1 && log.statuses[0] == ALLOCATOR_OK && future.status == ALLOCATOR_OK, name,
+           "a release wakes the parked request");
+    expect(placed && future.block.startAddress == 512 && placed->startAddress == 512 &&
+               future.block.endAddress == placed->endAddress && strcmp(future.block.owner, "w") == 0,
+           name, "the future describes the woken block");
+    allocator_stats(heap, &stats);
+    expect(stats.waitingRequests == 0 && stats.wokenRequests == 1 && stats.cancelledRequests == 0, name,
+           "a woken request is counted");
+    allocator_destroy(heap);
+
+    // Woken by a shrinking resize, into the space the shrink gave up.
+    heap = allocator_create(1024, engine);
+    log.heap = heap;
+    log.count = 0;
+    allocator_allocate(heap, "a", 512, ALLOCATOR_FIRST_FIT, &block);
+    allocator_allocate(heap, "b", 512, ALLOCATOR_FIRST_FIT, &block);
+    expect(park(heap, "w", 256, 0, &log, &future) == ALLOCATOR_PENDING, name, "a request waits on a full heap");
+    allocator_resize(heap, "a", 256, ALLOCATOR_FIRST_FIT, &block);
+    expect(log.count == 1 && future.status == ALLOCATOR_OK && future.block.startAddress == 256, name,
+           "a shrinking resize wakes the parked request");
+    allocator_destroy(heap);
+
+    // Woken by compaction, which joins two holes neither of which fits.
+    if (engine == ALLOCATOR_ENGINE_BUDDY)
+        return; // Never compacts
+    heap = createFullHeap(engine);
+    log.heap = heap;
+    log.count = 0;
+    allocator_release(heap, "q0");
+    allocator_release(heap, "q2");
+    expect(park(heap, "w", 512, 0, &log, &future) == ALLOCATOR_PENDING, name,
+           "a request larger than every hole waits");
+    allocator_compact(heap);
+    expect(log.count == 1 && future.status == ALLOCATOR_OK && future.block.startAddress == 512, name,
+           "compaction wakes the parked request");
+    allocator_destroy(heap);
+}
+
+/** Parked requests are retried oldest first, or highest priority first under
+ *  ALLOCATOR_WAIT_PRIORITY, which also reorders requests already parked. */
+static void testWaitOrder(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    for (int policy = 0; policy < 2; policy++) {
+        Allocator *heap = createFullHeap(engine);
+        WaitLog log = {.heap = heap};
+        AllocatorFuture futures[3];
+        park(heap, "p1", 256, 1, &log, &futures[0]);
+        park(heap, "p5", 256, 5, &log, &futures[1]);
+        park(heap, "p3", 256, 3, &log, &futures[2]);
+        if (policy)
+            allocator_set_wait_policy(heap, ALLOCATOR_WAIT_PRIORITY);
+        allocator_release(heap, "q1");
+        allocator_release(heap, "q3");
+        const char *first = policy ? "p5" : "p1", *second = policy ? "p3" : "p5";
+        expect(log.count == 2 && strcmp(log.processIds[0], first) == 0 && strcmp(log.processIds[1], second) == 0, name,
+               policy ? "priority order wakes the highest priority first" : "FIFO order wakes the oldest first");
+        AllocatorStats stats;
+        allocator_stats(heap, &stats);
+        expect(stats.waitingRequests == 1 && stats.wokenRequests == 2, name, "one request is left waiting");
+        allocator_destroy(heap);
+    }
+}
+
+/** Cancelling a parked request completes it as cancelled, including a cancel issued from
+ *  another request's completion callback while a wake is running. */
+static void testWaitCancel(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    Allocator *heap = createFullHeap(engine);
+    WaitLog log = {.heap = heap};
+    AllocatorFuture first, second, third;
+    park(heap, "c1", 256, 0, &log, &first);
+    expect(allocator_cancel_wait(heap, "c1") == ALLOCATOR_OK && first.status == ALLOCATOR_ERR_CANCELLED &&
+               log.count == 1 && log.statuses[0] == ALLOCATOR_ERR_CANCELLED,
+           name, "cancel completes the request as cancelled");
+    expect(allocator_cancel_wait(heap, "c1") == ALLOCATOR_ERR_NOT_FOUND, name, "a request is cancelled once");
+    expect(allocator_cancel_wait(heap, "q0") == ALLOCATOR_ERR_NOT_FOUND, name, "an owner that is not waiting");
+
+    // c2's callback cancels c3, which the same release would otherwise have placed.
+    log.count = 0;
+    log.wakeTrigger = "c2";
+    log.cancelOnWake = "c3";
+    park(heap, "c2", 256, 0, &log, &second);
+    park(heap, "c3", 256, 0, &log, &third);
+    const char *released[2] = {"q0", "q1"};
+    allocator_release_many(heap, released, 2, NULL);
+    expect(second.status == ALLOCATOR_OK && third.status == ALLOCATOR_ERR_CANCELLED && log.count == 2, name,
+           "a callback can cancel a request the running wake has not reached");
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    expect(stats.waitingRequests == 0 && stats.wokenRequests == 1 && stats.cancelledRequests == 2, name,
+           "cancelled requests are counted");
+    expect(stats.allocatedBlockCount == 3, name, "a cancelled request takes no block");
+    allocator_destroy(heap);
+}
+
+/** Deferred releases take effect before the owner's next allocate, resize or bulk call, and
+ *  leave the heap as eager releases would. A handle whose ID was released and then recycled
+ *  for another ID is ignored when drained. */
+static void testDeferredRelease(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    const char *triggers[3] = {"allocate", "resize", "allocate_many"};
+    for (int trigger = 0; trigger < 3; trigger++) {
+        Allocator *eager = allocator_create(4096, engine), *deferred = allocator_create(4096, engine);
+        expect(allocator_release_deferred(deferred, 0) == ALLOCATOR_ERR_QUEUE_FULL, name,
+               "deferred release needs the queue enabled");
+        allocator_enable_deferred_release(deferred, 8);
+        char processId[ALLOCATOR_PROCESS_ID_SIZE];
+        AllocatorHandle handles[16];
+        AllocatorBlock block;
+        for (int i = 0; i < 16; i++) {
+            snprintf(processId, sizeof(processId), "f%d", i);
+            allocator_allocate(eager, processId, 64 + 16 * (i % 3), ALLOCATOR_FIRST_FIT, &block);
+            allocator_allocate(deferred, processId, 64 + 16 * (i % 3), ALLOCATOR_FIRST_FIT, &block);
+            handles[i] = block.handle;
+        }
+        int queued = 1;
+        for (int i = 1; i < 16; i += 2) {
+            snprintf(processId, sizeof(processId), "f%d", i);
+            allocator_release(eager, processId);
+            queued &= allocator_release_deferred(deferred, handles[i]) == ALLOCATOR_OK;
+        }
+        AllocatorStats stats;
+        allocator_stats(deferred, &stats);
+        expect(queued && stats.allocatedBlockCount == 16, name, "queued releases wait for the owner");
+
+        AllocatorStatus statuses[2];
+        AllocatorRequest requests[2][1] = {{{.processId = "late", .size = 80}}, {{.processId = "late", .size = 80}}};
+        for (int heap = 0; heap < 2; heap++) {
+            Allocator *target = heap ? deferred : eager;
+            statuses[heap] = trigger == 0   ? allocator_allocate(target, "late", 80, ALLOCATOR_FIRST_FIT, &block)
+                             : trigger == 1 ? allocator_resize(target, "f0", 160, ALLOCATOR_FIRST_FIT, &block)
+                                            : (AllocatorStatus)allocator_allocate_many(target, requests[heap], 1,
+                                                                                       ALLOCATOR_FIRST_FIT);
+        }
+        static Layout eagerLayout, deferredLayout;
+        recordLayout(eager, &eagerLayout);
+        recordLayout(deferred, &deferredLayout);
+        allocator_stats(deferred, &stats);
+        expect(statuses[0] == statuses[1] && sameLayout(&eagerLayout, &deferredLayout) && sameStats(eager, deferred),
+               triggers[trigger], "deferred releases are applied before the owner's next call");
+        expect(stats.deferredReleases == 8 && stats.deferredMisses == 0, name, "every queued release is applied");
+        allocator_destroy(eager);
+        allocator_destroy(deferred);
+    }
+
+    Allocator *heap = allocator_create(4096, engine);
+    allocator_enable_deferred_release(heap, 8);
+    AllocatorBlock stale, fresh;
+    allocator_allocate(heap, "s", 64, ALLOCATOR_FIRST_FIT, &stale);
+    allocator_release(heap, "s");
+    allocator_allocate(heap, "t", 64, ALLOCATOR_FIRST_FIT, &fresh);
+    allocator_allocate(heap, "s", 64, ALLOCATOR_FIRST_FIT, &fresh);
+    allocator_release_deferred(heap, stale.handle);
+    allocator_drain_releases(heap);
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    expect(stats.allocatedBlockCount == 2 && stats.deferredMisses == 1, name, "a stale handle is counted as a miss");
+    expect(allocator_allocate(heap, "s", 64, ALLOCATOR_FIRST_FIT, &fresh) == ALLOCATOR_ERR_EXISTS &&
+               allocator_allocate(heap, "t", 64, ALLOCATOR_FIRST_FIT, &fresh) == ALLOCATOR_ERR_EXISTS,
+           name, "a stale handle leaves the IDs that reused it allocated");
+    allocator_destroy(heap);
+}
+
+#define PRODUCER_COUNT 4
+#define VICTIMS_PER_PRODUCER 256
+
+/** One producer thread's share of the deferred releases. */
+typedef struct Producer {
+    pthread_t thread;
+    Allocator *heap;
+    const AllocatorHandle *handles;
+    int count;
+    int failed;
+} Producer;
+
+static void *produceReleases(void *context) {
+    Producer *producer = (Producer *)context;
+    for (int i = 0; i < producer->count; i++) {
+        AllocatorStatus status;
+        while ((status = allocator_release_deferred(producer->heap, producer->handles[i])) == ALLOCATOR_ERR_QUEUE_FULL)
+            sched_yield(); // The owner has not drained yet
+        producer->failed += status != ALLOCATOR_OK;
+    }
+    return NULL;
+}
+
+/** Producer threads push releases through a small ring while the owner keeps allocating;
+ *  once they are drained the heap matches releasing the same blocks one by one. Victims
+ *  alternate with blocks that stay, and the owner asks for more than a victim's size, so
+ *  where its blocks land does not depend on how the threads interleave. */
+static void testDeferredReleaseThreads(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    enum { VICTIMS = PRODUCER_COUNT * VICTIMS_PER_PRODUCER };
+    Allocator *heap = allocator_create(65536, engine), *reference = allocator_create(65536, engine);
+    allocator_enable_deferred_release(heap, 1); // The smallest ring, so producers hit a full queue
+    static AllocatorHandle handles[VICTIMS];
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block;
+    for (int i = 0; i < VICTIMS; i++) {
+        snprintf(processId, sizeof(processId), "v%d", i);
+        allocator_allocate(heap, processId, 16, ALLOCATOR_FIRST_FIT, &block);
+        handles[i] = block.handle;
+        allocator_allocate(reference, processId, 16, ALLOCATOR_FIRST_FIT, &block);
+        snprintf(processId, sizeof(processId), "k%d", i);
+        allocator_allocate(heap, processId, 16, ALLOCATOR_FIRST_FIT, &block);
+        allocator_allocate(reference, processId, 16, ALLOCATOR_FIRST_FIT, &block);
+    }
+
+    Producer producers[PRODUCER_COUNT];
+    for (int i = 0; i < PRODUCER_COUNT; i++) {
+        producers[i] = (Producer){.heap = heap, .handles = handles + i * VICTIMS_PER_PRODUCER,
+                                  .count = VICTIMS_PER_PRODUCER};
+        pthread_create(&producers[i].thread, NULL, produceReleases, &producers[i]);
+    }
+    int ownerBlocks = 0;
+    AllocatorStats stats;
+    do {
+        if (ownerBlocks < 512) { // Allocating drains first; once enough blocks are placed, just drain
+            snprintf(processId, sizeof(processId), "o%d", ownerBlocks++);
+            allocator_allocate(heap, processId, 32, ALLOCATOR_FIRST_FIT, &block);
+        } else {
+            allocator_drain_releases(heap);
+        }
+        allocator_stats(heap, &stats);
+    } while (stats.deferredReleases + stats.deferredMisses < VICTIMS);
+    int failed = 0;
+    for (int i = 0; i < PRODUCER_COUNT; i++) {
+        pthread_join(producers[i].thread, NULL);
+        failed += producers[i].failed;
+    }
+
+    for (int i = 0; i < VICTIMS; i++) {
+        snprintf(processId, sizeof(processId), "v%d", i);
+        allocator_release(reference, processId);
+    }
+    for (int i = 0; i < ownerBlocks; i++) {
+        snprintf(processId, sizeof(processId), "o%d", i);
+        allocator_allocate(reference, processId, 32, ALLOCATOR_FIRST_FIT, &block);
+    }
+    static Layout layout, referenceLayout;
+    recordLayout(heap, &layout);
+    recordLayout(reference, &referenceLayout);
+    allocator_stats(heap, &stats);
+    expect(!failed && stats.deferredReleases == VICTIMS && stats.deferredMisses == 0, name,
+           "every release pushed by a producer thread is applied once");
+    expect(sameLayout(&layout, &referenceLayout), name, "concurrent deferred releases end as sequential ones");
+    allocator_destroy(heap);
+    allocator_destroy(reference);
+}
+
+/** The byte a backed block owned by processId holds at offset i: a hash of the owner mixed
+ *  with the offset, so a block copied to the wrong place or from the wrong offset shows. */
+static unsigned char stampByte(const char *processId, AllocatorSize i) {
+    unsigned hash = 2166136261u;
+    for (const char *c = processId; *c; c++)
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    return (unsigned char)(hash ^ (unsigned)(i * 131) ^ (unsigned)((i >> 8) * 29) ^ (unsigned)((i >> 16) * 7));
+}
+
+/** Returns 1 if the first length bytes of block hold its owner's stamp. */
+static int stampMatches(const AllocatorBlock *block, AllocatorSize length) {
+    const unsigned char *data = (const unsigned char *)block->data;
+    for (AllocatorSize i = 0; i < length; i++)
+        if (data[i] != stampByte(block->owner, i))
+            return 0;
+    return 1;
+}
+
+/** What checkStamp found across a backed heap's blocks. */
+typedef struct StampCheck {
+    const unsigned char *base;
+    int misplaced;  // Blocks whose data pointer is not base + startAddress
+    int corrupted;  // Allocated blocks whose requested bytes lost their stamp
+    int nonZero;    // Allocated blocks holding anything but zeroes
+} StampCheck;
+
+static void stampBlock(const AllocatorBlock *block, void *context) {
+    (void)context;
+    if (block->isFree)
+        return;
+    unsigned char *data = (unsigned char *)block->data;
+    for (AllocatorSize i = 0; i < block->requested; i++)
+        data[i] = stampByte(block->owner, i);
+}
+
+static void checkStamp(const AllocatorBlock *block, void *context) {
+    StampCheck *check = (StampCheck *)context;
+    if ((const unsigned char *)block->data != check->base + block->startAddress)
+        check->misplaced++;
+    if (block->isFree)
+        return;
+    if (!stampMatches(block, block->requested))
+        check->corrupted++;
+    const unsigned char *data = (const unsigned char *)block->data;
+    for (AllocatorSize i = 0; i < block->requested; i++)
+        if (data[i]) {
+            check->nonZero++;
+            break;
+        }
+}
+
+/** Checks every block of a backed heap against base and its owner's stamp. */
+static StampCheck checkStamps(const Allocator *heap) {
+    StampCheck check = {.base = (const unsigned char *)allocator_base(heap)};
+    allocator_for_each_block(heap, checkStamp, &check);
+    return check;
+}
+
+/** A search by owner through allocator_for_each_block. */
+typedef struct BlockSearch {
+    const char *processId;
+    AllocatorBlock *found;
+    int seen;
+} BlockSearch;
+
+static void matchOwner(const AllocatorBlock *block, void *context) {
+    BlockSearch *search = (BlockSearch *)context;
+    if (!block->isFree && strcmp(block->owner, search->processId) == 0) {
+        *search->found = *block;
+        search->seen = 1;
+    }
+}
+
+/** Copies the block owned by processId into *found. Returns 0 if there is none. */
+static int findBlock(const Allocator *heap, const char *processId, AllocatorBlock *found) {
+    BlockSearch search = {processId, found, 0};
+    allocator_for_each_block(heap, matchOwner, &search);
+    return search.seen;
+}
+
+/** Backed blocks carry their bytes through a budgeted compaction step, a full compaction
+ *  (remapping the large run's pages on Linux), a moving resize and, once restamped, the
+ *  same again on a heap rebuilt by allocator_restore_backed, whose blocks start zeroed. */
+static void testBackedDataFollowsBlocks(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    int compacts = engine != ALLOCATOR_ENGINE_BUDDY;
+    Allocator *heap = allocator_create_backed((AllocatorSize)4 << 20, engine);
+    expect(heap && allocator_base(heap), name, "a backed heap has a base");
+    if (!heap)
+        return;
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    AllocatorBlock block, moved;
+    AllocatorStats stats;
+    unsigned seed = 4242;
+    allocator_allocate(heap, "hole0", (AllocatorSize)1 << 20, ALLOCATOR_FIRST_FIT, &block);
+    allocator_allocate(heap, "big", ((AllocatorSize)512 << 10) + 100, ALLOCATOR_FIRST_FIT, &block);
+    for (int i = 0; i < 40; i++) {
+        snprintf(processId, sizeof(processId), "d%d", i);
+        allocator_allocate(heap, processId, 1 + nextRandom(&seed) % 4000, ALLOCATOR_FIRST_FIT, &block);
+    }
+    allocator_allocate(heap, "hole1", (AllocatorSize)64 << 10, ALLOCATOR_FIRST_FIT, &block);
+    allocator_allocate(heap, "tail", (AllocatorSize)300 << 10, ALLOCATOR_FIRST_FIT, &block);
+    allocator_release(heap, "hole0");
+    allocator_release(heap, "hole1");
+    for (int i = 0; i < 40; i += 3) {
+        snprintf(processId, sizeof(processId), "d%d", i);
+        allocator_release(heap, processId);
+    }
+    allocator_for_each_block(heap, stampBlock, NULL);
+    StampCheck check = checkStamps(heap);
+    expect(check.misplaced == 0 && check.corrupted == 0, name, "stamped blocks read back");
+
+    if (compacts) {
+        allocator_compact_step(heap, 2, 0);
+        allocator_stats(heap, &stats);
+        check = checkStamps(heap);
+        expect(stats.blocksMoved > 0 && check.misplaced == 0 && check.corrupted == 0, name,
+               "a compaction step moves the bytes with their blocks");
+        allocator_compact(heap);
+        allocator_stats(heap, &stats);
+        check = checkStamps(heap);
+        expect(stats.freeBlockCount == 1 && check.misplaced == 0 && check.corrupted == 0, name,
+               "compaction moves the bytes with their blocks");
+        expect(stats.bytesRemapped + stats.bytesCopied == stats.bytesMoved, name,
+               "every relocated byte is either remapped or copied");
+#if defined(__linux__)
+        expect(stats.bytesRemapped > 0, name, "a large page-aligned run is remapped");
+#endif
+    }
+
+    AllocatorBlock before;
+    expect(findBlock(heap, "d4", &before), name, "the block to resize exists");
+    AllocatorSize oldRequested = before.requested;
+    expect(allocator_resize(heap, "d4", 20000, ALLOCATOR_FIRST_FIT, &moved) == ALLOCATOR_OK &&
+               moved.startAddress != before.startAddress && stampMatches(&moved, oldRequested),
+           name, "a moving resize carries the old bytes to the new block");
+    allocator_for_each_block(heap, stampBlock, NULL);
+
+    size_t size = allocator_snapshot_size(heap);
+    void *snapshot = malloc(size);
+    allocator_snapshot(heap, snapshot);
+    Allocator *restored = allocator_restore_backed(snapshot, size);
+    free(snapshot);
+    expect(restored && allocator_base(restored) && allocator_base(restored) != allocator_base(heap), name,
+           "a backed restore has its own base");
+    allocator_destroy(heap);
+    if (!restored)
+        return;
+    check = checkStamps(restored);
+    expect(check.misplaced == 0 && check.nonZero == 0, name, "a backed restore starts with zeroed blocks in place");
+    allocator_for_each_block(restored, stampBlock, NULL);
+    for (int i = 1; i < 40; i += 4) {
+        snprintf(processId, sizeof(processId), "d%d", i);
+        allocator_release(restored, processId);
+    }
+    if (compacts) {
+        allocator_compact(restored);
+        allocator_stats(restored, &stats);
+        check = checkStamps(restored);
+        expect(stats.blocksMoved > 0 && check.misplaced == 0 && check.corrupted == 0, name,
+               "compacting a backed restore moves the bytes with their blocks");
+    }
+    expect(findBlock(restored, "d7", &before), name,
+           "the block to resize after the restore exists");
+    oldRequested = before.requested;
+    expect(allocator_resize(restored, "d7", 30000, ALLOCATOR_FIRST_FIT, &moved) == ALLOCATOR_OK &&
+               moved.startAddress != before.startAddress && stampMatches(&moved, oldRequested),
+           name, "a moving resize on a backed restore carries the old bytes");
+    allocator_destroy(restored);
+}
+
+static void addRoundingWaste(const AllocatorBlock *block, void *context) {
+    if (!block->isFree)
+        *(AllocatorSize *)context += block->size - block->requested;
+}
+
+/** Returns the bytes allocated blocks cover beyond what their owners asked for. */
+static AllocatorSize roundingWaste(const Allocator *heap) {
+    AllocatorSize waste = 0;
+    allocator_for_each_block(heap, addRoundingWaste, &waste);
+    return waste;
+}
+
+/** The buddy engine halves a larger block until the request fits and joins freed buddies
+ *  back up; a non-power-of-two heap keeps its tail blocks and the bytes below one leaf
+ *  apart; and releasing everything after random churn leaves one max-order block. */
+static void testBuddySplitCoalesce(void) {
+    const char *name = allocator_engine_name(ALLOCATOR_ENGINE_BUDDY);
+    Allocator *heap = allocator_create(1064, ALLOCATOR_ENGINE_BUDDY); // 1024 + 32 bytes of leaves, 8 below one
+    AllocatorBlock a, b, c;
+    AllocatorStats stats;
+    allocator_stats(heap, &stats);
+    expect(stats.freeBlockCount == 2 && stats.largestFreeBlock == 1024 && stats.freeBytes == 1056 &&
+               stats.unusableBytes == 8,
+           name, "a non-power-of-two heap starts as one block per set bit");
+
+    allocator_allocate(heap, "a", 100, ALLOCATOR_FIRST_FIT, &a);
+    allocator_stats(heap, &stats);
+    expect(a.startAddress == 0 && a.size == 128 && a.requested == 100, name, "a request rounds up to a power of two");
+    expect(stats.splits == 3 && stats.blockCount == 5 && stats.internalFragmentation == 28, name,
+           "the 1024-byte block is halved three times down to 128 bytes");
+    allocator_allocate(heap, "b", 16, ALLOCATOR_FIRST_FIT, &b);
+    allocator_allocate(heap, "c", 200, ALLOCATOR_FIRST_FIT, &c);
+    allocator_stats(heap, &stats);
+    expect(b.startAddress == 1024 && b.size == 16 && c.startAddress == 256 && c.size == 256, name,
+           "later requests take the smallest free block that fits, splitting only what they need");
+    expect(stats.splits == 4 && stats.internalFragmentation == 84 && stats.internalFragmentation == roundingWaste(heap) &&
+               stats.freeBytes == 1056 - 128 - 16 - 256 && stats.unusableBytes == 8,
+           name, "internal fragmentation sums each block's rounding");
+
+    static Layout layout;
+    allocator_release(heap, "a");
+    allocator_stats(heap, &stats);
+    recordLayout(heap, &layout);
+    expect(stats.merges == 1 && stats.freeBlockCount == 3 && layout.blocks[0].isFree &&
+               layout.blocks[0].endAddress == 255,
+           name, "a freed block joins its free buddy");
+    allocator_release(heap, "c");
+    allocator_release(heap, "b");
+    allocator_stats(heap, &stats);
+    recordLayout(heap, &layout);
+    expect(stats.merges == 4 && stats.freeBlockCount == 2 && stats.internalFragmentation == 0 && layout.count == 2 &&
+               layout.blocks[0].endAddress == 1023 && layout.blocks[1].startAddress == 1024 &&
+               layout.blocks[1].endAddress == 1055,
+           name, "releasing every block coalesces back to the starting blocks");
+    allocator_destroy(heap);
+
+    heap = allocator_create(4096, ALLOCATOR_ENGINE_BUDDY);
+    char processId[ALLOCATOR_PROCESS_ID_SIZE];
+    int live[64] = {0}, wasteTracked = 1;
+    unsigned seed = 777;
+    for (int round = 0; round < 2000; round++) {
+        int i = (int)(nextRandom(&seed) % 64);
+        snprintf(processId, sizeof(processId), "b%d", i);
+        if (live[i]) {
+            allocator_release(heap, processId);
+            live[i] = 0;
+        } else {
+            live[i] = allocator_allocate_aligned(heap, processId, 1 + nextRandom(&seed) % 200,
+                                                 (AllocatorSize)1 << (nextRandom(&seed) % 7), ALLOCATOR_FIRST_FIT,
+                                                 &a) == ALLOCATOR_OK;
+        }
+        allocator_stats(heap, &stats);
+        wasteTracked &= stats.internalFragmentation == roundingWaste(heap);
+    }
+    expect(wasteTracked, name, "internal fragmentation tracks the blocks through churn");
+    for (int i = 0; i < 64; i++) {
+        snprintf(processId, sizeof(processId), "b%d", i);
+        if (live[i])
+            allocator_release(heap, processId);
+    }
+    allocator_stats(heap, &stats);
+    expect(stats.blockCount == 1 && stats.largestFreeBlock == 4096 && stats.splits == stats.merges &&
+               stats.internalFragmentation == 0 && stats.unusableBytes == 0,
+           name, "releasing everything merges back to one max-order block");
+    allocator_destroy(heap);
+}
+
+/** The bitmap engine rounds every block up to whole granules and aligns it to one, counts
+ *  that rounding as internal fragmentation and the bytes past the last whole granule as
+ *  unusable, and rejects granules that are not a power of two or do not fit the heap. */
+static void testBitmapGranules(void) {
+    const char *name = allocator_engine_name(ALLOCATOR_ENGINE_BITMAP);
+    AllocatorStats stats;
+    Allocator *heap = allocator_create(1000, ALLOCATOR_ENGINE_BITMAP);
+    allocator_stats(heap, &stats);
+    expect(stats.granuleSize == ALLOCATOR_BITMAP_GRANULE && stats.unusableBytes == 1000 % ALLOCATOR_BITMAP_GRANULE &&
+               stats.freeBytes == 1000 - 1000 % ALLOCATOR_BITMAP_GRANULE,
+           name, "allocator_create uses the default granule");
+    allocator_destroy(heap);
+    expect(allocator_create_bitmap(1000, 48) == NULL, name, "a granule that is not a power of two is rejected");
+    expect(allocator_create_bitmap(1000, 1024) == NULL, name, "a heap smaller than one granule is rejected");
+
+    heap = allocator_create_bitmap(1000, 64); // 15 granules, 40 bytes past the last
+    AllocatorBlock a, b, c, d;
+    allocator_stats(heap, &stats);
+    expect(stats.granuleSize == 64 && stats.totalSize == 1000 && stats.freeBytes == 960 && stats.unusableBytes == 40 &&
+               stats.largestFreeBlock == 960,
+           name, "the bytes past the last whole granule are unusable");
+    allocator_allocate(heap, "a", 1, ALLOCATOR_FIRST_FIT, &a);
+    allocator_allocate(heap, "b", 64, ALLOCATOR_FIRST_FIT, &b);
+    allocator_allocate(heap, "c", 65, ALLOCATOR_FIRST_FIT, &c);
+    allocator_allocate_aligned(heap, "d", 10, 256, ALLOCATOR_FIRST_FIT, &d);
+    expect(a.startAddress == 0 && a.size == 64 && a.requested == 1 && b.startAddress == 64 && b.size == 64 &&
+               c.startAddress == 128 && c.size == 128 && c.requested == 65,
+           name, "blocks round up to whole granules");
+    expect(d.startAddress == 256 && d.size == 64, name, "an aligned block starts on a granule at that alignment");
+    allocator_stats(heap, &stats);
+    expect(stats.internalFragmentation == 63 + 0 + 63 + 54 && stats.internalFragmentation == roundingWaste(heap) &&
+               stats.freeBytes == 960 - 320 && stats.unusableBytes == 40,
+           name, "internal fragmentation sums each block's rounding");
+
+    expect(allocator_resize(heap, "a", 100, ALLOCATOR_FIRST_FIT, &a) == ALLOCATOR_OK && a.size == 128 &&
+               a.startAddress % 64 == 0,
+           name, "a resized block rounds up to whole granules");
+    expect(allocator_resize(heap, "c", 64, ALLOCATOR_FIRST_FIT, &c) == ALLOCATOR_OK && c.startAddress == 128 &&
+               c.size == 64,
+           name, "a block shrinks by whole granules");
+    allocator_compact(heap);
+    allocator_stats(heap, &stats);
+    static Layout layout;
+    recordLayout(heap, &layout);
+    int granuleAligned = 1;
+    for (int i = 0; i < layout.count; i++)
+        granuleAligned &= layout.blocks[i].startAddress % 64 == 0 && (layout.blocks[i].endAddress + 1) % 64 == 0;
+    expect(granuleAligned, name, "every block covers whole granules");
+    expect(stats.internalFragmentation == 28 + 0 + 0 + 54 && stats.internalFragmentation == roundingWaste(heap), name,
+           "resizing and compaction keep internal fragmentation in step");
+
+    allocator_release(heap, "a");
+    allocator_release(heap, "b");
+    allocator_release(heap, "c");
+    allocator_release(heap, "d");
+    allocator_stats(heap, &stats);
+    expect(stats.freeBlockCount == 1 && stats.largestFreeBlock == 960 && stats.internalFragmentation == 0 &&
+               stats.unusableBytes == 40,
+           name, "releasing every block leaves all granules free");
+    allocator_destroy(heap);
+}
+
+int main() {
+    for (int engine = 0; engine < ALLOCATOR_ENGINE_COUNT; engine++) {
+        testLongProcessIds((AllocatorEngine)engine);
+        testArenaProcessIds((AllocatorEngine)engine);
+        testBulkCompactOnFailure((AllocatorEngine)engine);
+        testSnapshotRoundTrip((AllocatorEngine)engine);
+        testCompactStepBudget((AllocatorEngine)engine);
+        testRelocationRunsMerge((AllocatorEngine)engine);
+        testResize((AllocatorEngine)engine);
+        testWaitWakes((AllocatorEngine)engine);
+        testWaitOrder((AllocatorEngine)engine);
+        testWaitCancel((AllocatorEngine)engine);
+        testDeferredRelease((AllocatorEngine)engine);
+        testDeferredReleaseThreads((AllocatorEngine)engine);
+        testBackedDataFollowsBlocks((AllocatorEngine)engine);
+    }
+    testArrayMatchesList();
+    testVectorScansMatchList();
+    testBuddySplitCoalesce();
+    testBitmapGranules();
+    if (failures)
+        printf("%d check%s failed\n", failures, failures == 1 ? "" : "s");
+    else
+        printf("All checks passed\n");
+    return failures ? 1 : 0;
+}
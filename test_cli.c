@@ -0,0 +1,218 @@
+/**
+ * \file    test_cli.c
+ * \brief   Regression checks for the command-line front end's traces and latency histograms.
+ *
+ * Builds the front end into this program (its main renamed) so the checks can drive the
+ * batch, record and replay paths and the PERF histogram helpers directly. Prints one line per failed expectation and
+ * exits 0 when every check passes, 1 otherwise.
+ *
+ * Compile: gcc -o test_cli test_cli.c allocator.c
+ * Run: ./test_cli
+ */
+
+#define main allocatorCliMain
+#include "contiguous_memory_allocator.c"
+#undef main
+
+#define SESSION_PATH "test_cli_session.txt"
+#define TRACE_PATH "test_cli_session.cmat"
+#define TRUNCATED_PATH "test_cli_truncated.cmat"
+
+static int failures;
+
+/** Records a failed expectation. */
+static void expect(int condition, const char *engineName, const char *what) {
+    if (!condition) {
+        printf("FAIL [%s] %s\n", engineName, what);
+        failures++;
+    }
+}
+
+/** Replaces the session heap with an empty one of size bytes on engine, set up as main does. */
+static void resetHeap(AllocatorEngine engine, AllocatorSize size) {
+    allocator_destroy(heap);
+    activeEngine = engine;
+    heap = allocator_create(size, engine);
+    allocator_set_relocation_visitor(heap, printRelocation, NULL);
+    allocator_set_wait_policy(heap, waitPolicy);
+    allocator_set_compaction_policy(heap, &compactionPolicy);
+}
+
+/** Returns a malloc'd snapshot of the session heap's layout, its length in *length. */
+static unsigned char *snapshotHeap(size_t *length) {
+    *length = allocator_snapshot_size(heap);
+    unsigned char *snapshot = (unsigned char *)malloc(*length);
+    allocator_snapshot(heap, snapshot);
+    return snapshot;
+}
+
+/** Writes length bytes to path. Returns 0 on failure. */
+static int writeFile(const char *path, const void *data, size_t length) {
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return 0;
+    int written = fwrite(data, 1, length, file) == length;
+    return fclose(file) == 0 && written;
+}
+
+/** A batch session recorded with --record replays into the same layout: every traced
+ *  command (RQ, RQW, RS, RQB, RLB, C) reaches the replayed heap in the same order. */
+static void testRecordReplay(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    static const char session[] = "RQ a 300 F\n"
+                                  "RQ b 200 B 64\n"
+                                  "RQB F c 100 d 150 e 50\n"
+                                  "RQW w 1400 F 2\n"
+                                  "RS a 400 F\n"
+                                  "RL b\n"
+                                  "RLB c e\n"
+                                  "C 1 0\n"
+                                  "C\n"
+                                  "RQ f 60 W\n"
+                                  "RS d 40 F\n";
+    expect(writeFile(SESSION_PATH, session, sizeof(session) - 1), name, "the session file is written");
+    resetHeap(engine, 2048);
+    expect(startRecording(TRACE_PATH, 2048), name, "recording starts");
+    expect(runBatch(SESSION_PATH, 0) == EXIT_SUCCESS, name, "the recorded session runs");
+    stopRecording();
+    size_t recordedLength, replayedLength;
+    unsigned char *recorded = snapshotHeap(&recordedLength);
+
+    resetHeap(engine, traceHeapSize(TRACE_PATH));
+    expect(runReplay(TRACE_PATH, '\0') == EXIT_SUCCESS, name, "the trace replays");
+    unsigned char *replayed = snapshotHeap(&replayedLength);
+    expect(recordedLength == replayedLength && memcmp(recorded, replayed, recordedLength) == 0, name,
+           "a replayed trace ends in the recorded layout");
+    free(recorded);
+    free(replayed);
+    remove(SESSION_PATH);
+}
+
+/** A trace cut inside its header or its last record is rejected with an error instead of
+ *  being read past its end. */
+static void testTruncatedTrace(AllocatorEngine engine) {
+    const char *name = allocator_engine_name(engine);
+    size_t length;
+    const unsigned char *trace = mapReadOnlyFile(TRACE_PATH, &length);
+    expect(trace && length > 6, name, "the recorded trace reads back");
+    if (!trace || length <= 6)
+        return;
+    const size_t cuts[] = {0, 3, 5, length - 1};
+    for (int i = 0; i < 4; i++) {
+        expect(writeFile(TRUNCATED_PATH, trace, cuts[i]), name, "the truncated trace is written");
+        resetHeap(engine, 2048);
+        expect(runReplay(TRUNCATED_PATH, '\0') == EXIT_FAILURE, name, "a truncated trace fails to replay");
+    }
+    unmapReadOnlyFile(trace, length);
+    remove(TRUNCATED_PATH);
+}
+
+/** Values on either side of the histogram's edges: the exact range below 16, the first
+ *  power-of-two blocks, a large latency and the top of the range. */
+static const struct {
+    long long value;
+    int bucket;
+} latencyEdges[] = {
+    {0, 0},
+    {1, 1},
+    {15, 15},
+    {16, 16},
+    {17, 17},
+    {31, 31},
+    {32, 32},
+    {33, 32},
+    {34, 33},
+    {1000, 111},
+    {1LL << 40, 592},
+    {(1LL << 40) + (1LL << 36) - 1, 592},
+    {(1LL << 40) + (1LL << 36), 593},
+    {LLONG_MAX, LATENCY_BUCKET_COUNT - 1},
+};
+
+/** Every value lands in a bucket whose floor is at most the value and within 6.25% of it,
+ *  below the next bucket's floor; the edges land in the expected buckets. */
+static void testLatencyBuckets(void) {
+    for (size_t i = 0; i < sizeof(latencyEdges) / sizeof(latencyEdges[0]); i++) {
+        long long value = latencyEdges[i].value;
+        int bucket = latencyBucket(value);
+        char what[96];
+        snprintf(what, sizeof(what), "%lld falls in bucket %d, not %d", value, latencyEdges[i].bucket, bucket);
+        expect(bucket == latencyEdges[i].bucket, "latency", what);
+    }
+    int ordered = 1, tight = 1;
+    unsigned long long state = 88172645463325252ULL;
+    for (int i = 0; i < 100000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        long long value = (long long)(state >> (1 + state % 63)); // Spread over every magnitude
+        int bucket = latencyBucket(value);
+        long long floor = latencyBucketFloor(bucket);
+        ordered &= bucket >= 0 && bucket < LATENCY_BUCKET_COUNT && floor <= value &&
+                   (bucket + 1 == LATENCY_BUCKET_COUNT || value < latencyBucketFloor(bucket + 1));
+        tight &= value - floor <= value / 16;
+    }
+    expect(ordered, "latency", "every value lies between its bucket's floor and the next one's");
+    expect(tight, "latency", "every bucket floor is within 6.25% of the values in it");
+    for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++)
+        ordered &= latencyBucket(latencyBucketFloor(bucket)) == bucket;
+    expect(ordered, "latency", "every bucket's floor falls in that bucket");
+}
+
+static int compareLongLong(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/** Quantiles read from the histogram are never below the exact ones and at most 6.25%
+ *  above them, from latencies of a few nanoseconds to LLONG_MAX. */
+static void testLatencyQuantiles(void) {
+    static const double quantiles[] = {0.0, 0.01, 0.5, 0.9, 0.99, 0.999, 1.0};
+    static long long values[4096];
+    static LatencyHistogram histogram;
+    unsigned long long state = 2463534242ULL;
+    for (int run = 0; run < 4; run++) {
+        memset(&histogram, 0, sizeof(histogram));
+        int count = run == 3 ? 3 : 4096;
+        for (int i = 0; i < count; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            values[i] = run == 0   ? (long long)(state % 16)                      // Exact buckets only
+                        : run == 1 ? 1000 + (long long)(state % 100000)            // Microsecond latencies
+                        : run == 2 ? (long long)(state >> (1 + state % 63))        // Every magnitude
+                                   : LLONG_MAX - (long long)(state % 2);           // The top bucket
+            histogram.count++;
+            if (values[i] > histogram.maxNs)
+                histogram.maxNs = values[i];
+            histogram.buckets[latencyBucket(values[i])]++;
+        }
+        qsort(values, (size_t)count, sizeof(values[0]), compareLongLong);
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            long long rank = (long long)(quantiles[q] * count + 0.5);
+            long long exact = values[(rank < 1 ? 1 : rank) - 1];
+            long long estimate = latencyQuantile(&histogram, quantiles[q]);
+            char what[128];
+            snprintf(what, sizeof(what), "run %d: p%g is %lld, exactly %lld", run, quantiles[q] * 100, estimate,
+                     exact);
+            expect(estimate >= exact && estimate - exact <= exact / 16, "latency", what);
+        }
+    }
+}
+
+int main() {
+    for (int engine = 0; engine < ALLOCATOR_ENGINE_COUNT; engine++) {
+        testRecordReplay((AllocatorEngine)engine);
+        testTruncatedTrace((AllocatorEngine)engine);
+        remove(TRACE_PATH);
+    }
+    testLatencyBuckets();
+    testLatencyQuantiles();
+    allocator_destroy(heap);
+    free(wakeReports);
+    if (failures)
+        printf("%d check%s failed\n", failures, failures == 1 ? "" : "s");
+    else
+        printf("All checks passed\n");
+    return failures ? 1 : 0;
+}